@@ -0,0 +1,259 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Micro benchmark of the range computation (CircBufWrRange / CircBufRdRange) and of the O(1) queries
+ (CircBufAvailWr / CircBufAvailRd / CircBufFirstContig).
+
+ - first, every (RdPos, WrPos) state of small buffers is checked against the original branchy implementation
+   (copied below as reference): empty, full, one block, wrapped.
+ - then random states are timed, so that the branch predictor can't learn the pattern.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "circ_buf.h"
+
+#define NSTATES (1 << 20) // number of random states timed
+#define NLOOPS 20 // each state is timed NLOOPS times
+
+// ==============================================================================
+
+//
+// Reference: original branchy implementation of CircBufWrInd()
+//
+void RefWrRange(CCBFsize_t Rd, CCBFsize_t Wr, CCBFsize_t ElemInBuf, CCBFsize_t (*p)[2][2])
+{
+(*p)[0][0] = 1; // set empty ranges
+(*p)[0][1] = 0;
+(*p)[1][0] = 1;
+(*p)[1][1] = 0;
+
+if(Rd == 0) {
+    if(Wr == 0) {
+       (*p)[1][0] = 0;
+       (*p)[1][1] = ElemInBuf - 2;
+    } else if(Wr == ElemInBuf - 1) {
+       // buffer is full! -> empty range
+    } else {
+       (*p)[1][0] = Wr;
+       (*p)[1][1] = ElemInBuf - 2;
+    }
+} else if(Rd == 1) {
+    if(Wr == 0) {
+       // buffer is full! -> empty range
+    } else {
+       (*p)[1][0] = Wr;
+       (*p)[1][1] = ElemInBuf - 1;
+    }
+} else {
+    if(Wr < Rd - 1) {
+       (*p)[1][0] = Wr;
+       (*p)[1][1] = Rd - 2;
+    } else if(Wr == Rd - 1){
+       // buffer is full! -> empty range
+    } else if(Wr == Rd) {
+       (*p)[0][0] = Wr;
+       (*p)[0][1] = ElemInBuf - 1;
+       (*p)[1][0] = 0;
+       (*p)[1][1] = Wr - 2;
+    } else {
+       (*p)[0][0] = Wr;
+       (*p)[0][1] = ElemInBuf - 1;
+       (*p)[1][0] = 0;
+       (*p)[1][1] = Rd - 2;
+    }
+}
+}
+
+// ==============================================================================
+
+//
+// Reference: original branchy implementation of CircBufRdInd()
+//
+void RefRdRange(CCBFsize_t Rd, CCBFsize_t Wr, CCBFsize_t ElemInBuf, CCBFsize_t (*p)[2][2])
+{
+(*p)[0][0] = 1; // set empty ranges
+(*p)[0][1] = 0;
+(*p)[1][0] = 1;
+(*p)[1][1] = 0;
+
+if(Rd == Wr) {
+    // empty buffer
+} else if(Rd < Wr) {
+    (*p)[1][0] = Rd;
+    (*p)[1][1] = Wr - 1;
+} else if(Wr == 0) {
+    (*p)[1][0] = Rd;
+    (*p)[1][1] = ElemInBuf - 1;
+} else {
+    (*p)[0][0] = Rd;
+    (*p)[0][1] = ElemInBuf - 1;
+    (*p)[1][0] = 0;
+    (*p)[1][1] = Wr - 1;
+}
+}
+
+// ==============================================================================
+
+int same_ranges(CCBFsize_t (*a)[2][2], CCBFsize_t (*b)[2][2])
+{
+return ((*a)[0][0] == (*b)[0][0]) && ((*a)[0][1] == (*b)[0][1]) && ((*a)[1][0] == (*b)[1][0]) && ((*a)[1][1] == (*b)[1][1]);
+}
+
+// ==============================================================================
+
+//
+// checks every state of a buffer of ElemInBuf elements
+//
+int check_all_states(CCBFsize_t ElemInBuf)
+{
+int ret;
+CircBuf_t CrcBuf;
+CCBFsize_t Ref[2][2], Ind[2][2];
+CCBFsize_t Rd, Wr, Start, Len;
+
+ret = CircBufInit(CIRCBUF(&CrcBuf), ElemInBuf);
+if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+for(Rd = 0; Rd < ElemInBuf; Rd++) {
+    for(Wr = 0; Wr < ElemInBuf; Wr++) {
+        CrcBuf.RdPos = Rd;
+        CrcBuf.WrPos = Wr;
+
+        RefWrRange(Rd, Wr, ElemInBuf, &Ref);
+        CircBufWrRange(Rd, Wr, ElemInBuf, &Ind);
+        if(!same_ranges(&Ref, &Ind)) {fprintf(stderr,"ERROR bad write ranges size %u Rd %u Wr %u F:%s L:%d\n", ElemInBuf, Rd, Wr, __FILE__,__LINE__); return 1;}
+        if(CircBufAvailWr(CIRCBUF(&CrcBuf)) != CircBufSzSum(Ref)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+        Len = CircBufFirstContig(CIRCBUF(&CrcBuf), CCBF_WR, &Start);
+        if(Len != (CircBufSz(0,Ref) > 0 ? CircBufSz(0,Ref) : CircBufSz(1,Ref))) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+        if((Len > 0) && (Start != Wr)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+        RefRdRange(Rd, Wr, ElemInBuf, &Ref);
+        CircBufRdRange(Rd, Wr, ElemInBuf, &Ind);
+        if(!same_ranges(&Ref, &Ind)) {fprintf(stderr,"ERROR bad read ranges size %u Rd %u Wr %u F:%s L:%d\n", ElemInBuf, Rd, Wr, __FILE__,__LINE__); return 1;}
+        if(CircBufAvailRd(CIRCBUF(&CrcBuf)) != CircBufSzSum(Ref)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+        Len = CircBufFirstContig(CIRCBUF(&CrcBuf), CCBF_RD, &Start);
+        if(Len != (CircBufSz(0,Ref) > 0 ? CircBufSz(0,Ref) : CircBufSz(1,Ref))) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+        if((Len > 0) && (Start != Rd)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+       } // Wr
+   } // Rd
+return 0;
+}
+
+// ==============================================================================
+
+double now_ns(void)
+{
+struct timespec ts;
+clock_gettime(CLOCK_MONOTONIC, &ts);
+return 1e9 * ts.tv_sec + ts.tv_nsec;
+}
+
+// ==============================================================================
+
+//
+// times one function over random states
+//
+typedef void (*range_fct_t)(CCBFsize_t Rd, CCBFsize_t Wr, CCBFsize_t ElemInBuf, CCBFsize_t (*p)[2][2]);
+
+double time_ranges(range_fct_t fct, CCBFsize_t *tab_rd, CCBFsize_t *tab_wr, CCBFsize_t ElemInBuf, volatile CCBFsize_t *p_sink)
+{
+CCBFsize_t Ind[2][2];
+CCBFsize_t sum = 0;
+double t0, t1;
+size_t i, k;
+
+t0 = now_ns();
+for(k=0; k< NLOOPS; k++) {
+    for(i=0; i< NSTATES; i++) {
+        fct(tab_rd[i], tab_wr[i], ElemInBuf, &Ind);
+        sum += CircBufSzSum(Ind);
+       }
+   }
+t1 = now_ns();
+*p_sink = sum;
+return (t1 - t0) / ((double)NSTATES * NLOOPS);
+}
+
+// ==============================================================================
+
+double time_avail(CircBuf_t *p_circ, CCBFsize_t *tab_rd, CCBFsize_t *tab_wr, int Side, volatile CCBFsize_t *p_sink)
+{
+CCBFsize_t sum = 0;
+double t0, t1;
+size_t i, k;
+
+t0 = now_ns();
+for(k=0; k< NLOOPS; k++) {
+    for(i=0; i< NSTATES; i++) {
+        p_circ -> RdPos = tab_rd[i];
+        p_circ -> WrPos = tab_wr[i];
+        sum += (Side == CCBF_WR) ? CircBufAvailWr(p_circ) : CircBufAvailRd(p_circ);
+       }
+   }
+t1 = now_ns();
+*p_sink = sum;
+return (t1 - t0) / ((double)NSTATES * NLOOPS);
+}
+
+// ==============================================================================
+
+int main(void)
+{
+int ret;
+CCBFsize_t ElemInBuf;
+const CCBFsize_t BenchSize = 1000;
+CCBFsize_t *tab_rd, *tab_wr;
+volatile CCBFsize_t sink;
+CircBuf_t CrcBuf;
+size_t i;
+
+fprintf(stderr,"Check of the range computation in every state\n");
+for(ElemInBuf = 2; ElemInBuf <= 70; ElemInBuf++) {
+    ret = check_all_states(ElemInBuf);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+   }
+fprintf(stderr,"all states OK.\n");
+
+tab_rd = malloc(NSTATES * sizeof(*tab_rd));
+tab_wr = malloc(NSTATES * sizeof(*tab_wr));
+if((tab_rd == NULL) || (tab_wr == NULL)) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+// random states, with a fair share of the corner cases (empty, full, Rd == 0, Rd == 1):
+srand48(time(NULL));
+for(i=0; i< NSTATES; i++) {
+    tab_rd[i] = BenchSize * drand48();
+    switch((int)(6 * drand48())) {
+        case 0: tab_wr[i] = tab_rd[i]; break; // empty
+        case 1: tab_wr[i] = (tab_rd[i] + BenchSize - 1) % BenchSize; break; // full
+        case 2: tab_rd[i] = 0; tab_wr[i] = BenchSize * drand48(); break;
+        case 3: tab_rd[i] = 1; tab_wr[i] = BenchSize * drand48(); break;
+        default: tab_wr[i] = BenchSize * drand48(); break;
+       }
+   }
+
+ret = CircBufInit(CIRCBUF(&CrcBuf), BenchSize);
+if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+printf("buffer size %u, %d random states\n", BenchSize, NSTATES);
+printf("write ranges, reference (branches) : %6.2f ns/call\n", time_ranges(RefWrRange, tab_rd, tab_wr, BenchSize, &sink));
+printf("write ranges, CircBufWrRange       : %6.2f ns/call\n", time_ranges(CircBufWrRange, tab_rd, tab_wr, BenchSize, &sink));
+printf("read ranges, reference (branches)  : %6.2f ns/call\n", time_ranges(RefRdRange, tab_rd, tab_wr, BenchSize, &sink));
+printf("read ranges, CircBufRdRange        : %6.2f ns/call\n", time_ranges(CircBufRdRange, tab_rd, tab_wr, BenchSize, &sink));
+printf("CircBufAvailWr                     : %6.2f ns/call\n", time_avail(CIRCBUF(&CrcBuf), tab_rd, tab_wr, CCBF_WR, &sink));
+printf("CircBufAvailRd                     : %6.2f ns/call\n", time_avail(CIRCBUF(&CrcBuf), tab_rd, tab_wr, CCBF_RD, &sink));
+
+free(tab_rd);
+free(tab_wr);
+
+fprintf(stderr,"OK.\n");
+return 0;
+}
@@ -0,0 +1,632 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Throughput and latency of one writer thread and one reader thread, with circ_buf.c (built with CCBF_ATOMICS=1)
+ and circ_buf_spsc.c.
+
+ - throughput: the writer copies batches of elements in the ring, the reader copies them out. Items/s and bytes/s,
+   for a sweep of element sizes (4 B to 4 KB), buffer sizes (in elements) and batch sizes (the most elements moved per call).
+   The writer stores a sequence number at the start of each element, the reader sums them: the sum is checked at the end,
+   outside of the timed loops.
+ - one-way latency: the writer sends one time stamp at a time, when the ring is empty (no queueing),
+   the reader computes the delay when it gets it.
+ - round trip: a time stamp sent on one ring, echoed back on a second ring.
+ Latencies: min, p50, p99, p99.9, max, mean in ns (CLOCK_MONOTONIC: the clock is the same on every core).
+
+ A thread that finds the ring full / empty spins with CCBF_CPU_RELAX(), and yields the CPU every CCBF_WAIT_SPINS tries
+ (at once on a single CPU machine): the number of such tries is reported (stalls).
+
+ usage: BENCH_spsc [-w cpu] [-r cpu] [-q] [-j] [-m MB] [-l samples]
+   -w, -r : pins the writer / the reader (for the round trip: the sender / the echo) on a CPU
+   -q     : quick sweep
+   -j     : JSON on stdout (default: CSV)
+   -m     : megabytes moved per throughput run (default 64, quick: 8)
+   -l     : number of latency samples (default 100000, quick: 10000)
+ The results are printed on stdout, a summary on stderr.
+
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#include "circ_buf.h"
+#include "circ_buf_spsc.h"
+
+#if !CCBF_ATOMICS
+#error "BENCH_spsc needs CCBF_ATOMICS=1"
+#endif
+
+#define RING_CIRCBUF 0
+#define RING_SPSC 1
+
+#define LAT_ELEMS 64 // buffer size of the latency runs, in elements of 8 bytes
+#define MAX_RING_BYTES (64 << 20) // larger combinations are skipped
+
+static const char *RingNames[2] = {"circ_buf", "spsc"};
+
+typedef struct bench_ring_str
+{
+  CircBufSpsc_t Spsc; // first: aligned on CCBF_CACHE_LINE
+  CircBuf_t Circ;
+  int Kind; // RING_CIRCBUF or RING_SPSC
+  CCBFsize_t ElemInBuf;
+  size_t ElemSize;
+  uint8_t *Data;
+} bench_ring_t;
+
+typedef struct bench_thd_str
+{
+  bench_ring_t *p_Ring; // writer: ring written, reader: ring read. Round trip: the ping ring.
+  bench_ring_t *p_Back; // round trip: the pong ring
+  atomic_int *p_Go; // start flag
+  int Cpu; // -1 : not pinned
+  CCBFsize_t Batch;
+  uint64_t Count; // elements
+  uint8_t *Buf; // Batch elements
+  double *Samples; // latencies
+  uint64_t Stalls;
+  uint64_t Sum; // reader: sum of the sequence numbers
+  double T0, T1;
+} bench_thd_t;
+
+typedef struct bench_res_str
+{
+  const char *Test;
+  const char *Ring;
+  size_t ElemSize;
+  CCBFsize_t ElemInBuf;
+  CCBFsize_t Batch;
+  uint64_t Count;
+  double Seconds;
+  uint64_t StallsWr, StallsRd;
+  double Lat[6]; // min, p50, p99, p99.9, max, mean. Throughput: not used
+} bench_res_t;
+
+static int SpinCount; // 0 on a single CPU
+static int Json;
+static int NbResults;
+static atomic_uint_least64_t LatReceived; // one-way latency: stamps received
+
+// ==============================================================================
+
+double now_ns(void)
+{
+struct timespec ts;
+clock_gettime(CLOCK_MONOTONIC, &ts);
+return 1e9 * ts.tv_sec + ts.tv_nsec;
+}
+
+// ==============================================================================
+
+//
+// the two index managers, behind the same calls. The Kind branch is always predicted.
+//
+static inline void ring_wr_ind(bench_ring_t *p_ring, CCBFsize_t (*p)[2][2])
+{
+if(p_ring -> Kind == RING_SPSC) CircBufSpscWrInd(&(p_ring -> Spsc), p);
+else CircBufWrInd(&(p_ring -> Circ), p);
+}
+
+static inline void ring_rd_ind(bench_ring_t *p_ring, CCBFsize_t (*p)[2][2])
+{
+if(p_ring -> Kind == RING_SPSC) CircBufSpscRdInd(&(p_ring -> Spsc), p);
+else CircBufRdInd(&(p_ring -> Circ), p);
+}
+
+static inline void ring_updt_wr(bench_ring_t *p_ring, CCBFsize_t N)
+{
+if(p_ring -> Kind == RING_SPSC) CircBufSpscUpdtWr(&(p_ring -> Spsc), N);
+else CircBufUpdtWr(&(p_ring -> Circ), N);
+}
+
+static inline void ring_updt_rd(bench_ring_t *p_ring, CCBFsize_t N)
+{
+if(p_ring -> Kind == RING_SPSC) CircBufSpscUpdtRd(&(p_ring -> Spsc), N);
+else CircBufUpdtRd(&(p_ring -> Circ), N);
+}
+
+// ==============================================================================
+
+//
+// the ring is full / empty: try again
+//
+static inline void ring_stall(int *p_spins, uint64_t *p_stalls)
+{
+(*p_stalls)++;
+if(++(*p_spins) >= SpinCount) {
+    *p_spins = 0;
+    sched_yield();
+    } else {
+    CCBF_CPU_RELAX();
+    }
+}
+
+// ==============================================================================
+
+int ring_init(bench_ring_t *p_ring, int Kind, CCBFsize_t ElemInBuf, size_t ElemSize)
+{
+p_ring -> Kind = Kind;
+p_ring -> ElemInBuf = ElemInBuf;
+p_ring -> ElemSize = ElemSize;
+p_ring -> Data = aligned_alloc(CCBF_CACHE_LINE, ((size_t)ElemInBuf * ElemSize + CCBF_CACHE_LINE - 1) & ~(size_t)(CCBF_CACHE_LINE - 1));
+if(p_ring -> Data == NULL) return __LINE__;
+memset(p_ring -> Data, 0, (size_t)ElemInBuf * ElemSize); // no page fault in the timed loops
+if(Kind == RING_SPSC) return CircBufSpscInit(&(p_ring -> Spsc), ElemInBuf);
+return CircBufInit(&(p_ring -> Circ), ElemInBuf);
+}
+
+// ==============================================================================
+
+void pin_thread(int Cpu)
+{
+cpu_set_t set;
+if(Cpu < 0) return;
+CPU_ZERO(&set);
+CPU_SET(Cpu, &set);
+if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+    fprintf(stderr,"WARNING: can't pin a thread on CPU %d\n", Cpu);
+    }
+}
+
+// ==============================================================================
+
+void wait_go(atomic_int *p_go)
+{
+while(atomic_load_explicit(p_go, memory_order_acquire) == 0) {
+    sched_yield();
+    }
+}
+
+// ==============================================================================
+
+void *thd_writer(void *p_usr)
+{
+bench_thd_t *p_thd = p_usr;
+bench_ring_t *p_ring = p_thd -> p_Ring;
+size_t ES = p_ring -> ElemSize;
+CCBFsize_t Ind[2][2], n, sz, done, k;
+uint64_t sent = 0;
+uint32_t seq;
+uint8_t *dst;
+int m, spins = 0;
+
+pin_thread(p_thd -> Cpu);
+wait_go(p_thd -> p_Go);
+p_thd -> T0 = now_ns();
+while(sent < p_thd -> Count) {
+    ring_wr_ind(p_ring, &Ind);
+    n = CircBufSzSum(Ind);
+    if(n == 0) {
+        ring_stall(&spins, &(p_thd -> Stalls));
+        continue;
+        }
+    if(n > p_thd -> Batch) n = p_thd -> Batch;
+    if(n > p_thd -> Count - sent) n = p_thd -> Count - sent;
+    done = 0;
+    for(m = 0; m < 2; m++) {
+        sz = CircBufSz(m, Ind);
+        if(sz > n - done) sz = n - done;
+        if(sz == 0) continue;
+        dst = p_ring -> Data + (size_t)Ind[m][0] * ES;
+        memcpy(dst, p_thd -> Buf, (size_t)sz * ES);
+        for(k = 0; k < sz; k++) {
+            seq = sent + done + k;
+            memcpy(dst + (size_t)k * ES, &seq, sizeof(seq));
+            }
+        done += sz;
+        }
+    ring_updt_wr(p_ring, n);
+    sent += n;
+   }
+return NULL;
+}
+
+// ==============================================================================
+
+void *thd_reader(void *p_usr)
+{
+bench_thd_t *p_thd = p_usr;
+bench_ring_t *p_ring = p_thd -> p_Ring;
+size_t ES = p_ring -> ElemSize;
+CCBFsize_t Ind[2][2], n, sz, done, k;
+uint64_t recv = 0, sum = 0;
+uint32_t seq;
+int m, spins = 0;
+
+pin_thread(p_thd -> Cpu);
+wait_go(p_thd -> p_Go);
+while(recv < p_thd -> Count) {
+    ring_rd_ind(p_ring, &Ind);
+    n = CircBufSzSum(Ind);
+    if(n == 0) {
+        ring_stall(&spins, &(p_thd -> Stalls));
+        continue;
+        }
+    if(n > p_thd -> Batch) n = p_thd -> Batch;
+    done = 0;
+    for(m = 0; m < 2; m++) {
+        sz = CircBufSz(m, Ind);
+        if(sz > n - done) sz = n - done;
+        if(sz == 0) continue;
+        memcpy(p_thd -> Buf, p_ring -> Data + (size_t)Ind[m][0] * ES, (size_t)sz * ES);
+        for(k = 0; k < sz; k++) {
+            memcpy(&seq, p_thd -> Buf + (size_t)k * ES, sizeof(seq));
+            sum += seq;
+            }
+        done += sz;
+        }
+    ring_updt_rd(p_ring, n);
+    recv += n;
+   }
+p_thd -> T1 = now_ns();
+p_thd -> Sum = sum;
+return NULL;
+}
+
+// ==============================================================================
+
+//
+// sends one time stamp in p_ring (waits for a free slot)
+//
+static inline void send_stamp(bench_ring_t *p_ring, double Stamp, uint64_t *p_stalls)
+{
+CCBFsize_t Ind[2][2];
+int spins = 0;
+
+for(;;) {
+    ring_wr_ind(p_ring, &Ind);
+    if(CircBufSzSum(Ind) > 0) break;
+    ring_stall(&spins, p_stalls);
+   }
+memcpy(p_ring -> Data + (size_t)Ind[CircBufSz(0, Ind) > 0 ? 0 : 1][0] * sizeof(double), &Stamp, sizeof(double));
+ring_updt_wr(p_ring, 1);
+}
+
+// ==============================================================================
+
+//
+// receives one time stamp from p_ring (waits for it)
+//
+static inline double recv_stamp(bench_ring_t *p_ring, uint64_t *p_stalls)
+{
+CCBFsize_t Ind[2][2];
+double Stamp;
+int spins = 0;
+
+for(;;) {
+    ring_rd_ind(p_ring, &Ind);
+    if(CircBufSzSum(Ind) > 0) break;
+    ring_stall(&spins, p_stalls);
+   }
+memcpy(&Stamp, p_ring -> Data + (size_t)Ind[CircBufSz(0, Ind) > 0 ? 0 : 1][0] * sizeof(double), sizeof(double));
+ring_updt_rd(p_ring, 1);
+return Stamp;
+}
+
+// ==============================================================================
+
+void *thd_lat_writer(void *p_usr)
+{
+bench_thd_t *p_thd = p_usr;
+uint64_t i;
+int spins = 0;
+
+pin_thread(p_thd -> Cpu);
+wait_go(p_thd -> p_Go);
+for(i = 0; i < p_thd -> Count; i++) {
+    // waits until the previous stamp was read (the spsc writer can't see an empty ring: it only re-reads RdPos when full)
+    while(atomic_load_explicit(&LatReceived, memory_order_acquire) != i) {
+        ring_stall(&spins, &(p_thd -> Stalls));
+       }
+    send_stamp(p_thd -> p_Ring, now_ns(), &(p_thd -> Stalls));
+   }
+return NULL;
+}
+
+// ==============================================================================
+
+void *thd_lat_reader(void *p_usr)
+{
+bench_thd_t *p_thd = p_usr;
+uint64_t i;
+double Stamp;
+
+pin_thread(p_thd -> Cpu);
+wait_go(p_thd -> p_Go);
+for(i = 0; i < p_thd -> Count; i++) {
+    Stamp = recv_stamp(p_thd -> p_Ring, &(p_thd -> Stalls));
+    p_thd -> Samples[i] = now_ns() - Stamp;
+    atomic_store_explicit(&LatReceived, i + 1, memory_order_release);
+   }
+return NULL;
+}
+
+// ==============================================================================
+
+void *thd_rtt_client(void *p_usr)
+{
+bench_thd_t *p_thd = p_usr;
+uint64_t i;
+double Stamp;
+
+pin_thread(p_thd -> Cpu);
+wait_go(p_thd -> p_Go);
+for(i = 0; i < p_thd -> Count; i++) {
+    send_stamp(p_thd -> p_Ring, now_ns(), &(p_thd -> Stalls));
+    Stamp = recv_stamp(p_thd -> p_Back, &(p_thd -> Stalls));
+    p_thd -> Samples[i] = now_ns() - Stamp;
+   }
+return NULL;
+}
+
+// ==============================================================================
+
+void *thd_rtt_echo(void *p_usr)
+{
+bench_thd_t *p_thd = p_usr;
+uint64_t i;
+
+pin_thread(p_thd -> Cpu);
+wait_go(p_thd -> p_Go);
+for(i = 0; i < p_thd -> Count; i++) {
+    send_stamp(p_thd -> p_Back, recv_stamp(p_thd -> p_Ring, &(p_thd -> Stalls)), &(p_thd -> Stalls));
+   }
+return NULL;
+}
+
+// ==============================================================================
+
+//
+// runs the two threads, and waits for them
+//
+int run_pair(void *(*fct_wr)(void *), bench_thd_t *p_wr, void *(*fct_rd)(void *), bench_thd_t *p_rd)
+{
+pthread_t thd_wr, thd_rd;
+atomic_int go = 0;
+
+p_wr -> p_Go = &go;
+p_rd -> p_Go = &go;
+if(pthread_create(&thd_rd, NULL, fct_rd, p_rd) != 0) return __LINE__;
+if(pthread_create(&thd_wr, NULL, fct_wr, p_wr) != 0) return __LINE__;
+atomic_store_explicit(&go, 1, memory_order_release);
+pthread_join(thd_wr, NULL);
+pthread_join(thd_rd, NULL);
+return 0;
+}
+
+// ==============================================================================
+
+int cmp_double(const void *a, const void *b)
+{
+double x = *(const double *)a, y = *(const double *)b;
+return (x > y) - (x < y);
+}
+
+// ==============================================================================
+
+void latency_stats(double *Samples, uint64_t n, double Lat[6])
+{
+double sum = 0;
+uint64_t i;
+
+qsort(Samples, n, sizeof(double), cmp_double);
+for(i = 0; i < n; i++) sum += Samples[i];
+Lat[0] = Samples[0];
+Lat[1] = Samples[(uint64_t)(0.5 * (n - 1) + 0.5)];
+Lat[2] = Samples[(uint64_t)(0.99 * (n - 1) + 0.5)];
+Lat[3] = Samples[(uint64_t)(0.999 * (n - 1) + 0.5)];
+Lat[4] = Samples[n - 1];
+Lat[5] = sum / n;
+}
+
+// ==============================================================================
+
+void print_result(const bench_res_t *p_res)
+{
+int lat = (strcmp(p_res -> Test, "throughput") != 0);
+double ips = p_res -> Count / p_res -> Seconds;
+
+if(lat) {
+    fprintf(stderr,"%-10s %-8s %8.0f %8.0f %8.0f %8.0f %10.0f ns (min p50 p99 p99.9 max)\n",
+            p_res -> Test, p_res -> Ring, p_res -> Lat[0], p_res -> Lat[1], p_res -> Lat[2], p_res -> Lat[3], p_res -> Lat[4]);
+    } else {
+    fprintf(stderr,"%-10s %-8s elem %4zu buf %6u batch %5u : %8.2f Mitems/s %9.2f MB/s\n",
+            p_res -> Test, p_res -> Ring, p_res -> ElemSize, p_res -> ElemInBuf, p_res -> Batch, ips / 1e6, ips * p_res -> ElemSize / 1e6);
+    }
+
+if(Json) {
+    printf("%s\n    {\"test\": \"%s\", \"ring\": \"%s\", \"elem_size\": %zu, \"buf_elems\": %u, \"batch\": %u, \"count\": %" PRIu64 ", \"seconds\": %.6f, "
+           "\"items_per_s\": %.0f, \"bytes_per_s\": %.0f, \"stalls_wr\": %" PRIu64 ", \"stalls_rd\": %" PRIu64,
+           (NbResults == 0) ? "" : ",", p_res -> Test, p_res -> Ring, p_res -> ElemSize, p_res -> ElemInBuf, p_res -> Batch, p_res -> Count, p_res -> Seconds,
+           ips, ips * p_res -> ElemSize, p_res -> StallsWr, p_res -> StallsRd);
+    if(lat) {
+        printf(", \"min_ns\": %.0f, \"p50_ns\": %.0f, \"p99_ns\": %.0f, \"p999_ns\": %.0f, \"max_ns\": %.0f, \"mean_ns\": %.1f",
+               p_res -> Lat[0], p_res -> Lat[1], p_res -> Lat[2], p_res -> Lat[3], p_res -> Lat[4], p_res -> Lat[5]);
+        }
+    printf("}");
+    } else {
+    printf("%s,%s,%zu,%u,%u,%" PRIu64 ",%.6f,%.0f,%.0f,%" PRIu64 ",%" PRIu64,
+           p_res -> Test, p_res -> Ring, p_res -> ElemSize, p_res -> ElemInBuf, p_res -> Batch, p_res -> Count, p_res -> Seconds,
+           ips, ips * p_res -> ElemSize, p_res -> StallsWr, p_res -> StallsRd);
+    if(lat) {
+        printf(",%.0f,%.0f,%.0f,%.0f,%.0f,%.1f\n", p_res -> Lat[0], p_res -> Lat[1], p_res -> Lat[2], p_res -> Lat[3], p_res -> Lat[4], p_res -> Lat[5]);
+        } else {
+        printf(",,,,,,\n");
+        }
+    }
+NbResults++;
+}
+
+// ==============================================================================
+
+int bench_throughput(int Kind, size_t ElemSize, CCBFsize_t ElemInBuf, CCBFsize_t Batch, uint64_t Bytes, int CpuWr, int CpuRd)
+{
+static bench_ring_t Ring;
+bench_thd_t Wr, Rd;
+bench_res_t Res;
+uint64_t Count = Bytes / ElemSize;
+
+if(Count < 1000) Count = 1000;
+if(ring_init(&Ring, Kind, ElemInBuf, ElemSize) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+memset(&Wr, 0, sizeof(Wr));
+memset(&Rd, 0, sizeof(Rd));
+Wr.p_Ring = Rd.p_Ring = &Ring;
+Wr.Cpu = CpuWr;
+Rd.Cpu = CpuRd;
+Wr.Batch = Rd.Batch = Batch;
+Wr.Count = Rd.Count = Count;
+Wr.Buf = calloc(Batch, ElemSize);
+Rd.Buf = calloc(Batch, ElemSize);
+if((Wr.Buf == NULL) || (Rd.Buf == NULL)) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+if(run_pair(thd_writer, &Wr, thd_reader, &Rd) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(Rd.Sum != (Count * (Count - 1) / 2)) {fprintf(stderr,"ERROR wrong data read F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+memset(&Res, 0, sizeof(Res));
+Res.Test = "throughput";
+Res.Ring = RingNames[Kind];
+Res.ElemSize = ElemSize;
+Res.ElemInBuf = ElemInBuf;
+Res.Batch = Batch;
+Res.Count = Count;
+Res.Seconds = (Rd.T1 - Wr.T0) / 1e9;
+Res.StallsWr = Wr.Stalls;
+Res.StallsRd = Rd.Stalls;
+print_result(&Res);
+
+free(Wr.Buf);
+free(Rd.Buf);
+free(Ring.Data);
+return 0;
+}
+
+// ==============================================================================
+
+//
+// RoundTrip = 0: one-way latency, 1: round trip
+//
+int bench_latency(int Kind, int RoundTrip, uint64_t Count, int CpuWr, int CpuRd)
+{
+static bench_ring_t Ping, Pong;
+bench_thd_t Wr, Rd;
+bench_res_t Res;
+double t0, *Samples;
+
+if(ring_init(&Ping, Kind, LAT_ELEMS, sizeof(double)) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(ring_init(&Pong, Kind, LAT_ELEMS, sizeof(double)) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+Samples = malloc(Count * sizeof(double));
+if(Samples == NULL) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+memset(&Wr, 0, sizeof(Wr));
+memset(&Rd, 0, sizeof(Rd));
+Wr.p_Ring = Rd.p_Ring = &Ping;
+Wr.p_Back = Rd.p_Back = &Pong;
+Wr.Cpu = CpuWr;
+Rd.Cpu = CpuRd;
+Wr.Count = Rd.Count = Count;
+Wr.Samples = Rd.Samples = Samples;
+
+atomic_store(&LatReceived, 0);
+t0 = now_ns();
+if(RoundTrip) {
+    if(run_pair(thd_rtt_client, &Wr, thd_rtt_echo, &Rd) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    } else {
+    if(run_pair(thd_lat_writer, &Wr, thd_lat_reader, &Rd) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    }
+
+memset(&Res, 0, sizeof(Res));
+Res.Test = RoundTrip ? "round_trip" : "one_way";
+Res.Ring = RingNames[Kind];
+Res.ElemSize = sizeof(double);
+Res.ElemInBuf = LAT_ELEMS;
+Res.Batch = 1;
+Res.Count = Count;
+Res.Seconds = (now_ns() - t0) / 1e9;
+Res.StallsWr = Wr.Stalls;
+Res.StallsRd = Rd.Stalls;
+latency_stats(Samples, Count, Res.Lat);
+print_result(&Res);
+
+free(Samples);
+free(Ping.Data);
+free(Pong.Data);
+return 0;
+}
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+const size_t AllElemSizes[] = {4, 16, 64, 256, 1024, 4096}, QuickElemSizes[] = {4, 64, 4096};
+const CCBFsize_t AllBufSizes[] = {256, 4096, 65536}, QuickBufSizes[] = {1024};
+const CCBFsize_t AllBatches[] = {1, 32, 1024}, QuickBatches[] = {1, 64};
+const size_t *ElemSizes = AllElemSizes;
+const CCBFsize_t *BufSizes = AllBufSizes, *Batches = AllBatches;
+size_t nElemSizes = 6, nBufSizes = 3, nBatches = 3;
+int CpuWr = -1, CpuRd = -1, quick = 0, Kind, i;
+unsigned long MBytes = 0, Samples = 0;
+size_t e, s, b;
+
+for(i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "-q") == 0) quick = 1;
+    else if(strcmp(argv[i], "-j") == 0) Json = 1;
+    else if((strcmp(argv[i], "-w") == 0) && (i + 1 < argc) && (sscanf(argv[i + 1], "%d", &CpuWr) == 1)) i++;
+    else if((strcmp(argv[i], "-r") == 0) && (i + 1 < argc) && (sscanf(argv[i + 1], "%d", &CpuRd) == 1)) i++;
+    else if((strcmp(argv[i], "-m") == 0) && (i + 1 < argc) && (sscanf(argv[i + 1], "%lu", &MBytes) == 1)) i++;
+    else if((strcmp(argv[i], "-l") == 0) && (i + 1 < argc) && (sscanf(argv[i + 1], "%lu", &Samples) == 1)) i++;
+    else {
+        fprintf(stderr,"usage: %s [-w cpu] [-r cpu] [-q] [-j] [-m MB] [-l samples]\n", argv[0]);
+        return 1;
+        }
+   }
+if(quick) {
+    ElemSizes = QuickElemSizes;
+    BufSizes = QuickBufSizes;
+    Batches = QuickBatches;
+    nElemSizes = 3;
+    nBufSizes = 1;
+    nBatches = 2;
+    }
+if(MBytes == 0) MBytes = quick ? 8 : 64;
+if(Samples == 0) Samples = quick ? 10000 : 100000;
+SpinCount = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? CCBF_WAIT_SPINS : 0;
+
+fprintf(stderr,"SPSC benchmark: %ld CPUs, writer CPU %d, reader CPU %d (-1: not pinned)\n", sysconf(_SC_NPROCESSORS_ONLN), CpuWr, CpuRd);
+if(Json) {
+    printf("{\"cpus\": %ld, \"writer_cpu\": %d, \"reader_cpu\": %d, \"results\": [", sysconf(_SC_NPROCESSORS_ONLN), CpuWr, CpuRd);
+    } else {
+    printf("test,ring,elem_size,buf_elems,batch,count,seconds,items_per_s,bytes_per_s,stalls_wr,stalls_rd,min_ns,p50_ns,p99_ns,p999_ns,max_ns,mean_ns\n");
+    }
+
+for(Kind = RING_CIRCBUF; Kind <= RING_SPSC; Kind++) {
+    for(e = 0; e < nElemSizes; e++) {
+        for(s = 0; s < nBufSizes; s++) {
+            if((size_t)BufSizes[s] * ElemSizes[e] > MAX_RING_BYTES) continue;
+            for(b = 0; b < nBatches; b++) {
+                if(bench_throughput(Kind, ElemSizes[e], BufSizes[s], Batches[b], (uint64_t)MBytes << 20, CpuWr, CpuRd) != 0) return 1;
+                }
+            }
+        }
+    }
+for(Kind = RING_CIRCBUF; Kind <= RING_SPSC; Kind++) {
+    if(bench_latency(Kind, 0, Samples, CpuWr, CpuRd) != 0) return 1;
+    if(bench_latency(Kind, 1, Samples, CpuWr, CpuRd) != 0) return 1;
+   }
+
+if(Json) {
+    printf("\n]}\n");
+    }
+fprintf(stderr,"OK.\n");
+return 0;
+}
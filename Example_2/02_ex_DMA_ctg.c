@@ -0,0 +1,253 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+Same as 02_ex_DMA.c: blocks of contiguous memory of an imposed size are stored in the ring buffer,
+but this time the contiguous reservations are handled by the library (circ_buf_ctg.h):
+
+ - the writer asks for DMAsize contiguous elements, and the space left unused at the end of the buffer is tracked by the library,
+ - the reader gets the next contiguous block of data, the unused space being skipped for it.
+
+=> only one circular buffer is needed: no index buffer.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <time.h>
+#include <string.h>
+#include <sched.h>
+
+#include "circ_buf_ctg.h"
+
+
+typedef uint32_t elem_t;
+#define MAX_VAL_ELEM UINT32_MAX
+
+
+struct shared_thd_data_str
+{
+elem_t *buf; // containing the raw data
+
+CircBufCtg_t *p_CrcBufData; // more convenient
+CircBufCtg_t CrcBufData; // ring managing the data in buf
+
+size_t DMAsize; // size of a DMA block
+int Ninsertions; // iterations of the test
+};
+
+// ==============================================================================
+
+void randomize_struct(void *mem, size_t size)
+{
+uint8_t *tab_bytes = mem;
+size_t i;
+for(i=0; i< size; i++) tab_bytes[i] = 256 * drand48();
+}
+
+// ==============================================================================
+
+//
+//  Writer Thread
+//
+void *writer(void *p_usr_in)
+{
+int ret;
+struct shared_thd_data_str *p_data = p_usr_in;
+CCBFsize_t imin;
+
+int k = 0;
+
+size_t m;
+
+while( k < p_data -> Ninsertions) {
+
+    // insert the DMA blocks one at a time
+
+    ret = CircBufCtgWrReserve(CIRCBUFCTG(p_data -> p_CrcBufData), p_data -> DMAsize, &imin);
+    if(ret == CCBF_AGAIN) {
+        sched_yield(); // no suitable empty space... wait for the reader to free some space.
+        continue;
+       }
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    elem_t *dma_buf = malloc(p_data -> DMAsize * sizeof(*dma_buf));
+    if(dma_buf == NULL) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    randomize_struct(dma_buf, p_data -> DMAsize * sizeof(*dma_buf));
+
+    elem_t chksum = 0;
+    for(m=0; m< p_data -> DMAsize - 1; m++) chksum ^= dma_buf[m];
+    dma_buf[p_data -> DMAsize - 1] = chksum;
+
+    memcpy(p_data -> buf + imin, dma_buf, p_data -> DMAsize*sizeof(*dma_buf));
+    free(dma_buf);
+
+    // the space skipped at the end of the buffer (if any) is committed too:
+    ret = CircBufCtgUpdtWr(CIRCBUFCTG(p_data -> p_CrcBufData), p_data -> DMAsize);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    k++;
+  } // while on k
+
+fprintf(stderr,"Writer finished.\n");
+return NULL;
+}
+
+// ==============================================================================
+
+//
+// Verifies size and Checksum
+//
+int check_DMA_block( CCBFsize_t start, CCBFsize_t end, struct shared_thd_data_str *p_data )
+{
+elem_t chksum = 0;
+size_t m;
+
+if((end - start + 1) != p_data -> DMAsize) {
+    fprintf(stderr,"ERROR wrong packet size F:%s L:%d\n",__FILE__,__LINE__);
+    return 1;
+   }
+
+for(m=start; m<= end; m++) chksum ^= p_data -> buf[m];
+if(chksum != 0) {
+    fprintf(stderr,"ERROR wrong packet checksum. F:%s L:%d\n",__FILE__,__LINE__);
+    fprintf(stderr, "%x\n", chksum);
+    return 1;
+   }
+return 0;
+}
+
+// ==============================================================================
+
+//
+//  Reader Thread
+//
+void *reader(void *p_usr_in)
+{
+int ret;
+struct shared_thd_data_str *p_data = p_usr_in;
+
+CCBFsize_t start, len;
+
+int k = 0;
+
+while( k < p_data -> Ninsertions) {
+
+    // see if we can pop a DMA block:
+    len = CircBufCtgRdBlock(CIRCBUFCTG(p_data -> p_CrcBufData), &start);
+
+    if(len == 0) {
+        sched_yield(); // nothing yet: let the writer run
+        continue;
+       }
+
+    // the writer only commits whole blocks:
+    if(len < p_data -> DMAsize) {fprintf(stderr,"ERROR truncated block F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    ret = check_DMA_block( start, start + (p_data -> DMAsize - 1), p_data );
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    ret = CircBufCtgUpdtRd(CIRCBUFCTG(p_data -> p_CrcBufData), p_data -> DMAsize);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    k++;
+   }
+
+fprintf(stderr,"Reader finished: all values OK.\n");
+return NULL;
+}
+
+// ==============================================================================
+
+int init_shared_data(struct shared_thd_data_str *p_data, const size_t DMAsize, const int Nbufsz, const int Ninsertions )
+{
+int ret;
+
+ p_data -> buf = malloc(Nbufsz * sizeof(*(p_data -> buf)));
+ if( p_data -> buf == NULL)  {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+ randomize_struct(p_data -> buf, Nbufsz * sizeof(*(p_data -> buf)));
+
+ p_data -> p_CrcBufData = &(p_data -> CrcBufData);
+ randomize_struct(p_data -> p_CrcBufData, sizeof(p_data -> CrcBufData));
+ ret = CircBufCtgInit(CIRCBUFCTG(p_data -> p_CrcBufData), Nbufsz);
+ if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+ p_data -> DMAsize = DMAsize;
+ p_data -> Ninsertions = Ninsertions;
+return 0;
+}
+
+// ==============================================================================
+
+int clear_shared_data(struct shared_thd_data_str *p_data)
+{
+ free(p_data -> buf);
+return 0;
+}
+
+// ==============================================================================
+
+void init_drand48()
+{
+    srand48(time(NULL));
+}
+
+// ==============================================================================
+
+int do_test(const size_t DMAsize, const int Nbufsz, const int Ninsertions)
+{
+int ret;
+pthread_t writer_thd, reader_thd;
+struct shared_thd_data_str shrd_data;
+
+ret = init_shared_data(&shrd_data, DMAsize, Nbufsz, Ninsertions);
+if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+ret = pthread_create(&writer_thd, NULL, writer, &shrd_data);
+if(ret != 0) {fprintf(stderr,"ERROR: cannot create thread. F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+ret = pthread_create(&reader_thd, NULL, reader, &shrd_data);
+if(ret != 0) {fprintf(stderr,"ERROR: cannot create thread. F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+pthread_join(writer_thd, NULL);
+pthread_join(reader_thd, NULL);
+
+clear_shared_data(&shrd_data);
+
+return 0;
+}
+
+// ==============================================================================
+
+int main(void)
+{
+size_t DMAsize; // in elements.
+int Nbufsz; // size of the circular buffer, in elements
+int Ninsertions; // number of DMA packets inserted (one DMA packet: DMAsize x elements)
+
+int ret;
+
+fprintf(stderr,"Randomized test of the ring buffer, contiguous reservations\n");
+
+init_drand48();
+
+DMAsize = 251; //  let's take a prime for example
+Nbufsz = 1024;
+Ninsertions = 100000;
+
+ret = do_test( DMAsize, Nbufsz, Ninsertions);
+if(ret != 0) {fprintf(stderr,"ERROR. F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+DMAsize = 511; // the largest block that always fits: (Nbufsz - 1) / 2
+
+ret = do_test( DMAsize, Nbufsz, Ninsertions);
+if(ret != 0) {fprintf(stderr,"ERROR. F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
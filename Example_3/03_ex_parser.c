@@ -9,8 +9,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <string.h>
 
-#include <zlib.h>
+#include "circ_buf_crc.h"
 
 
 #include "03_ex_parser.h"
@@ -19,285 +20,498 @@
 enum parser_status {
     expect_hdr, // just created, no header found yet
     expect_size, // we received a header, now reading the bytes containing the total packet size
-    expect_data, // 
-    expect_chksum, // 
-    end_bad_chksum, // finished, but the checksum is bad
+    expect_data, //
+    expect_chksum, //
     end_good_packet // everything OK: we got a good packet
 };
 
-struct parser_str
+#define PARSER_MAX_FIELD 8 // largest magic or size field
+#define PARSER_NONE ((size_t)-1) // end of the list of the open hypotheses
+
+// one hypothesis: "a packet starts at this position of the stream"
+struct parser_hyp_str
 {
     enum parser_status status;
-   
+    size_t start; // position of the first byte of the magic
+    size_t next; // key in its heap: expect_data: position of the first byte of the checksum, end_good_packet: start
+    size_t end; // end_good_packet: position just after the checksum
+    size_t fill; // bytes already received for the current field
+    uint8_t field[PARSER_MAX_FIELD]; // magic or size received, or checksum expected
+    uint32_t crc_start; // CRC of the stream before start
+    size_t prev_open, next_open; // list of the open hypotheses, in the order of start
+};
+
+struct parser_str
+{
+    enum parser_status status; // expect_hdr, or end_good_packet when a packet has been found
+
     size_t magic_size;
-    size_t size_size; 
-    size_t chksum_size; 
+    size_t size_size;
+    size_t chksum_size;
     size_t max_packet_size; // maximum size of a packet!
 
-    size_t skipped; // number of bytes skipped before the magic header    
-    size_t cur_fill; // stored the number of bytes already received for the current field. ex: packet size
-    uint8_t *tmp_buf; // stores the (yet incomplete) data of the current field. ex: header magic, packet size, chksum ...
-    //size_t tmp_buf_size;
-    size_t total_pack_size; // will be filled when the size bytes have been received
-    
+    // the positions are counted from the last full reset, the values returned are counted from origin:
+    size_t origin; // position just after the last packet returned
+    size_t skipped; // number of bytes skipped before the magic header of the good packet (from origin)
+    size_t end; // position just after the last byte of the good packet (from origin)
+    size_t pos; // number of bytes received since the last full reset
+    uint32_t crc; // CRC-32C of all the bytes received since the last full reset
+
     int (*is_magic)(void *to_check, int size_to_check);
-    uLong crc;
-    
+
+    uint8_t magic_first[256]; // 1 if is_magic() accepts this byte as the start of a magic
+    int magic_byte; // the only byte accepted as a start of magic, or -1 if there are several
+
+    size_t max_hyp; // enough for one hypothesis per byte of the largest packet
+    struct parser_hyp_str *hyp;
+    size_t nber_used; // hyp[nber_used] and the next ones have never been used since the last reset
+    size_t *free_hyp, nber_free; // the others that are free
+    size_t *fields, nber_fields; // hypotheses that look at each byte: reading the magic, the size, or the checksum
+    size_t *heap, nber_heap; // hypotheses in their data: min-heap on next
+    size_t *good, nber_good; // good packets not returned yet: min-heap on start
+    size_t first_open, last_open; // the open hypotheses (in fields or in heap), in the order of start
+
 }; // parser_t;
 
 
 // ==============================================================================
 
 // amount of bytes skipped before the magic field was detected
+//
+// when no packet has been found yet: the number of bytes at the start that are not part of any hypothesis anymore
+// (the caller can already discard them)
 size_t parser_query_skipped(parser_t *p_parser)
 {
-    return p_parser -> skipped;
+size_t first = p_parser -> pos;
+
+if(p_parser -> status == end_good_packet) return p_parser -> skipped;
+
+if(p_parser -> first_open != PARSER_NONE) first = p_parser -> hyp[p_parser -> first_open].start;
+if((p_parser -> nber_good > 0) && (p_parser -> hyp[p_parser -> good[0]].start < first)) first = p_parser -> hyp[p_parser -> good[0]].start;
+return first - p_parser -> origin;
 }
 
 // ==============================================================================
 
-// states of the parser:
-// 
-//    - expecting a new start : no magic value has been found yet, discard everything that is not a magic
-//                              if a magic is found: set the state to "exploring a current hypothesis: find size"
-//    
-//    - exploring a current hypothesis find size : wait 2 bytes to get the size of the data inside the packet
-//           when the size is found:
-//               - check if it is <= max size. if not: try to find another magic.... --> here we may make multiple tries!!
-//               - if true: switch to "exploring a current hypothesis data"
-//    
-//    - exploring a current hypothesis data: wait until the size has been received. then switch to "receive checksum"
-//         
-//    - receive checksum : wait 4 bytes
-//                   - if received: check the checksum. if bad: try to find another magic.... --> here we may make multiple tries!!
-//
-// Two cases: we receive the data one by one, OR we want to check data already in the buffer then the rest received one by one
-//    ==> better code a machine that receives the data one by one.
+// position just after the last byte of the good packet
 //
-int parser_add_byte(parser_t *p_parser, uint8_t byte)
+// the parser can have received bytes after it before returning finished_good_pack (an earlier start still had to be checked):
+// it keeps them, reset_parser() continues from the end of the packet
+size_t parser_query_end(parser_t *p_parser)
 {
-    
-if(p_parser -> status == expect_hdr) {
-    int is_not_mgk;
-    // check quickly for the first byte:
-    if(p_parser -> cur_fill == 0) {
-        is_not_mgk = (p_parser -> is_magic)(&byte, 1);
-        if(is_not_mgk) {
-            p_parser -> skipped += 1;
-            return not_finished; // caller will send next byte!
-           } else {
-               // we may have a magic start..
-               p_parser -> crc = crc32(0L, Z_NULL, 0); // call crc() through a pointer??
-           }
-       }
-    
-    // we may have a magic start..
-       
-    p_parser -> tmp_buf[p_parser -> cur_fill]= byte;
-    p_parser -> cur_fill ++;
-    
-    p_parser -> crc = crc32(p_parser -> crc, &byte, 1); // call crc() through a pointer??
-    
-    is_not_mgk = (p_parser -> is_magic)(p_parser -> tmp_buf, p_parser -> cur_fill);
-    if(is_not_mgk == 0) {
-        if(p_parser -> cur_fill == p_parser -> magic_size ) {
-            // it may be a header!
-            p_parser -> status = expect_size;
-            p_parser -> cur_fill = 0;
-            return not_finished;
-           } else {
-            // stil some more bytes to check..
-            return not_finished;
-           }
-       } else {
-           // not a "magic" value. we can stop here
-           p_parser -> skipped += 1; // p_parser -> cur_fill; BE CAREFUL: only skip one maybe-start byte at a time!!!
-           p_parser -> cur_fill = 0;
-           return finished_bad_pack; // caller will retry on next byte!
+return p_parser -> end;
+}
+
+// ==============================================================================
+
+// min-heaps of hypotheses on next: the ones waiting for the end of their data, and the good packets not returned yet
+
+static void heap_push(parser_t *p_parser, size_t *heap, size_t *p_nber, size_t id)
+{
+size_t k = (*p_nber)++, parent;
+
+while(k > 0) {
+    parent = (k - 1) / 2;
+    if(p_parser -> hyp[heap[parent]].next <= p_parser -> hyp[id].next) break;
+    heap[k] = heap[parent];
+    k = parent;
+   }
+heap[k] = id;
+}
+
+static size_t heap_pop(parser_t *p_parser, size_t *heap, size_t *p_nber)
+{
+size_t top = heap[0], last = heap[--(*p_nber)], k = 0, child;
+
+while((child = 2 * k + 1) < *p_nber) {
+    if((child + 1 < *p_nber) && (p_parser -> hyp[heap[child + 1]].next < p_parser -> hyp[heap[child]].next)) child++;
+    if(p_parser -> hyp[last].next <= p_parser -> hyp[heap[child]].next) break;
+    heap[k] = heap[child];
+    k = child;
+   }
+heap[k] = last;
+return top;
+}
+
+// ==============================================================================
+
+// the open hypotheses: created in the order of the stream, appended at the end
+
+static void open_append(parser_t *p_parser, size_t id)
+{
+p_parser -> hyp[id].prev_open = p_parser -> last_open;
+p_parser -> hyp[id].next_open = PARSER_NONE;
+if(p_parser -> last_open != PARSER_NONE) p_parser -> hyp[p_parser -> last_open].next_open = id;
+else p_parser -> first_open = id;
+p_parser -> last_open = id;
+}
+
+static void open_remove(parser_t *p_parser, size_t id)
+{
+struct parser_hyp_str *p_hyp = p_parser -> hyp + id;
+
+if(p_hyp -> prev_open != PARSER_NONE) p_parser -> hyp[p_hyp -> prev_open].next_open = p_hyp -> next_open;
+else p_parser -> first_open = p_hyp -> next_open;
+if(p_hyp -> next_open != PARSER_NONE) p_parser -> hyp[p_hyp -> next_open].prev_open = p_hyp -> prev_open;
+else p_parser -> last_open = p_hyp -> prev_open;
+}
+
+// ==============================================================================
+
+// the total packet size, from the size field (little endian, as the packets are written)
+static size_t hyp_size(parser_t *p_parser, struct parser_hyp_str *p_hyp)
+{
+uint8_t u8; uint16_t u16; uint32_t u32; uint64_t u64;
+
+switch(p_parser -> size_size) {
+    case sizeof(uint8_t):  memcpy(&u8,  p_hyp -> field, sizeof(u8));  return u8;
+    case sizeof(uint16_t): memcpy(&u16, p_hyp -> field, sizeof(u16)); return u16;
+    case sizeof(uint32_t): memcpy(&u32, p_hyp -> field, sizeof(u32)); return u32;
+    default:               memcpy(&u64, p_hyp -> field, sizeof(u64)); return u64;
+   }
+}
+
+// ==============================================================================
+
+// Gives the byte at position pos to one hypothesis reading a field.
+// returns 0 : still in a field, 1 : wrong packet, drop it, 2 : waiting for the end of the data (now in the heap), 3 : good packet
+static int hyp_add_byte(parser_t *p_parser, size_t id, uint8_t byte)
+{
+struct parser_hyp_str *p_hyp = p_parser -> hyp + id;
+size_t min_size = p_parser -> magic_size + p_parser -> size_size + p_parser -> chksum_size;
+
+if(p_hyp -> status == expect_hdr) {
+    p_hyp -> field[p_hyp -> fill ++] = byte;
+    if((p_parser -> is_magic)(p_hyp -> field, p_hyp -> fill) != 0) return 1;
+    if(p_hyp -> fill == p_parser -> magic_size) {
+        p_hyp -> status = expect_size;
+        p_hyp -> fill = 0;
        }
+    return 0;
   }
-    
-    
-if(p_parser -> status == expect_size) {
-       
-    p_parser -> tmp_buf[p_parser -> cur_fill]= byte;
-    p_parser -> cur_fill ++;
-    p_parser -> crc = crc32(p_parser -> crc, &byte, 1); // call crc() through a pointer??
-    
-    if(p_parser -> cur_fill < p_parser -> size_size) {
-        // waiting for more bytes..
-        return not_finished;
-    } else {
-        // got all the bytes!
-        if(p_parser -> size_size == sizeof(uint8_t)) {
-            uint8_t *p_size = (void *)p_parser -> tmp_buf;
-            p_parser -> total_pack_size = *p_size;
-        } else if (p_parser -> size_size == sizeof(uint16_t)) {
-            uint16_t *p_size = (void *)p_parser -> tmp_buf;
-            p_parser -> total_pack_size = *p_size;
-        } else if (p_parser -> size_size == sizeof(uint32_t)) {
-            uint32_t *p_size = (void *)p_parser -> tmp_buf;
-            p_parser -> total_pack_size = *p_size;
-        } else if (p_parser -> size_size == sizeof(uint64_t)) {
-            uint64_t *p_size = (void *)p_parser -> tmp_buf;
-            p_parser -> total_pack_size = *p_size;
-        } else {
-            //fprintf(stderr,"unknown size %lu\n",p_parser -> size_size);
-            return error;
-        }
-        
-        p_parser -> cur_fill = 0;
-        
-        if(p_parser -> total_pack_size > p_parser -> max_packet_size){
-            // Wrong packet size!
-            p_parser -> skipped += 1; // BE CAREFUL: only skip one byte at a time!!!
-            return finished_bad_pack; // caller will retry on next byte!
-            }
-        
-        size_t datasize =   p_parser -> total_pack_size - ( p_parser -> magic_size + p_parser -> size_size + p_parser -> chksum_size );    
-        if(datasize < 0)  {
-            p_parser -> skipped += 1; // BE CAREFUL: only skip one byte at a time!!!
-            return finished_bad_pack; // caller will retry on next byte!
-           }
-    
-        p_parser -> status = datasize > 0? expect_data : expect_chksum;
-        return not_finished;
-    }
-    
-   } // status == expect_size
-   
-if(p_parser -> status == expect_data) {
-    // don't store the data: only compute the checksum!
-    size_t datasize =   p_parser -> total_pack_size - ( p_parser -> magic_size + p_parser -> size_size + p_parser -> chksum_size );  // < 0 already checked
-        
-    p_parser -> crc = crc32(p_parser -> crc, &byte, 1); // call crc() through a pointer??
-    
-    p_parser -> cur_fill ++;
-    if(p_parser -> cur_fill == datasize) {
-         p_parser -> cur_fill = 0;
-         p_parser -> status = expect_chksum;
-        }
-    return not_finished;
-  } // status == expect_data
-
-if(p_parser -> status == expect_chksum) {
-
-    p_parser -> tmp_buf[p_parser -> cur_fill]= byte;
-    p_parser -> cur_fill ++;
-    
-    if(p_parser -> cur_fill < p_parser -> chksum_size) {
-        // waiting for more bytes..
-        return not_finished;
-    } else {
-        // we got the bytes!
-        // check crc:
-        uint32_t *p_crc = (void *)p_parser -> tmp_buf;
-        
-        //printf("%u %u\n", *p_crc, p_parser -> crc);
-        
-        if(p_parser -> crc == *p_crc) {
-            // good packet!
-            p_parser -> status = end_good_packet;
-            return finished_good_pack;
-         } else {
-             p_parser -> status = end_bad_chksum;
-             p_parser -> skipped += 1; // BE CAREFUL: only skip one byte at a time!!!
-             return finished_bad_pack;
-         }
+
+if(p_hyp -> status == expect_size) {
+    p_hyp -> field[p_hyp -> fill ++] = byte;
+    if(p_hyp -> fill < p_parser -> size_size) return 0;
+    size_t total_pack_size = hyp_size(p_parser, p_hyp);
+    if((total_pack_size > p_parser -> max_packet_size) || (total_pack_size < min_size)) return 1;
+    // the data is not looked at: the checksum will come from the CRC of the stream
+    p_hyp -> status = expect_data;
+    p_hyp -> next = p_hyp -> start + total_pack_size - p_parser -> chksum_size;
+    heap_push(p_parser, p_parser -> heap, &(p_parser -> nber_heap), id);
+    return 2;
+  }
+
+// expect_chksum:
+if(p_hyp -> field[p_hyp -> fill] != byte) return 1;
+p_hyp -> fill ++;
+return (p_hyp -> fill == p_parser -> chksum_size) ? 3 : 0;
+}
+
+// ==============================================================================
+
+// the hypotheses whose data ends here: CRC of [start, pos) from the CRC of the stream at both ends
+static void parser_end_data(parser_t *p_parser)
+{
+struct parser_hyp_str *p_hyp;
+uint32_t crc;
+size_t id;
+
+while((p_parser -> nber_heap > 0) && (p_parser -> hyp[p_parser -> heap[0]].next == p_parser -> pos)) {
+    id = heap_pop(p_parser, p_parser -> heap, &(p_parser -> nber_heap));
+    p_hyp = p_parser -> hyp + id;
+    if(p_hyp -> start < p_parser -> origin) {
+        p_parser -> free_hyp[p_parser -> nber_free ++] = id; // dropped by reset_parser()
+        continue;
+       }
+    crc = CircBufCrc32cCombine(p_hyp -> crc_start, p_parser -> crc, p_parser -> pos - p_hyp -> start);
+    memcpy(p_hyp -> field, &crc, sizeof(uint32_t));
+    p_hyp -> status = expect_chksum;
+    p_hyp -> fill = 0;
+    p_parser -> fields[p_parser -> nber_fields ++] = id;
+   }
+}
+
+// ==============================================================================
+
+// one byte, given to every hypothesis that reads a field, and maybe the start of a new one
+static void parser_step(parser_t *p_parser, uint8_t byte)
+{
+struct parser_hyp_str *p_hyp;
+uint32_t crc_before = p_parser -> crc;
+size_t k, n = 0, id;
+int ret;
+
+p_parser -> crc = CircBufCrc32c(p_parser -> crc, &byte, 1);
+
+for(k = 0; k < p_parser -> nber_fields; k++) {
+    id = p_parser -> fields[k];
+    if(p_parser -> hyp[id].start < p_parser -> origin) {
+        p_parser -> free_hyp[p_parser -> nber_free ++] = id; // dropped by reset_parser()
+        continue;
+       }
+    ret = hyp_add_byte(p_parser, id, byte);
+    if(ret == 0) {
+        p_parser -> fields[n++] = id;
+    } else if(ret == 1) {
+        open_remove(p_parser, id);
+        p_parser -> free_hyp[p_parser -> nber_free ++] = id;
+    } else if(ret == 3) {
+        // returned when no hypothesis that starts before it is open anymore:
+        open_remove(p_parser, id);
+        p_hyp = p_parser -> hyp + id;
+        p_hyp -> status = end_good_packet;
+        p_hyp -> end = p_parser -> pos + 1;
+        p_hyp -> next = p_hyp -> start;
+        heap_push(p_parser, p_parser -> good, &(p_parser -> nber_good), id);
     }
-   } // status == expect_chksum
+   }
+p_parser -> nber_fields = n;
+
+if(p_parser -> magic_first[byte] && ((p_parser -> nber_free > 0) || (p_parser -> nber_used < p_parser -> max_hyp))) {
+    // a new hypothesis:
+    id = (p_parser -> nber_free > 0) ? p_parser -> free_hyp[-- (p_parser -> nber_free)] : p_parser -> nber_used ++;
+    p_hyp = p_parser -> hyp + id;
+    p_hyp -> status = (p_parser -> magic_size == 1) ? expect_size : expect_hdr;
+    p_hyp -> start = p_parser -> pos;
+    p_hyp -> crc_start = crc_before;
+    p_hyp -> field[0] = byte;
+    p_hyp -> fill = (p_parser -> magic_size == 1) ? 0 : 1;
+    p_parser -> fields[p_parser -> nber_fields ++] = id;
+    open_append(p_parser, id);
+   }
+
+p_parser -> pos ++;
+}
+
+// ==============================================================================
+
+// 1 if the good packet that starts first can be returned: no open hypothesis starts before it
+static int parser_good_ready(parser_t *p_parser)
+{
+if(p_parser -> nber_good == 0) return 0;
+if(p_parser -> first_open == PARSER_NONE) return 1;
+return (p_parser -> hyp[p_parser -> first_open].start > p_parser -> hyp[p_parser -> good[0]].start);
+}
+
+// ==============================================================================
+
+// The parser follows every position where a magic starts as a separate hypothesis, all at the same time:
+// each byte is received once, and never given again, neither after a wrong packet nor after a good one (the old version
+// dropped one byte and the caller gave all the others again: quadratic in the packet size on a noisy link).
+//
+//    - a hypothesis that reads its magic, size or checksum looks at each byte,
+//    - a hypothesis that has a valid size waits for the end of its data in a heap: the data is not looked at.
+//      There is only one CRC, over the whole stream: the CRC of a packet comes from the CRC of the stream at its start
+//      and at its end (CircBufCrc32cCombine()). Then the bytes of the checksum are compared to it.
+//    - a hypothesis that gets a good checksum waits in a second heap until all the hypotheses that started before it are
+//      closed (a packet can carry a valid packet in its data: the outer one is returned, as the old version did).
+//      The good packet that starts first is then returned, the bytes before it are skipped.
+//      The hypotheses that start after it go on in the meantime: reset_parser() keeps those that start after its end.
+//    - the wrong hypotheses are dropped without telling the caller: parser_query_skipped() gives the bytes it can discard.
+//
+// Between the fields, when no hypothesis looks at the bytes, the next possible start of a magic is searched with memchr()
+// (or the table of the bytes that can start one), and the CRC is updated over all the bytes skipped in one call.
+//
+// *p_consumed receives the number of bytes of the span used. When a packet is returned, they can go past its end
+// (parser_query_end()), or be 0 if a packet found before is returned. They are kept: they are never given again.
+// The ring buffer readers call this once per segment of their [2][2] indexes (and again after each packet found),
+// with len = 0 at the end of the data to get the packets already complete.
+//
+int parser_add_span(parser_t *p_parser, const uint8_t *ptr, size_t len, size_t *p_consumed)
+{
+size_t i = 0, n, limit, id;
+const uint8_t *p_found;
 
 if(p_parser -> status == end_good_packet) {
     fprintf(stderr,"ERROR: parsing finished (good packet) but still got new data! F:%s L:%d\n",__FILE__,__LINE__);
+    *p_consumed = 0;
+    return error;
   }
-  
-if(p_parser -> status == end_bad_chksum) {
-    fprintf(stderr,"ERROR: parsing finished (bad checksum) but still got new data! F:%s L:%d\n",__FILE__,__LINE__);
-  }
- 
-fprintf(stderr,"unknown status %d F:%s L:%d\n",p_parser -> status, __FILE__,__LINE__);
-fprintf(stderr,"expect_hdr : %d\n",expect_hdr);
-fprintf(stderr,"expect_size : %d\n",expect_size);
-fprintf(stderr,"expect_data : %d\n",expect_data);
-fprintf(stderr,"expect_chksum : %d\n",expect_chksum);
-fprintf(stderr,"end_bad_chksum : %d\n",end_bad_chksum);
-fprintf(stderr,"end_good_packet : %d\n",end_good_packet);
-return error;
+
+while(i < len) {
+
+    if((i > 0) && parser_good_ready(p_parser)) break;
+
+    parser_end_data(p_parser);
+
+    if(p_parser -> nber_fields == 0) {
+        // no hypothesis looks at the bytes: up to the next possible magic, or the next end of data
+        limit = len - i;
+        if((p_parser -> nber_heap > 0) && (p_parser -> hyp[p_parser -> heap[0]].next - p_parser -> pos < limit)) {
+            limit = p_parser -> hyp[p_parser -> heap[0]].next - p_parser -> pos;
+           }
+        if(p_parser -> magic_byte >= 0) {
+            p_found = memchr(ptr + i, p_parser -> magic_byte, limit);
+            n = (p_found == NULL) ? limit : (size_t)(p_found - (ptr + i));
+        } else {
+            for(n = 0; (n < limit) && (p_parser -> magic_first[ptr[i + n]] == 0); n++);
+        }
+        if(n > 0) {
+            p_parser -> crc = CircBufCrc32c(p_parser -> crc, ptr + i, n);
+            p_parser -> pos += n;
+            i += n;
+            continue;
+           }
+       }
+
+    parser_step(p_parser, ptr[i++]);
+   }
+
+*p_consumed = i;
+
+if(!parser_good_ready(p_parser)) return not_finished;
+
+id = heap_pop(p_parser, p_parser -> good, &(p_parser -> nber_good));
+p_parser -> skipped = p_parser -> hyp[id].start - p_parser -> origin;
+p_parser -> end = p_parser -> hyp[id].end - p_parser -> origin;
+p_parser -> free_hyp[p_parser -> nber_free ++] = id;
+p_parser -> status = end_good_packet;
+return finished_good_pack;
+}
+
+// ==============================================================================
+
+// the byte is always received, even when a packet found before is returned
+int parser_add_byte(parser_t *p_parser, uint8_t byte)
+{
+size_t consumed;
+return parser_add_span(p_parser, &byte, 1, &consumed);
 }
 
 // ==============================================================================
 
 void print_parser_status(FILE *f, parser_t *p_parser)
 {
- switch(p_parser -> status)
+enum parser_status status = p_parser -> status;
+size_t k;
+
+// the most advanced hypothesis:
+if(status != end_good_packet) {
+    if(p_parser -> nber_heap > 0) status = expect_data;
+    if(p_parser -> nber_good > 0) status = expect_chksum;
+    for(k = 0; k < p_parser -> nber_fields; k++) {
+        if(p_parser -> hyp[p_parser -> fields[k]].status > status) status = p_parser -> hyp[p_parser -> fields[k]].status;
+       }
+   }
+
+ switch(status)
  {
   case expect_hdr:
         fprintf(f,"expect_hdr\n");
         break;
   case expect_size:
         fprintf(f,"expect_size\n");
-        break;   
+        break;
   case expect_data:
         fprintf(f,"expect_data\n");
-        break;   
+        break;
   case expect_chksum:
         fprintf(f,"expect_chksum\n");
         break;
-  case end_bad_chksum:
-        fprintf(f,"end_bad_chksum\n");
-        break;
   case end_good_packet:
         fprintf(f,"end_good_packet\n");
         break;
   default:
         fprintf(f,"- other unknown -\n");
  }
+if(status != end_good_packet) fprintf(f,"  %lu hypotheses, %lu good packets held\n", p_parser -> nber_fields + p_parser -> nber_heap, p_parser -> nber_good);
 }
 
 // ==============================================================================
 
-int init_parser( parser_t **p_p_parser, 
-                 size_t magic_size, 
-                 size_t size_size, 
-                 size_t chksum_size, 
+int init_parser( parser_t **p_p_parser,
+                 size_t magic_size,
+                 size_t size_size,
+                 size_t chksum_size,
                  size_t max_packet_size,
                  int (*is_magic)(void *to_check, int size_to_check))
 {
+if((magic_size == 0) || (magic_size > PARSER_MAX_FIELD)) {fprintf(stderr,"ERROR: magic of %lu bytes. F:%s L:%d\n",magic_size,__FILE__,__LINE__); return 1;}
+if((size_size != 1) && (size_size != 2) && (size_size != 4) && (size_size != 8)) {fprintf(stderr,"ERROR: size of %lu bytes. F:%s L:%d\n",size_size,__FILE__,__LINE__); return 1;}
+if(chksum_size != sizeof(uint32_t)) {fprintf(stderr,"ERROR: the checksum is a CRC-32C (4 bytes). F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
 *p_p_parser = malloc(sizeof(parser_t));
 if(*p_p_parser == NULL) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); return 1;}
 parser_t *p_parser = *p_p_parser;
 
 p_parser -> is_magic = is_magic;
 
-p_parser -> status = expect_hdr;
-p_parser -> skipped = 0;
-p_parser -> cur_fill = 0;
-p_parser -> total_pack_size = 0;
-
 p_parser -> magic_size = magic_size;
 p_parser -> size_size = size_size;
 p_parser -> max_packet_size = max_packet_size;
 p_parser -> chksum_size = chksum_size;
 
-size_t min_tmpbufsize = 0;
-if(p_parser -> magic_size  > min_tmpbufsize) min_tmpbufsize = p_parser -> magic_size;
-if(p_parser -> size_size   > min_tmpbufsize) min_tmpbufsize = p_parser -> size_size;
-if(p_parser -> chksum_size > min_tmpbufsize) min_tmpbufsize = p_parser -> chksum_size;
-p_parser -> tmp_buf = malloc(min_tmpbufsize);
-if(p_parser -> tmp_buf == NULL) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); return 1;}
-//p_parser -> tmp_buf_size = 0;
+// the bytes that can start a magic:
+int b, nber_first = 0;
+uint8_t byte;
+p_parser -> magic_byte = -1;
+for(b = 0; b < 256; b++) {
+    byte = b;
+    p_parser -> magic_first[b] = (is_magic(&byte, 1) == 0);
+    if(p_parser -> magic_first[b]) {
+        nber_first++;
+        p_parser -> magic_byte = b;
+       }
+   }
+if(nber_first != 1) p_parser -> magic_byte = -1;
+
+// a hypothesis lives at most max_packet_size bytes (or magic + size bytes if that is larger), and one starts at most on each byte.
+// Twice that: the good packets held wait for the hypotheses that start before them, the ones dropped by reset_parser() are freed later.
+p_parser -> max_hyp = 2 * (max_packet_size + magic_size + size_size) + 1;
+p_parser -> hyp = malloc(p_parser -> max_hyp * sizeof(struct parser_hyp_str));
+p_parser -> free_hyp = malloc(p_parser -> max_hyp * sizeof(size_t));
+p_parser -> fields = malloc(p_parser -> max_hyp * sizeof(size_t));
+p_parser -> heap = malloc(p_parser -> max_hyp * sizeof(size_t));
+p_parser -> good = malloc(p_parser -> max_hyp * sizeof(size_t));
+if((p_parser -> hyp == NULL) || (p_parser -> free_hyp == NULL) || (p_parser -> fields == NULL) || (p_parser -> heap == NULL) || (p_parser -> good == NULL)) {
+    fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__);
+    return 1;
+   }
 
-return 0;
+p_parser -> status = expect_hdr; // full reset
+return reset_parser(p_parser);
 }
 
 // ==============================================================================
 
+// After a good packet: the parser continues just after its end, with the bytes it already received after it.
+// The hypotheses that start inside the packet are dropped (the ones in fields or in heap when they are reached again),
+// the others are kept: the positions and the CRC are counted from the last full reset, origin moves to the end of the packet.
+// Otherwise: full reset, all the bytes received are forgotten.
 int reset_parser(parser_t *p_parser)
 {
+size_t id;
+
+if(p_parser -> status == end_good_packet) {
+    p_parser -> origin += p_parser -> end;
+    p_parser -> status = expect_hdr;
+    p_parser -> skipped = 0;
+    p_parser -> end = 0;
+    while((p_parser -> first_open != PARSER_NONE) && (p_parser -> hyp[p_parser -> first_open].start < p_parser -> origin)) {
+        open_remove(p_parser, p_parser -> first_open);
+       }
+    while((p_parser -> nber_good > 0) && (p_parser -> hyp[p_parser -> good[0]].start < p_parser -> origin)) {
+        id = heap_pop(p_parser, p_parser -> good, &(p_parser -> nber_good));
+        p_parser -> free_hyp[p_parser -> nber_free ++] = id;
+       }
+    return 0;
+  }
+
 p_parser -> status = expect_hdr;
+p_parser -> origin = 0;
 p_parser -> skipped = 0;
-p_parser -> cur_fill = 0;
-p_parser -> total_pack_size = 0;
+p_parser -> end = 0;
+p_parser -> pos = 0;
+p_parser -> crc = 0;
+
+p_parser -> nber_used = 0;
+p_parser -> nber_free = 0;
+p_parser -> nber_fields = 0;
+p_parser -> nber_heap = 0;
+p_parser -> nber_good = 0;
+p_parser -> first_open = PARSER_NONE;
+p_parser -> last_open = PARSER_NONE;
 
 return 0;
 }
@@ -307,10 +521,13 @@ return 0;
 int clear_parser(parser_t **p_p_parser)
 {
 parser_t *p_parser = *p_p_parser;
-free(p_parser -> tmp_buf);
-p_parser -> tmp_buf = NULL;
+free(p_parser -> hyp);
+free(p_parser -> free_hyp);
+free(p_parser -> fields);
+free(p_parser -> heap);
+free(p_parser -> good);
+p_parser -> hyp = NULL;
 free(*p_p_parser);
 *p_p_parser = NULL;
- return 0;   
+ return 0;
 }
-
@@ -9,8 +9,8 @@
 // returned by the parser from parser_add() after insertion of some data 
 enum parser_op_result {
     not_finished, // expecting more bytes
-    finished_bad_pack, // finished but the packet is bad
-    finished_good_pack, // finished, and the packet is good : don't forget to read the number of rejected bytes!
+    finished_bad_pack, // finished but the packet is bad (not returned anymore: the wrong packets are dropped inside the parser)
+    finished_good_pack, // finished, and the packet is good : don't forget to read the number of rejected bytes, and where it ends!
     error // a fatal error has been encountered: better terminate the whole process...
 };
 
@@ -19,7 +19,9 @@ typedef struct parser_str parser_t;
 
 
 size_t parser_query_skipped(parser_t *p_parser);
+size_t parser_query_end(parser_t *p_parser);
 int parser_add_byte(parser_t *p_parser, uint8_t byte);
+int parser_add_span(parser_t *p_parser, const uint8_t *ptr, size_t len, size_t *p_consumed);
 void print_parser_status(FILE *f, parser_t *p_parser);
 int init_parser( parser_t **p_p_parser, 
                  size_t magic_size, 
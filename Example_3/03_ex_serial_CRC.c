@@ -14,7 +14,8 @@
   
   Here we don't simulate missing bytes nor altered bytes within packets, so packet loss must be zero in this simulation.
  
- Note about the CRC calculation: here we use crc32() from zlib.
+ Note about the CRC calculation: here we use the CRC-32C of circ_buf_crc.c (hardware version when available).
+ The writer builds each packet directly in the ring, and computes its CRC over the two segments of the ring.
  
  
 */
@@ -27,9 +28,9 @@
 #include <string.h>
 #include <sys/time.h>
 
-#include <zlib.h>
-
 #include "circ_buf.h"
+#include "circ_buf_copy.h"
+#include "circ_buf_crc.h"
 
 #include "03_ex_pack.h"
 #include "03_ex_parser.h"
@@ -56,6 +57,17 @@ for(i=0; i< size; i++) tab_bytes[i] = 256 * drand48();
 }
 
 
+// ==============================================================================
+
+//
+// address of the byte number pos in the ranges p (ring of bytes)
+//
+uint8_t *range_byte(uint8_t *buf, CCBFsize_t (*p)[2][2], size_t pos)
+{
+if(pos < CircBufSz(0, (*p))) return buf + (*p)[0][0] + pos;
+return buf + (*p)[1][0] + (pos - CircBufSz(0, (*p)));
+}
+
 // ==============================================================================
 
 //
@@ -73,7 +85,7 @@ CCBFsize_t BufWrInd[2][2];
 
 size_t data_size, full_size;
 
-size_t Nremaining, NtoCopy, NCopied;
+size_t NCopied;
 
 double TimeSincePrinted = 0; // in ms
 double timeoutPrint = 300; // in ms
@@ -107,40 +119,25 @@ while( k < p_data -> Ninsertions) {
     if(CircBufSzSum(BufWrInd) >= full_size) {
         // we have enough size to write our packet
         
-        void *packbuf = malloc(full_size);
-        if(packbuf == NULL) {fprintf(stderr,"ERROR malloc failed. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
-    
-        pack_hdr_t *hdr = packbuf;
-        hdr -> magic = hdrMAGIC;
-        hdr -> size = full_size;
+        // the packet is written in place, in the ring:
+        pack_hdr_t hdr;
+        hdr.magic = hdrMAGIC;
+        hdr.size = full_size;
+        NCopied = CircBufCopyToRanges(p_data -> buf, 1, &BufWrInd, &hdr, sizeof(pack_hdr_t), 0);
+        if(NCopied != sizeof(pack_hdr_t)) {fprintf(stderr,"incorrect nber of items copied. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
         
-        if(data_size > 0) {
-            //memset(packbuf + sizeof(pack_hdr_t), 0, data_size);
-            randomize_struct(packbuf + sizeof(pack_hdr_t), data_size);
+        for(size_t i = 0; i < data_size; i++) {
+            *range_byte(p_data -> buf, &BufWrInd, sizeof(pack_hdr_t) + i) = 256 * drand48();
            }
         
-        uLong crc = crc32(0L, Z_NULL, 0);
-        crc = crc32(crc, packbuf, sizeof(pack_hdr_t) + data_size);
-    
-        uint32_t *p_crc = packbuf + sizeof(pack_hdr_t) + data_size;
-        *p_crc = crc;
-                
-        NCopied = 0; 
-        for(m=0; m<2; m++) { 
-            if(NCopied < full_size) { 
-                Nremaining = full_size - NCopied;
-                NtoCopy = CircBufSz(m,BufWrInd) < Nremaining ? CircBufSz(m,BufWrInd) : Nremaining;
-                memcpy(p_data -> buf + BufWrInd[m][0], packbuf + NCopied, NtoCopy ); 
-                NCopied += NtoCopy;
-              }
-            }
-
-        if(NCopied != full_size) {fprintf(stderr,"incorrect nber of items copied. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+        // CRC of the header and the data, where they are: no copy even if the packet wraps around
+        uint32_t crc = CircBufCrc32cRanges(0, p_data -> buf, 1, &BufWrInd, sizeof(pack_hdr_t) + data_size);
+        for(m = 0; m < sizeof(uint32_t); m++) {
+            *range_byte(p_data -> buf, &BufWrInd, sizeof(pack_hdr_t) + data_size + m) = ((uint8_t *)&crc)[m];
+           }
         
         ret = CircBufUpdtWr(CIRCBUF(p_data -> p_RingBuf), full_size);
         if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
-        
-        free(packbuf);
     
         // see if we can add some "noise" here: write useless bytes:
         
@@ -164,10 +161,11 @@ while( k < p_data -> Ninsertions) {
                         }
                    } // i
                } // m
+            ret = CircBufUpdtWr(CIRCBUF(p_data -> p_RingBuf), NCopied);
+            if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+            printf("(%d bad bytes written)\n", (int)NCopied);
             } // Nbad > 0
            
-           printf("(%d bad bytes written)\n", (int)NCopied);
-           
            } // CircBufSzSum(BufWrInd) > 0
         
         k++;
@@ -242,7 +240,9 @@ ret = init_parser(&p_parser,
 if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
 
 
-int nber_bad = 0, nber_good = 0; // count the number of good and bad packets
+int nber_good = 0; // count the number of good packets
+size_t nber_skipped = 0; // bytes discarded (noise)
+size_t dropped = 0; // bytes of the current parser already removed from the ring (at the start of the ring)
 
 // the loop here is a little different from the other examples: we use a timeout to stop waiting for new data  
 size_t iter = 0, iter_buf_empty = 0;
@@ -275,37 +275,37 @@ while( TimeSinceReceived < timeout) {
         // we have received new data: reset timeout
         gettimeofday( &t_start, NULL);
            
-        size_t Nread = 0;
-        int m = 0;
-        size_t to_remove = 0;
+        size_t Nread = last_size, seg_size, i, consumed;
+        int m;
+        size_t to_remove = 0, base = 0; // base: position in the ring of the start of the current parser (after dropped)
         
-        while( m<2 ) {
-            size_t i=RdInd[m][0];
-            while( i <= RdInd[m][1] ) {
-                Nread++;
-                if(Nread > last_size) {
-                    printf("%02x ", p_data -> buf[i]);
-                    ret = parser_add_byte(p_parser, p_data -> buf[i]);
-                    if(ret == error) {fprintf(stderr," ERROR F:%s L:%d\n",__FILE__,__LINE__);exit(1);}
-
-                    if(ret == finished_good_pack) {
-                        printf(" GOOD packet received! Nread = %lu / %lu; m = %d ; i = %lu\n", Nread,cur_size, m,i);
-                        nber_good ++;
-                        to_remove = Nread;
-                        reset_parser(p_parser);
-                        }
-                    if(ret == finished_bad_pack) {
-                        printf(" BAD packet received... m = %d ; i = %lu\n", m,i);
-                        printf("   %u : %u  ;  %u : %u\n", RdInd[0][0], RdInd[0][1], RdInd[1][0], RdInd[1][1]);
-                        nber_bad ++;
-                        to_remove = Nread;
-                        reset_parser(p_parser);
-                        }
-                   }// Nread > last_size
-             i++;
-            } // i
-            m++;
-        } // m
+        // the segments are given to the parser directly, starting after the bytes it already has,
+        // each byte once: after a packet, the parser continues with the bytes it received after it (len = 0 at the end of the data)
+        ret = not_finished;
+        while((Nread < cur_size) || (ret == finished_good_pack)) {
+            m = (Nread < CircBufSz(0, RdInd)) ? 0 : 1;
+            i = (m == 0) ? Nread : Nread - CircBufSz(0, RdInd);
+            seg_size = CircBufSz(m, RdInd);
+            ret = parser_add_span(p_parser, p_data -> buf + RdInd[m][0] + i, seg_size - i, &consumed);
+            if(ret == error) {fprintf(stderr," ERROR F:%s L:%d\n",__FILE__,__LINE__);exit(1);}
+            Nread += consumed;
+
+            if(ret == finished_good_pack) {
+                // the parser may have read past the packet: it keeps those bytes, the next packet starts just after this one
+                base = base + parser_query_end(p_parser) - dropped;
+                printf(" GOOD packet received! end = %lu, Nread = %lu / %lu (%lu bytes skipped)\n", base, Nread, cur_size, parser_query_skipped(p_parser));
+                nber_good ++;
+                nber_skipped += parser_query_skipped(p_parser) - dropped;
+                dropped = 0;
+                reset_parser(p_parser);
+                }
+           } // Nread
+        
+        // the bytes that no packet can start from anymore (noise, wrong packets) are discarded too, the parser keeps the others:
+        size_t skipped = parser_query_skipped(p_parser);
+        to_remove = base + (skipped - dropped);
+        nber_skipped += skipped - dropped;
+        dropped = skipped;
         printf("\n Nread : %lu    last : %lu\n", Nread, last_size);
         
         if(to_remove > 0) {
@@ -345,7 +345,7 @@ printf("indexes at exit from reader:   %u : %u  ;  %u : %u\n", RdInd[0][0], RdIn
 printf("cur size : %lu\n", cur_size);
 printf("last size : %lu\n", last_size);
 printf("good packets: %d\n", nber_good);
-printf("bad packets: %d\n",nber_bad );
+printf("bytes skipped: %lu\n", nber_skipped);
 printf("iter buf empty: %lu / %lu\n", iter_buf_empty, iter);
 fprintf(stderr,"Reader finished.\n");
 return NULL;    
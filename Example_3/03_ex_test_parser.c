@@ -13,8 +13,9 @@ The parser needed some tests, even is this is only an example.
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <string.h>
 
-#include <zlib.h>
+#include "circ_buf_crc.h"
 
 #include "03_ex_pack.h"
 #include "03_ex_parser.h"
@@ -31,8 +32,7 @@ typedef struct __attribute__((packed)) test_pack_str
 
 void fill_crc(testpack_t *p_pack)
 {
- uLong crc = crc32(0L, Z_NULL, 0);
- p_pack -> chksum = crc32(crc, (void *)p_pack, sizeof(testpack_t) - sizeof(uint32_t) );
+ p_pack -> chksum = CircBufCrc32c(0, (void *)p_pack, sizeof(testpack_t) - sizeof(uint32_t) );
 }
 
 // ==============================================================================
@@ -71,6 +71,173 @@ return 0;
 
 // ==============================================================================
 
+#define STREAM_MAX_DATA 200
+#define MAX_RESULTS 10000
+#define STREAM_PADDING 300
+
+struct parse_result_str
+{
+  int ret;
+  size_t start; // position of the first byte of the packet
+  size_t end; // position of the byte that finished the packet
+  size_t skipped;
+};
+
+enum noise_kind {
+    noise_no_magic, // random bytes, without the bytes of the magic
+    noise_random, // random bytes
+    noise_headers, // headers of packets with the maximum size: each one stays a hypothesis until the end of its data
+    noise_nested // random bytes, and packets that carry a valid packet in their data: only the outer one is a packet
+};
+
+//
+// writes nber_packs packets in stream, with noise before some of them, and with a byte altered in some packets if corrupt != 0
+// expected receives the packets that are not altered. returns the size of the stream
+//
+size_t make_stream(uint8_t *stream, size_t nber_packs, enum noise_kind noise, int corrupt, struct parse_result_str *expected, size_t *p_nber_expected)
+{
+size_t pos = 0, k, j, n, data_size, in_size, in_pos;
+pack_hdr_t hdr, in_hdr;
+uint32_t crc;
+
+*p_nber_expected = 0;
+for(k = 0; k < nber_packs; k++) {
+    if(drand48() < 0.5) {
+        n = 30 * drand48();
+        randomize_struct(stream + pos, n);
+        for(j = 0; j < n; j++) {
+            if((noise == noise_no_magic) && (stream[pos + j] == (uint8_t)hdrMAGIC)) stream[pos + j] = 0;
+            if((noise == noise_headers) && (j % sizeof(pack_hdr_t) == 0) && (j + sizeof(pack_hdr_t) <= n)) {
+                hdr.magic = hdrMAGIC;
+                hdr.size = 300;
+                memcpy(stream + pos + j, &hdr, sizeof(pack_hdr_t));
+               }
+           }
+        pos += n;
+       }
+    data_size = (STREAM_MAX_DATA + 1) * drand48();
+    if(data_size > STREAM_MAX_DATA) data_size = STREAM_MAX_DATA;
+    hdr.magic = hdrMAGIC;
+    hdr.size = sizeof(pack_hdr_t) + data_size + sizeof(uint32_t);
+    memcpy(stream + pos, &hdr, sizeof(pack_hdr_t));
+    randomize_struct(stream + pos + sizeof(pack_hdr_t), data_size);
+    in_size = 0;
+    if((noise == noise_nested) && (data_size >= sizeof(pack_hdr_t) + sizeof(uint32_t))) {
+        in_size = sizeof(pack_hdr_t) + sizeof(uint32_t) + (data_size - sizeof(pack_hdr_t) - sizeof(uint32_t)) * drand48();
+        in_pos = pos + sizeof(pack_hdr_t) + (size_t)((data_size - in_size) * drand48());
+        in_hdr.magic = hdrMAGIC;
+        in_hdr.size = in_size;
+        memcpy(stream + in_pos, &in_hdr, sizeof(pack_hdr_t));
+        crc = CircBufCrc32c(0, stream + in_pos, in_size - sizeof(uint32_t));
+        memcpy(stream + in_pos + in_size - sizeof(uint32_t), &crc, sizeof(uint32_t));
+       }
+    crc = CircBufCrc32c(0, stream + pos, sizeof(pack_hdr_t) + data_size);
+    memcpy(stream + pos + sizeof(pack_hdr_t) + data_size, &crc, sizeof(uint32_t));
+    if(corrupt && (in_size > 0) && (drand48() < 0.2)) {
+        // the checksum of the outer packet only: the inner one is found
+        stream[pos + hdr.size - 1] ^= (uint8_t)(1 + 254 * drand48());
+        expected[*p_nber_expected].ret = finished_good_pack;
+        expected[*p_nber_expected].start = in_pos;
+        expected[*p_nber_expected].end = in_pos + in_size - 1;
+        (*p_nber_expected)++;
+    } else if(corrupt && (in_size == 0) && (drand48() < 0.2)) {
+        stream[pos + (size_t)(hdr.size * drand48())] ^= (uint8_t)(1 + 254 * drand48()); // never 0
+    } else {
+        expected[*p_nber_expected].ret = finished_good_pack;
+        expected[*p_nber_expected].start = pos;
+        expected[*p_nber_expected].end = pos + hdr.size - 1;
+        (*p_nber_expected)++;
+    }
+    pos += hdr.size;
+   }
+// followed by zeros, as long as the largest packet: the hypotheses still open at the end fail, and the good packets they held back are returned
+memset(stream + pos, 0, STREAM_PADDING);
+pos += STREAM_PADDING;
+return pos;
+}
+
+// ==============================================================================
+
+//
+// the stream parsed byte per byte (byte_per_byte != 0) or in spans of random lengths, like the segments of a ring
+// each byte is given once: after a packet, the parser continues with the bytes it already has (len = 0 at the end of the stream)
+// returns the number of results (packets found)
+//
+size_t parse_stream(parser_t *p_parser, const uint8_t *stream, size_t size, int byte_per_byte, struct parse_result_str *results)
+{
+size_t pos = 0, nres = 0, span, consumed, base = 0;
+int ret = not_finished;
+
+reset_parser(p_parser);
+while((pos < size) || (ret == finished_good_pack)) {
+    if(pos == size) {
+        ret = parser_add_span(p_parser, stream + pos, 0, &consumed);
+        if(consumed != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    } else if(byte_per_byte) {
+        ret = parser_add_byte(p_parser, stream[pos]);
+        consumed = 1;
+    } else {
+        span = 1 + (size - pos) * drand48();
+        if(drand48() < 0.5) span = 1 + 20 * drand48(); // short segments too
+        if(span > size - pos) span = size - pos;
+        ret = parser_add_span(p_parser, stream + pos, span, &consumed);
+        if(consumed > span) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+        if((ret == not_finished) && (consumed != span)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    }
+    if((ret != not_finished) && (ret != finished_good_pack)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    pos += consumed;
+    if(parser_query_skipped(p_parser) > pos - base) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if(ret == finished_good_pack) {
+        if(nres == MAX_RESULTS) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+        if((parser_query_end(p_parser) > pos - base) || (parser_query_end(p_parser) <= parser_query_skipped(p_parser))) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+        results[nres].ret = ret;
+        results[nres].skipped = parser_query_skipped(p_parser);
+        results[nres].start = base + results[nres].skipped;
+        results[nres].end = base + parser_query_end(p_parser) - 1;
+        nres++;
+        // the bytes read after the packet are kept by the parser:
+        base += parser_query_end(p_parser);
+        reset_parser(p_parser);
+       }
+   }
+return nres;
+}
+
+// ==============================================================================
+
+//
+// every packet that is not altered is found, whatever the noise, in a single pass,
+// and parser_add_span() gives the same results as parser_add_byte()
+//
+void test_spans(size_t nber_packs, enum noise_kind noise, int corrupt)
+{
+static struct parse_result_str expected[MAX_RESULTS], by_byte[MAX_RESULTS], by_span[MAX_RESULTS];
+size_t size, nexp, nbyte, nspan, k;
+uint8_t *stream;
+parser_t *p_parser;
+
+stream = malloc(nber_packs * (30 + sizeof(pack_hdr_t) + STREAM_MAX_DATA + sizeof(uint32_t)) + STREAM_PADDING);
+if(stream == NULL) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(init_parser(&p_parser, sizeof(magic_t), sizeof(PackSize_t), sizeof(uint32_t), 300, check_magic) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+size = make_stream(stream, nber_packs, noise, corrupt, expected, &nexp);
+nbyte = parse_stream(p_parser, stream, size, 1, by_byte);
+nspan = parse_stream(p_parser, stream, size, 0, by_span);
+
+if((nbyte != nexp) || (nspan != nexp)) {fprintf(stderr,"ERROR %lu %lu %lu F:%s L:%d\n",nexp,nbyte,nspan,__FILE__,__LINE__); exit(1);}
+for(k = 0; k < nexp; k++) {
+    if((by_byte[k].start != expected[k].start) || (by_byte[k].end != expected[k].end)) {fprintf(stderr,"ERROR packet %lu F:%s L:%d\n",k,__FILE__,__LINE__); exit(1);}
+    if((by_span[k].start != expected[k].start) || (by_span[k].end != expected[k].end)) {fprintf(stderr,"ERROR packet %lu F:%s L:%d\n",k,__FILE__,__LINE__); exit(1);}
+    if(by_byte[k].skipped != expected[k].start - ((k == 0) ? 0 : expected[k - 1].end + 1)) {fprintf(stderr,"ERROR packet %lu F:%s L:%d\n",k,__FILE__,__LINE__); exit(1);}
+   }
+printf("stream of %lu bytes, %lu packets, noise %d%s: the %lu good packets found, byte per byte and by spans\n", size, nber_packs, noise, corrupt ? ", altered packets" : "", nexp);
+
+clear_parser(&p_parser);
+free(stream);
+}
+
+// ==============================================================================
+
 int main(void)
 {
 int ret;
@@ -147,7 +314,7 @@ reset_parser(p_parser);
 
 printf("------ test pack 2  --------\n");
 
-uint8_t testpack2[] = {0x55, 0x55, 0x08, 0x00, 0xdf, 0x46, 0x39, 0x7f}; // packet with 0 data size
+uint8_t testpack2[] = {0x55, 0x55, 0x08, 0x00, 0xd9, 0x36, 0x8e, 0xbd}; // packet with 0 data size
 
 print_parser_status(stdout, p_parser);
 
@@ -175,6 +342,17 @@ for(i=0; i< sizeof(testpack2); i++) {
     } // i
 printf("\n");
 print_parser_status(stdout, p_parser);
+clear_parser(&p_parser);
+
+printf("------ spans  --------\n");
+
+test_spans(1000, noise_no_magic, 0);
+test_spans(1000, noise_random, 0);
+test_spans(1000, noise_headers, 0);
+test_spans(1000, noise_random, 1);
+test_spans(1000, noise_headers, 1);
+test_spans(1000, noise_nested, 0);
+test_spans(1000, noise_nested, 1);
     
 printf("OK.\n");
 return 0;    
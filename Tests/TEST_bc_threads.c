@@ -0,0 +1,259 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ One writer, several readers on the same buffer (circ_buf_bc.h)
+
+ The writer stores in every element its absolute position in the stream.
+ Every reader checks that it gets all the elements from the point where it joined, in order, with none missing.
+ The readers leave and join again at random points, while the writer runs.
+
+ Before that, without threads: a reader stalled in CircBufBcJoin() between the claim of its slot and the publication of its
+ RdPos, while the writer has lapped the ring many times: the writer must get no space (and no range outside the buffer),
+ neither from a slot that is still joining, nor from a slot seen active with a stale RdPos.
+ CircBufBcRdInd() and CircBufBcUpdtRd() refuse a slot that is not active.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <sched.h>
+
+#include "circ_buf_bc.h"
+
+
+typedef uint64_t elem_t; // absolute position of the element in the stream
+
+#define MAX_READERS 16
+#define NB_SLOTS 4 // fewer slots than readers: CircBufBcJoin() has to fail sometimes
+
+
+struct shared_thd_data_str
+{
+elem_t *buf;
+CircBufBc_t *p_CrcBuf; // must be aligned on a cache line: allocated with aligned_alloc()
+CircBufBcReader_t *readers; // same
+size_t max_val; // the writer inserts max_val elements, with values from 0 to max_val-1 included
+};
+
+struct reader_data_str
+{
+struct shared_thd_data_str *p_shared;
+int id;
+size_t Njoin; // statistics
+size_t Nread;
+pthread_t thd;
+};
+
+
+void *writer(void *p_usr_in)
+{
+int ret;
+struct shared_thd_data_str *p_data = p_usr_in;
+size_t cur_val = 0; // next value to insert, not yet inserted
+CCBFsize_t WrInd[2][2]; // always 2x2
+size_t Nwritten;
+int m;
+size_t i;
+
+while(cur_val < p_data -> max_val) {
+    ret = CircBufBcWrInd(CIRCBUFBC(p_data -> p_CrcBuf), &WrInd);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    Nwritten = 0;
+    for(m=0; m<2; m++) {
+        for(i=WrInd[m][0]; (i<= WrInd[m][1]) && (cur_val < p_data -> max_val); i++) {
+            p_data -> buf[i] = cur_val;
+            cur_val++;
+            Nwritten++;
+        } // i
+    }// m
+
+    ret = CircBufBcUpdtWr(CIRCBUFBC(p_data -> p_CrcBuf), Nwritten);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if(Nwritten == 0) sched_yield(); // full: let the readers run
+  } // end of while
+
+return NULL;
+}
+
+
+void *reader(void *p_usr_in)
+{
+int ret;
+struct reader_data_str *p_rdr = p_usr_in;
+struct shared_thd_data_str *p_data = p_rdr -> p_shared;
+unsigned short xsubi[3] = {p_rdr -> id, 4321, 8765}; // per thread random state
+CCBFsize_t RdInd[2][2]; // always 2x2
+CCBFsize_t Id;
+size_t next_val; // next value expected
+size_t Nleft; // number of elements to read before leaving
+size_t Nread;
+int m;
+size_t i;
+
+for(;;) {
+    ret = CircBufBcJoin(CIRCBUFBC(p_data -> p_CrcBuf), &Id);
+    if(ret == CCBF_AGAIN) {
+        if(CircBufBcWrOffset(CIRCBUFBC(p_data -> p_CrcBuf)) == p_data -> max_val) break; // writer finished
+        sched_yield(); // all the slots are taken
+        continue;
+       }
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    p_rdr -> Njoin++;
+
+    next_val = CircBufBcRdOffset(CIRCBUFBC(p_data -> p_CrcBuf), Id);
+    Nleft = 1 + 10000 * erand48(xsubi);
+    while((Nleft > 0) && (next_val < p_data -> max_val)) {
+        ret = CircBufBcRdInd(CIRCBUFBC(p_data -> p_CrcBuf), Id, &RdInd);
+        if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+        Nread = 0;
+        for(m=0; m<2; m++) {
+            for(i=RdInd[m][0]; (i<= RdInd[m][1]) && (Nread < Nleft); i++) {
+                if(p_data -> buf[i] != next_val) {
+                    fprintf(stderr,"ERROR: bad value %llu instead of %llu. F:%s L:%d\n",(long long unsigned)p_data -> buf[i], (long long unsigned)next_val, __FILE__,__LINE__);
+                    exit(1);
+                   }
+                next_val++;
+                Nread++;
+                }// i
+           }// m
+
+        ret = CircBufBcUpdtRd(CIRCBUFBC(p_data -> p_CrcBuf), Id, Nread);
+        if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+        Nleft -= Nread;
+        p_rdr -> Nread += Nread;
+        if(Nread == 0) sched_yield(); // empty: let the writer run
+    } // while
+
+    ret = CircBufBcLeave(CIRCBUFBC(p_data -> p_CrcBuf), Id);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if(next_val >= p_data -> max_val) break;
+} // for
+
+return NULL;
+}
+
+
+// true if the ranges are inside a buffer of Nbufsz elements, with Nfree elements in total
+int ranges_ok(CCBFsize_t (*p)[2][2], size_t Nbufsz, size_t Nfree)
+{
+int m;
+for(m=0; m<2; m++) {
+    if(CircBufSz(m, (*p)) == 0) continue;
+    if(((*p)[m][0] > (*p)[m][1]) || ((*p)[m][1] >= Nbufsz)) return 0;
+   }
+return (CircBufSzSum((*p)) == Nfree);
+}
+
+void stalled_join(size_t Nbufsz)
+{
+CircBufBc_t *p_circ = aligned_alloc(CCBF_CACHE_LINE, sizeof(CircBufBc_t));
+CircBufBcReader_t *readers = aligned_alloc(CCBF_CACHE_LINE, 2 * sizeof(CircBufBcReader_t));
+CCBFsize_t WrInd[2][2], RdInd[2][2], Id;
+int k;
+
+if((p_circ == NULL) || (readers == NULL)) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufBcInit(p_circ, Nbufsz, readers, 2) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+// a joiner claims slot 0, then stalls (old RdPos of the slot: 0) while the writer laps the ring:
+CCBF_STORE_RLX(readers[0].State, CCBF_BC_JOINING);
+for(k=0; k< 3; k++) {
+    if(CircBufBcUpdtWr(p_circ, Nbufsz) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+   }
+if(CircBufBcWrInd(p_circ, &WrInd) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(!ranges_ok(&WrInd, Nbufsz, 0)) {fprintf(stderr,"ERROR: space given while a reader joins F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+// the reader functions refuse a slot that is not active (joining, or never joined):
+if(CircBufBcRdInd(p_circ, 0, &RdInd) == 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufBcUpdtRd(p_circ, 0, 1) == 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufBcRdInd(p_circ, 1, &RdInd) == 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufBcUpdtRd(p_circ, 1, 1) == 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+// the same slot seen active with its stale RdPos (left and joined again during a scan): clamped, no space
+CCBF_STORE_RLX(readers[0].State, CCBF_BC_ACTIVE);
+if(CircBufBcWrInd(p_circ, &WrInd) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(!ranges_ok(&WrInd, Nbufsz, 0)) {fprintf(stderr,"ERROR: stale RdPos F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+CCBF_STORE_RLX(readers[0].State, CCBF_BC_FREE);
+
+// a real join now: it starts at the current position, and the writer gets the whole buffer
+if(CircBufBcJoin(p_circ, &Id) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufBcRdOffset(p_circ, Id) != 3 * Nbufsz) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufBcRdInd(p_circ, Id, &RdInd) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(!ranges_ok(&RdInd, Nbufsz, 0)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufBcWrInd(p_circ, &WrInd) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(!ranges_ok(&WrInd, Nbufsz, Nbufsz)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+// after CircBufBcLeave(): refused too, RdPos untouched
+if(CircBufBcLeave(p_circ, Id) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufBcRdInd(p_circ, Id, &RdInd) == 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufBcUpdtRd(p_circ, Id, 1) == 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufBcRdOffset(p_circ, Id) != 3 * Nbufsz) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+free(p_circ);
+free(readers);
+}
+
+int main(int argc, char *argv[])
+{
+size_t MaxVal;
+size_t Nbufsz;
+int Nreaders;
+int ret, k;
+pthread_t writer_thd;
+struct shared_thd_data_str shrd_data;
+struct reader_data_str rd_data[MAX_READERS];
+
+if(argc != 4) {
+    fprintf(stderr,"ERROR: pass the buffer size (power of two), the number of readers and the number of elements to insert\n");
+    return 1;
+   }
+ret = sscanf(argv[1],"%zu",&Nbufsz);
+if(ret != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = sscanf(argv[2],"%d",&Nreaders);
+if((ret != 1) || (Nreaders < 1) || (Nreaders > MAX_READERS)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = sscanf(argv[3],"%zu",&MaxVal);
+if(ret != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+stalled_join(Nbufsz);
+
+printf("Randomized test of the broadcast ring buffer: %llu insertions, %d readers joining and leaving\n", (long long unsigned)MaxVal, Nreaders);
+
+shrd_data.buf = malloc(Nbufsz * sizeof(*(shrd_data.buf)));
+shrd_data.p_CrcBuf = aligned_alloc(CCBF_CACHE_LINE, sizeof(*(shrd_data.p_CrcBuf)));
+shrd_data.readers = aligned_alloc(CCBF_CACHE_LINE, NB_SLOTS * sizeof(*(shrd_data.readers)));
+if((shrd_data.buf == NULL) || (shrd_data.p_CrcBuf == NULL) || (shrd_data.readers == NULL)) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = CircBufBcInit(CIRCBUFBC(shrd_data.p_CrcBuf), Nbufsz, shrd_data.readers, NB_SLOTS);
+if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+shrd_data.max_val = MaxVal;
+
+for(k=0; k< Nreaders; k++) {
+    rd_data[k].p_shared = &shrd_data;
+    rd_data[k].id = k;
+    rd_data[k].Njoin = 0;
+    rd_data[k].Nread = 0;
+    ret = pthread_create(&(rd_data[k].thd), NULL, reader, &(rd_data[k]));
+    if(ret != 0) {fprintf(stderr,"ERROR: cannot create thread. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+   }
+ret = pthread_create(&writer_thd, NULL, writer, &shrd_data);
+if(ret != 0) {fprintf(stderr,"ERROR: cannot create thread. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+pthread_join(writer_thd, NULL);
+for(k=0; k< Nreaders; k++) {
+    pthread_join(rd_data[k].thd, NULL);
+    printf("reader %d: joined %llu times, read %llu elements\n", k, (long long unsigned)rd_data[k].Njoin, (long long unsigned)rd_data[k].Nread);
+   }
+
+free(shrd_data.buf);
+free(shrd_data.p_CrcBuf);
+free(shrd_data.readers);
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
@@ -0,0 +1,210 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Bulk copies (circ_buf_copy.c)
+
+ - random CircBufCopyIn() / CircBufCopyOut() on rings of random sizes, several element sizes, with and without CCBF_COPY_STREAM:
+   the elements come out in order,
+ - large segments (non-temporal copies) across the wrap around, with each non-temporal kernel this CPU has,
+ - CircBufCopyRing() between two rings of different sizes.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "circ_buf.h"
+#include "circ_buf_copy.h"
+
+#define MAX_BATCH 300
+
+// ==============================================================================
+
+//
+// element number Seq: ElemSize bytes that depend on Seq
+//
+void make_elem(uint8_t *p, size_t ElemSize, uint64_t Seq)
+{
+size_t b;
+for(b = 0; b < ElemSize; b++) {
+    p[b] = (uint8_t)(Seq * 131 + b * 7 + (Seq >> 8));
+    }
+}
+
+int check_elems(const uint8_t *p, size_t ElemSize, uint64_t First, CCBFsize_t N)
+{
+uint8_t ref[64];
+CCBFsize_t k;
+for(k = 0; k < N; k++) {
+    make_elem(ref, ElemSize, First + k);
+    if(memcmp(p + (size_t)k * ElemSize, ref, ElemSize) != 0) {fprintf(stderr,"ERROR element %lu F:%s L:%d\n",(unsigned long)(First + k),__FILE__,__LINE__); return 1;}
+    }
+return 0;
+}
+
+// ==============================================================================
+
+int random_copies(size_t ElemSize, unsigned long Nops, unsigned short xsubi[3])
+{
+CircBuf_t CrcBuf;
+CCBFsize_t N = 2 + 200 * erand48(xsubi), n, got, k;
+uint8_t *Data = malloc((size_t)N * ElemSize);
+uint8_t *Buf = malloc((size_t)MAX_BATCH * ElemSize);
+uint64_t wr = 0, rd = 0;
+unsigned long op;
+int ret, Flags;
+
+if((Data == NULL) || (Buf == NULL)) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufInit(CIRCBUF(&CrcBuf), N) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+for(op = 0; op < Nops; op++) {
+    n = MAX_BATCH * erand48(xsubi);
+    Flags = (erand48(xsubi) < 0.5) ? CCBF_COPY_STREAM : 0;
+    if(erand48(xsubi) < 0.5) {
+        for(k = 0; k < n; k++) make_elem(Buf + (size_t)k * ElemSize, ElemSize, wr + k);
+        ret = CircBufCopyIn(CIRCBUF(&CrcBuf), Data, ElemSize, Buf, n, Flags, &got);
+        if((ret == CCBF_AGAIN) && ((n == 0) || (wr - rd != N - 1))) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+        if((ret != 0) && (ret != CCBF_AGAIN)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+        if(got != ((n < N - 1 - (wr - rd)) ? n : N - 1 - (wr - rd))) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+        wr += got;
+        } else {
+        ret = CircBufCopyOut(CIRCBUF(&CrcBuf), Data, ElemSize, Buf, n, Flags, &got);
+        if((ret == CCBF_AGAIN) && ((n == 0) || (wr != rd))) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+        if((ret != 0) && (ret != CCBF_AGAIN)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+        if(got != ((n < wr - rd) ? n : wr - rd)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+        if(check_elems(Buf, ElemSize, rd, got) != 0) return 1;
+        rd += got;
+        }
+   }
+free(Data);
+free(Buf);
+return 0;
+}
+
+// ==============================================================================
+
+//
+// segments of several MB: the non-temporal kernel, across the wrap around
+//
+int large_copies(size_t ElemSize, CCBFsize_t N)
+{
+CircBuf_t CrcBuf;
+uint8_t *Data = malloc((size_t)N * ElemSize);
+uint8_t *Buf = malloc((size_t)N * ElemSize);
+CCBFsize_t got, k, n1 = 2 * (N / 3), n2 = N / 2;
+
+if((Data == NULL) || (Buf == NULL)) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufInit(CIRCBUF(&CrcBuf), N) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+for(k = 0; k < n1; k++) make_elem(Buf + (size_t)k * ElemSize, ElemSize, k);
+if((CircBufCopyIn(CIRCBUF(&CrcBuf), Data, ElemSize, Buf, n1, CCBF_COPY_STREAM, &got) != 0) || (got != n1)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if((CircBufCopyOut(CIRCBUF(&CrcBuf), Data, ElemSize, Buf, n2, CCBF_COPY_STREAM, &got) != 0) || (got != n2)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(check_elems(Buf, ElemSize, 0, n2) != 0) return 1;
+// wraps around:
+for(k = 0; k < n1; k++) make_elem(Buf + (size_t)k * ElemSize, ElemSize, n1 + k);
+if((CircBufCopyIn(CIRCBUF(&CrcBuf), Data, ElemSize, Buf, n1, CCBF_COPY_STREAM, &got) != 0) || (got != n1)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if((CircBufCopyOut(CIRCBUF(&CrcBuf), Data, ElemSize, Buf, N, CCBF_COPY_STREAM, &got) != 0) || (got != 2 * n1 - n2)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(check_elems(Buf, ElemSize, n2, got) != 0) return 1;
+if(CircBufCopyOut(CIRCBUF(&CrcBuf), Data, ElemSize, Buf, 1, 0, &got) != CCBF_AGAIN) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+free(Data);
+free(Buf);
+return 0;
+}
+
+// ==============================================================================
+
+int ring_to_ring(size_t ElemSize, unsigned long Nops, unsigned short xsubi[3])
+{
+CircBuf_t Src, Dst;
+CCBFsize_t Nsrc = 2 + 100 * erand48(xsubi), Ndst = 2 + 100 * erand48(xsubi), n, got, k;
+uint8_t *SrcData = malloc((size_t)Nsrc * ElemSize), *DstData = malloc((size_t)Ndst * ElemSize);
+uint8_t *Buf = malloc((size_t)MAX_BATCH * ElemSize);
+uint64_t wr = 0, mid = 0, rd = 0;
+unsigned long op;
+double u;
+int ret;
+
+if((SrcData == NULL) || (DstData == NULL) || (Buf == NULL)) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufInit(CIRCBUF(&Src), Nsrc) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufInit(CIRCBUF(&Dst), Ndst) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+for(op = 0; op < Nops; op++) {
+    n = MAX_BATCH * erand48(xsubi);
+    u = erand48(xsubi);
+    if(u < 0.33) {
+        for(k = 0; k < n; k++) make_elem(Buf + (size_t)k * ElemSize, ElemSize, wr + k);
+        ret = CircBufCopyIn(CIRCBUF(&Src), SrcData, ElemSize, Buf, n, 0, &got);
+        if((ret != 0) && (ret != CCBF_AGAIN)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+        wr += got;
+        } else if(u < 0.66) {
+        ret = CircBufCopyRing(CIRCBUF(&Src), SrcData, CIRCBUF(&Dst), DstData, ElemSize, n, 0, &got);
+        if((ret != 0) && (ret != CCBF_AGAIN)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+        k = (wr - mid < Ndst - 1 - (mid - rd)) ? wr - mid : Ndst - 1 - (mid - rd);
+        if(got != ((n < k) ? n : k)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+        mid += got;
+        } else {
+        ret = CircBufCopyOut(CIRCBUF(&Dst), DstData, ElemSize, Buf, n, 0, &got);
+        if((ret != 0) && (ret != CCBF_AGAIN)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+        if(check_elems(Buf, ElemSize, rd, got) != 0) return 1;
+        rd += got;
+        }
+   }
+free(SrcData);
+free(DstData);
+free(Buf);
+return 0;
+}
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+const size_t ElemSizes[] = {1, 3, 8, 12, 64};
+const char *Kernels[] = {"avx512", "avx2", "sse2", "memcpy"};
+unsigned short xsubi[3] = {7, 8, 9};
+unsigned long nber_ops;
+int nrings, r;
+size_t e;
+int k;
+
+fprintf(stderr,"Test of the bulk copies, non-temporal kernel: %s\n", CircBufCopyKernel());
+
+if(argc != 3) {
+    fprintf(stderr,"ERROR: pass the number of rings per element size, then the number of copies per ring\n");
+    return 1;
+   }
+if(sscanf(argv[1],"%d",&nrings) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(sscanf(argv[2],"%lu",&nber_ops) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+for(e = 0; e < sizeof(ElemSizes) / sizeof(ElemSizes[0]); e++) {
+    for(r = 0; r < nrings; r++) {
+        if(random_copies(ElemSizes[e], nber_ops, xsubi) != 0) {fprintf(stderr,"ERROR element size %zu F:%s L:%d\n",ElemSizes[e],__FILE__,__LINE__); exit(1);}
+        if(ring_to_ring(ElemSizes[e], nber_ops, xsubi) != 0) {fprintf(stderr,"ERROR element size %zu F:%s L:%d\n",ElemSizes[e],__FILE__,__LINE__); exit(1);}
+        }
+   }
+
+for(k = 0; k < (int)(sizeof(Kernels) / sizeof(Kernels[0])); k++) {
+    if(CircBufCopySetKernel(Kernels[k]) != 0) {
+        fprintf(stderr,"no %s on this CPU\n", Kernels[k]);
+        continue;
+        }
+    if(strcmp(CircBufCopyKernel(), Kernels[k]) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    fprintf(stderr,"large copies, %s\n", Kernels[k]);
+    if(large_copies(1, 3000001) != 0) {fprintf(stderr,"ERROR %s F:%s L:%d\n",Kernels[k],__FILE__,__LINE__); exit(1);}
+    if(large_copies(12, 700001) != 0) {fprintf(stderr,"ERROR %s F:%s L:%d\n",Kernels[k],__FILE__,__LINE__); exit(1);}
+   }
+if(CircBufCopySetKernel("avx1024") == 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+if(CircBufCopyIn(NULL, xsubi, 1, xsubi, 1, 0, NULL) == 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
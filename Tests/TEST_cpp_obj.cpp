@@ -0,0 +1,188 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Ring of C++ objects (circ_buf_obj.hpp)
+
+ - random emplace / pop / bulk operations with an object type that counts the live instances:
+   no object is leaked nor destroyed twice, and the values come back in order,
+ - an exception thrown while constructing or consuming in bulk,
+ - std::unique_ptr passed from one writer thread to one reader thread.
+
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "circ_buf_obj.hpp"
+
+
+// ==============================================================================
+
+// counts the live instances, and carries a value
+struct Counted
+{
+  static inline long Nlive = 0;
+  std::string val; // non trivial on purpose
+
+  explicit Counted(std::uint32_t v) : val(std::to_string(v) + " some text long enough to be allocated on the heap") { Nlive++; }
+  Counted(Counted &&o) noexcept : val(std::move(o.val)) { Nlive++; }
+  Counted &operator=(Counted &&o) noexcept { val = std::move(o.val); return *this; }
+  ~Counted() { Nlive--; }
+};
+
+static std::string expected(std::uint32_t v)
+{
+return std::to_string(v) + " some text long enough to be allocated on the heap";
+}
+
+// ==============================================================================
+
+template<std::size_t N>
+int rand_test(std::size_t nber_test_elems)
+{
+unsigned short xsubi[3] = {N & 0xFFFF, 3, 4};
+std::uint32_t cur_write = 0, cur_check = 0;
+{
+auto p_ring = std::make_unique<ccbf::ObjectRing<Counted, N>>();
+auto &ring = *p_ring;
+
+while(cur_check < nber_test_elems) {
+    std::size_t Nlive_ring = cur_write - cur_check;
+    if((std::size_t)Counted::Nlive != Nlive_ring) {fprintf(stderr,"ERROR %ld live objects instead of %zu F:%s L:%d\n",Counted::Nlive,Nlive_ring,__FILE__,__LINE__); return 1;}
+    if(ring.AvailRd() != Nlive_ring) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+    // add:
+    std::size_t NtoAdd = N * erand48(xsubi);
+    if(NtoAdd > nber_test_elems - cur_write) NtoAdd = nber_test_elems - cur_write;
+    if(erand48(xsubi) < 0.5) {
+        std::size_t Nadded = ring.emplace_bulk(NtoAdd, [&]() { return Counted(cur_write++); });
+        if(Nadded != std::min(NtoAdd, N - 1 - Nlive_ring)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    } else {
+        for(std::size_t k = 0; k < NtoAdd; k++) {
+            bool ok = ring.emplace(cur_write);
+            if(ok != (Nlive_ring + k < N - 1)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+            if(ok) cur_write++;
+            }
+    }
+
+    // read:
+    std::size_t NtoRead = N * erand48(xsubi);
+    if(erand48(xsubi) < 0.5) {
+        ring.consume_bulk(NtoRead, [&](Counted &&c) {
+            if(c.val != expected(cur_check)) {fprintf(stderr,"ERROR bad value F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+            cur_check++;
+            });
+    } else {
+        Counted c(0);
+        for(std::size_t k = 0; (k < NtoRead) && ring.pop(c); k++) {
+            if(c.val != expected(cur_check)) {fprintf(stderr,"ERROR bad value F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+            cur_check++;
+            }
+    }
+   }
+
+// leave some objects in the ring: the destructor must destroy them
+for(std::size_t k = 0; k < N / 2; k++) ring.emplace(k);
+}
+if(Counted::Nlive != 0) {fprintf(stderr,"ERROR %ld objects leaked F:%s L:%d\n",Counted::Nlive,__FILE__,__LINE__); return 1;}
+return 0;
+}
+
+// ==============================================================================
+
+int exception_test()
+{
+{
+ccbf::ObjectRing<Counted, 8> ring;
+std::uint32_t k = 0;
+try {
+    ring.emplace_bulk(7, [&]() { if(k == 5) throw std::runtime_error("make"); return Counted(k++); });
+    fprintf(stderr,"ERROR no exception F:%s L:%d\n",__FILE__,__LINE__); return 1;
+} catch(std::runtime_error &) {}
+if((ring.AvailRd() != 5) || (Counted::Nlive != 5)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+k = 0;
+try {
+    ring.consume_bulk(5, [&](Counted &&) { if(k == 2) throw std::runtime_error("consume"); k++; });
+    fprintf(stderr,"ERROR no exception F:%s L:%d\n",__FILE__,__LINE__); return 1;
+} catch(std::runtime_error &) {}
+// 2 consumed, the third one given to consume() is dropped:
+if((ring.AvailRd() != 2) || (Counted::Nlive != 2)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+Counted c(0);
+if(!ring.pop(c) || (c.val != expected(3))) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+}
+if(Counted::Nlive != 0) {fprintf(stderr,"ERROR %ld objects leaked F:%s L:%d\n",Counted::Nlive,__FILE__,__LINE__); return 1;}
+return 0;
+}
+
+// ==============================================================================
+
+int thread_test(std::uint32_t max_val)
+{
+static ccbf::ObjectRing<std::unique_ptr<std::uint32_t>, 64> ring;
+
+std::thread writer([&]() {
+    std::uint32_t cur_val = 0;
+    while(cur_val < max_val) {
+        if(cur_val & 1) {
+            if(!ring.emplace(std::make_unique<std::uint32_t>(cur_val))) {std::this_thread::yield(); continue;}
+            cur_val++;
+        } else {
+            std::size_t Nmax = std::min<std::size_t>(max_val - cur_val, 16);
+            if(ring.emplace_bulk(Nmax, [&]() { return std::make_unique<std::uint32_t>(cur_val++); }) == 0) std::this_thread::yield();
+        }
+       }
+   });
+
+std::uint32_t next_val = 0;
+std::unique_ptr<std::uint32_t> p;
+while(next_val < max_val) {
+    std::size_t Nread = ring.consume_bulk(32, [&](std::unique_ptr<std::uint32_t> &&q) {
+        if(!q || (*q != next_val)) {fprintf(stderr,"ERROR bad value F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+        next_val++;
+        });
+    if(ring.pop(p)) {
+        if(!p || (*p != next_val)) {fprintf(stderr,"ERROR bad value F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+        next_val++;
+        Nread++;
+        }
+    if(Nread == 0) std::this_thread::yield();
+   }
+writer.join();
+return 0;
+}
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+std::size_t nber_test_elems;
+
+fprintf(stderr,"Randomized test of the C++ object ring\n");
+
+if(argc != 2) {
+    fprintf(stderr,"ERROR: pass the number of elements to insert\n");
+    return 1;
+   }
+if(sscanf(argv[1],"%zu",&nber_test_elems) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+if(rand_test<2>(nber_test_elems) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(rand_test<5>(nber_test_elems) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(rand_test<64>(nber_test_elems) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(rand_test<300>(nber_test_elems) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(exception_test() != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(thread_test(nber_test_elems) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
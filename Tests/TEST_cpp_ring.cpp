@@ -0,0 +1,163 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ C++ ring buffer (circ_buf.hpp)
+
+ Same principle as TEST_random_ins_del.c: random insertions / deletions, checking that we get the inserted elements back,
+ only once, in order. Done for several capacities (powers of two or not, around the limits of the index types),
+ then with one writer thread and one reader thread.
+
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <thread>
+
+#include "circ_buf.hpp"
+
+
+// the index type follows the capacity:
+static_assert(std::is_same_v<ccbf::RingBuffer<int, 256>::index_type, std::uint8_t>);
+static_assert(std::is_same_v<ccbf::RingBuffer<int, 257>::index_type, std::uint16_t>);
+static_assert(std::is_same_v<ccbf::RingBuffer<int, 65537>::index_type, std::uint32_t>);
+static_assert(sizeof(ccbf::RingBuffer<std::uint8_t, 16>) == 2 + 16);
+
+
+// ==============================================================================
+
+template<std::size_t N>
+int rand_test(std::size_t nber_test_elems)
+{
+static ccbf::RingBuffer<std::uint32_t, N> ring; // static: the large ones would not fit on the stack
+unsigned short xsubi[3] = {N & 0xFFFF, 1, 2};
+std::uint32_t cur_write = 0, cur_check = 0; // the values inserted are 0, 1, 2 ...
+std::size_t cur_filling = 0;
+
+while(cur_check < nber_test_elems) {
+    // add:
+    auto WrInd = ring.WrInd();
+    std::size_t max_add = WrInd[0].size() + WrInd[1].size();
+    if(max_add != N - 1 - cur_filling) {fprintf(stderr,"ERROR bad free space F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    if(max_add > nber_test_elems - cur_write) max_add = nber_test_elems - cur_write;
+    std::size_t NtoAdd = (max_add + 1) * erand48(xsubi);
+    if(NtoAdd > max_add) NtoAdd = max_add;
+    std::size_t NCopied = 0;
+    for(auto seg : WrInd) {
+        for(auto &elem : seg) {
+            if(NCopied == NtoAdd) break;
+            elem = cur_write++;
+            NCopied++;
+           }
+       }
+    if(ring.UpdtWr(NCopied) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    cur_filling += NCopied;
+
+    // read:
+    auto RdInd = ring.RdInd();
+    std::size_t max_read = RdInd[0].size() + RdInd[1].size();
+    if((max_read != cur_filling) || (ring.AvailRd() != cur_filling) || (ring.AvailWr() != N - 1 - cur_filling)) {
+        fprintf(stderr,"ERROR incorrect nber of items in buffer F:%s L:%d\n",__FILE__,__LINE__);
+        return 1;
+       }
+    if(RdInd[0].empty() && !RdInd[1].empty()) {fprintf(stderr,"ERROR segments out of order F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    std::size_t NtoRead = (max_read + 1) * erand48(xsubi);
+    if(NtoRead > max_read) NtoRead = max_read;
+    std::size_t Nread = 0;
+    for(auto seg : RdInd) {
+        for(auto &elem : seg) {
+            if(Nread == NtoRead) break;
+            if(elem != cur_check) {fprintf(stderr,"ERROR incorrect item in buffer: %u != %u F:%s L:%d\n",elem,cur_check,__FILE__,__LINE__); return 1;}
+            cur_check++;
+            Nread++;
+           }
+       }
+    if(ring.UpdtRd(Nread) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    cur_filling -= Nread;
+   }
+
+// too much:
+if(ring.UpdtRd(cur_filling + 1) == 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(ring.UpdtWr(N - cur_filling) == 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+return 0;
+}
+
+// ==============================================================================
+
+template<std::size_t N>
+int thread_test(std::uint32_t max_val)
+{
+static ccbf::RingBuffer<std::uint32_t, N> ring;
+int err = 0;
+
+std::thread writer([&]() {
+    std::uint32_t cur_val = 0;
+    while(cur_val < max_val) {
+        std::size_t Ncopied = 0;
+        for(auto seg : ring.WrInd()) {
+            for(auto &elem : seg) {
+                if(cur_val == max_val) break;
+                elem = cur_val++;
+                Ncopied++;
+               }
+           }
+        if(ring.UpdtWr(Ncopied) != 0) err = __LINE__;
+        if(Ncopied == 0) std::this_thread::yield();
+       }
+   });
+
+std::uint32_t next_val = 0;
+while(next_val < max_val) {
+    std::size_t Nread = 0;
+    for(auto seg : ring.RdInd()) {
+        for(auto &elem : seg) {
+            if(elem != next_val) {fprintf(stderr,"ERROR bad value F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+            next_val++;
+            Nread++;
+           }
+       }
+    if(ring.UpdtRd(Nread) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if(Nread == 0) std::this_thread::yield();
+   }
+writer.join();
+return err;
+}
+
+// ==============================================================================
+
+template<std::size_t... Ns>
+int rand_tests(std::size_t nber_test_elems)
+{
+int ret = 0;
+((ret = (ret != 0) ? ret : (fprintf(stderr,"buf size under test: %zu\n", Ns), rand_test<Ns>(nber_test_elems))), ...);
+return ret;
+}
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+std::size_t nber_test_elems;
+
+fprintf(stderr,"Randomized test of the C++ ring buffer\n");
+
+if(argc != 2) {
+    fprintf(stderr,"ERROR: pass the number of elements to insert\n");
+    return 1;
+   }
+if(sscanf(argv[1],"%zu",&nber_test_elems) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+if(rand_tests<2, 3, 4, 5, 7, 8, 100, 255, 256, 257, 1000, 1024, 65536, 65537>(nber_test_elems) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+fprintf(stderr,"threads\n");
+if(thread_test<100>(nber_test_elems) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(thread_test<128>(nber_test_elems) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
@@ -0,0 +1,144 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ CRC-32C (circ_buf_crc.c)
+
+ - the check value of "123456789",
+ - random lengths and alignments: each version this CPU has (forced with CircBufCrcSetKernel()) and the slice-by-8 version
+   give the CRC of a bit per bit reference, in one call or in random pieces,
+ - CircBufCrc32cCombine() of two random parts gives the CRC of the whole,
+ - CircBufCrc32cRanges() over the two segments of a ring gives the CRC of the same elements copied in a linear buffer.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "circ_buf.h"
+#include "circ_buf_copy.h"
+#include "circ_buf_crc.h"
+
+#define MAX_LEN 20000
+
+// ==============================================================================
+
+uint32_t crc32c_ref(uint32_t crc, const uint8_t *p, size_t len)
+{
+size_t i;
+int k;
+crc = ~crc;
+for(i = 0; i < len; i++) {
+    crc ^= p[i];
+    for(k = 0; k < 8; k++) crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78u : crc >> 1;
+   }
+return ~crc;
+}
+
+// ==============================================================================
+
+//
+// the version selected (or forced) against the reference
+//
+int random_tests(const uint8_t *Buf, unsigned long nber_tests, unsigned short xsubi[3])
+{
+unsigned long t;
+size_t len, off, i, cut, piece;
+uint32_t ref, crc, crc1, crc2;
+
+if(CircBufCrc32c(0, "123456789", 9) != 0xE3069283u) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufCrc32c(0, NULL, 0) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+for(t = 0; t < nber_tests; t++) {
+    len = (erand48(xsubi) < 0.5) ? 100 * erand48(xsubi) : MAX_LEN * erand48(xsubi);
+    off = 64 * erand48(xsubi);
+    ref = crc32c_ref(0, Buf + off, len);
+    if(CircBufCrc32c(0, Buf + off, len) != ref) {fprintf(stderr,"ERROR len %zu F:%s L:%d\n",len,__FILE__,__LINE__); return 1;}
+    if(CircBufCrc32cSlice8(0, Buf + off, len) != ref) {fprintf(stderr,"ERROR len %zu F:%s L:%d\n",len,__FILE__,__LINE__); return 1;}
+
+    // in pieces:
+    crc = 0;
+    for(i = 0; i < len; i += piece) {
+        piece = 1 + 2000 * erand48(xsubi);
+        if(piece > len - i) piece = len - i;
+        crc = CircBufCrc32c(crc, Buf + off + i, piece);
+        }
+    if(crc != ref) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+    // two parts:
+    cut = (len + 1) * erand48(xsubi);
+    if(cut > len) cut = len;
+    crc1 = CircBufCrc32c(0, Buf + off, cut);
+    crc2 = CircBufCrc32c(0, Buf + off + cut, len - cut);
+    if(CircBufCrc32cCombine(crc1, crc2, len - cut) != ref) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+   }
+return 0;
+}
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+static uint8_t Buf[MAX_LEN + 64], Lin[MAX_LEN];
+const char *Kernels[] = {"sse4.2+pclmul", "sse4.2", "slice8"};
+const char *Selected;
+unsigned short xsubi[3] = {3, 1, 4};
+unsigned long nber_tests, t;
+size_t i;
+int k;
+CircBuf_t CrcBuf;
+CCBFsize_t N, n, got, Ind[2][2];
+uint8_t *Data;
+
+fprintf(stderr,"Test of the CRC-32C, version: %s\n", CircBufCrcKernel());
+
+if(argc != 2) {
+    fprintf(stderr,"ERROR: pass the number of random tests\n");
+    return 1;
+   }
+if(sscanf(argv[1],"%lu",&nber_tests) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+if(CircBufCrc32cSlice8(0, "123456789", 9) != 0xE3069283u) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+for(i = 0; i < sizeof(Buf); i++) Buf[i] = 256 * erand48(xsubi);
+
+Selected = CircBufCrcKernel();
+for(k = 0; k < (int)(sizeof(Kernels) / sizeof(Kernels[0])); k++) {
+    if(CircBufCrcSetKernel(Kernels[k]) != 0) {
+        fprintf(stderr,"no %s on this CPU\n", Kernels[k]);
+        continue;
+        }
+    if(strcmp(CircBufCrcKernel(), Kernels[k]) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    fprintf(stderr,"random tests, %s\n", Kernels[k]);
+    if(random_tests(Buf, nber_tests, xsubi) != 0) {fprintf(stderr,"ERROR %s F:%s L:%d\n",Kernels[k],__FILE__,__LINE__); exit(1);}
+   }
+if(CircBufCrcSetKernel("crc64") == 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufCrcSetKernel(Selected) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+// over the ranges of a ring of 12 bytes elements, across the wrap around:
+for(t = 0; t < 1000; t++) {
+    N = 2 + 1000 * erand48(xsubi);
+    Data = malloc((size_t)N * 12);
+    if(Data == NULL) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if(CircBufInit(CIRCBUF(&CrcBuf), N) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    n = (N - 1) * erand48(xsubi);
+    if((n > 0) && ((CircBufCopyIn(CIRCBUF(&CrcBuf), Data, 12, Buf, n, 0, &got) != 0) || (CircBufCopyOut(CIRCBUF(&CrcBuf), Data, 12, Lin, n, 0, &got) != 0))) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    n = (N - 1) * erand48(xsubi);
+    if((n > 0) && (CircBufCopyIn(CIRCBUF(&CrcBuf), Data, 12, Buf + 7, n, 0, &got) != 0)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if(CircBufRdInd(CIRCBUF(&CrcBuf), &Ind) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if(CircBufSzSum(Ind) != n) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    got = CircBufCopyFromRanges(Data, 12, &Ind, Lin, n, 0);
+    if(CircBufCrc32cRanges(0, Data, 12, &Ind, n) != crc32c_ref(0, Lin, (size_t)n * 12)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if(CircBufCrc32cRanges(0, Data, 12, &Ind, n / 2) != crc32c_ref(0, Lin, (size_t)(n / 2) * 12)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    free(Data);
+   }
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
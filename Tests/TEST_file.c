@@ -0,0 +1,156 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Persistent ring (circ_buf_file.c)
+
+ - a child process appends numbered elements by random batches, with a checkpoint halfway, and is killed:
+   reopening the file gives the last elements committed, in order,
+ - the sync policy makes checkpoints,
+ - elements appended without checkpoint, then a "reboot" (boot id changed in the file): reopening gives the last checkpoint.
+
+ The file is left in place for Tools/ccbf_dump.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "circ_buf.h"
+#include "circ_buf_file.h"
+
+
+#define RING_SIZE 1000
+#define MAX_BATCH 50
+
+typedef struct {
+  uint64_t seq;
+  uint64_t check;
+} elem_t;
+
+static uint64_t check_val(uint64_t seq)
+{
+return seq * 0x9E3779B97F4A7C15ull;
+}
+
+// ==============================================================================
+
+//
+// appends the elements [First, Last) by random batches
+//
+int append_values(CircBufFile_t *p_file, uint64_t First, uint64_t Last, unsigned short xsubi[3])
+{
+elem_t batch[MAX_BATCH];
+uint64_t cur = First;
+CCBFsize_t n, k;
+
+while(cur < Last) {
+    n = 1 + (MAX_BATCH - 1) * erand48(xsubi);
+    if(n > Last - cur) n = Last - cur;
+    for(k = 0; k < n; k++) {
+        batch[k].seq = cur + k;
+        batch[k].check = check_val(cur + k);
+        }
+    if(CircBufFileAppend(p_file, batch, n) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    cur += n;
+   }
+return 0;
+}
+
+// ==============================================================================
+
+//
+// the ring must hold the Count last elements before Last (excluded)
+//
+int check_values(CircBufFile_t *p_file, uint64_t Last, uint64_t Count)
+{
+CCBFsize_t N = p_file -> p_Hdr -> Ring.ElemInBuf;
+CCBFsize_t n = CircBufUsedCount(p_file -> RdPos0, p_file -> WrPos0, N), k;
+uint64_t expected = (Last < Count) ? Last : Count;
+elem_t *p_elem;
+
+if(n != expected) {fprintf(stderr,"ERROR %u elements instead of %lu F:%s L:%d\n",n,(unsigned long)expected,__FILE__,__LINE__); return 1;}
+for(k = 0; k < n; k++) {
+    p_elem = (elem_t *)(p_file -> Data) + (p_file -> RdPos0 + k) % N;
+    if((p_elem -> seq != Last - n + k) || (p_elem -> check != check_val(p_elem -> seq))) {
+        fprintf(stderr,"ERROR element %lu instead of %lu F:%s L:%d\n",(unsigned long)p_elem -> seq,(unsigned long)(Last - n + k),__FILE__,__LINE__);
+        return 1;
+        }
+    }
+return 0;
+}
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+CircBufFile_t File;
+unsigned long nber_vals;
+unsigned short xsubi[3] = {11, 12, 13};
+uint64_t Nsync;
+int status;
+pid_t pid;
+char *path;
+
+fprintf(stderr,"Test of the persistent ring\n");
+
+if(argc != 3) {
+    fprintf(stderr,"ERROR: pass the path of the file, then the number of elements to append\n");
+    return 1;
+   }
+path = argv[1];
+if(sscanf(argv[2],"%lu",&nber_vals) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+unlink(path);
+
+// crash of the writer:
+pid = fork();
+if(pid < 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(pid == 0) {
+    if(CircBufFileOpen(&File, path, RING_SIZE, sizeof(elem_t), 0) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    if(File.Origin != CCBF_FILE_NEW) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    if(append_values(&File, 0, nber_vals / 2, xsubi) != 0) _exit(1);
+    if(CircBufFileSync(&File) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    if(append_values(&File, nber_vals / 2, nber_vals, xsubi) != 0) _exit(1);
+    kill(getpid(), SIGKILL);
+    }
+if((waitpid(pid, &status, 0) != pid) || !WIFSIGNALED(status)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+if(CircBufFileOpen(&File, path, RING_SIZE, sizeof(elem_t) + 1, 0) == 0) {fprintf(stderr,"ERROR wrong element size accepted F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufFileOpen(&File, path, 0, 0, 0) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(File.Origin != CCBF_FILE_LIVE) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(check_values(&File, nber_vals, RING_SIZE - 1) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+// sync policy:
+Nsync = File.p_Hdr -> Nsync;
+if(CircBufFileSyncPolicy(&File, 100, 0) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(append_values(&File, nber_vals, nber_vals + 1000, xsubi) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(File.p_Hdr -> Nsync < Nsync + 1000 / (100 + MAX_BATCH)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+nber_vals += 1000;
+if(CircBufFileClose(&File) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+// elements lost in a reboot:
+if(CircBufFileOpen(&File, path, RING_SIZE, sizeof(elem_t), 0) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(append_values(&File, nber_vals, nber_vals + 300, xsubi) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+File.p_Hdr -> BootId[0] ^= 1;
+munmap(File.p_Hdr, File.MapSize); // no checkpoint
+close(File.Fd);
+
+if(CircBufFileOpen(&File, path, RING_SIZE, sizeof(elem_t), 0) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(File.Origin != CCBF_FILE_CHECKPOINT) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+// the checkpoint was made before the last 300 elements, that dropped the 300 oldest ones:
+if(check_values(&File, nber_vals, RING_SIZE - 1 - 300) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufFileClose(&File) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
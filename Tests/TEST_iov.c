@@ -0,0 +1,170 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ iovec bridge (circ_buf_iov.c)
+
+ - CircBufWrIov() / CircBufRdIov() against the ranges of CircBufWrInd() / CircBufRdInd(), with 4 bytes elements,
+ - a stream of bytes: source fd --> ring --> sink fd, with random amounts written to the source and read from the sink,
+   so that the transfers wrap around the ring at random places. Once through pipes (readv() / writev()),
+   once through unix stream sockets (recvmsg() / sendmsg()). The bytes must come out of the sink in order.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "circ_buf.h"
+#include "circ_buf_iov.h"
+
+
+#define MAX_CHUNK 5000
+
+// ==============================================================================
+
+int iov_test(void)
+{
+CircBuf_t CrcBuf;
+uint32_t buf[10];
+struct iovec iov[2];
+int cnt;
+
+if(CircBufInit(&CrcBuf, 10) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufRdIov(&CrcBuf, buf, sizeof(buf[0]), iov, &cnt) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(cnt != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufWrIov(&CrcBuf, buf, sizeof(buf[0]), iov, &cnt) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if((cnt != 1) || (iov[0].iov_base != &buf[0]) || (iov[0].iov_len != 9 * sizeof(buf[0]))) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+// 7 written, 7 read: the free space wraps around
+if((CircBufUpdtWr(&CrcBuf, 7) != 0) || (CircBufUpdtRd(&CrcBuf, 7) != 0)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufWrIov(&CrcBuf, buf, sizeof(buf[0]), iov, &cnt) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if((cnt != 2) || (iov[0].iov_base != &buf[7]) || (iov[0].iov_len != 3 * sizeof(buf[0])) ||
+   (iov[1].iov_base != &buf[0]) || (iov[1].iov_len != 6 * sizeof(buf[0]))) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+// 5 written: the data wraps around too
+if(CircBufUpdtWr(&CrcBuf, 5) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufRdIov(&CrcBuf, buf, sizeof(buf[0]), iov, &cnt) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if((cnt != 2) || (iov[0].iov_base != &buf[7]) || (iov[0].iov_len != 3 * sizeof(buf[0])) ||
+   (iov[1].iov_base != &buf[0]) || (iov[1].iov_len != 2 * sizeof(buf[0]))) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+return 0;
+}
+
+// ==============================================================================
+
+// use_sock: 0 pipes and readv() / writev(), 1 sockets and recvmsg() / sendmsg()
+int stream_test(CCBFsize_t ring_size, size_t nber_test_bytes, int use_sock)
+{
+CircBuf_t CrcBuf;
+uint8_t *data, chunk[MAX_CHUNK];
+int src[2], sink[2], err;
+size_t n_src = 0, n_check = 0, n, i;
+ssize_t ret;
+unsigned short xsubi[3] = {ring_size & 0xFFFF, 8, 9};
+
+if(CircBufInit(&CrcBuf, ring_size) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+data = malloc(ring_size);
+if(data == NULL) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+if(use_sock) {
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, src) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, sink) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    } else {
+    if(pipe(src) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    if(pipe(sink) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    }
+for(i = 0; i < 2; i++) {
+    fcntl(src[i], F_SETFL, O_NONBLOCK);
+    fcntl(sink[i], F_SETFL, O_NONBLOCK);
+    }
+
+while(n_check < nber_test_bytes) {
+    // source:
+    n = MAX_CHUNK * erand48(xsubi);
+    if(n > nber_test_bytes - n_src) n = nber_test_bytes - n_src;
+    for(i = 0; i < n; i++) chunk[i] = (n_src + i) % 251;
+    ret = (n > 0) ? write(src[1], chunk, n) : 0;
+    if(ret < 0) {
+        if(errno != EAGAIN) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+        ret = 0;
+        }
+    n_src += ret;
+
+    // source --> ring:
+    if(use_sock) {
+        err = CircBufRecvmsg(&CrcBuf, data, src[0], NULL, MSG_DONTWAIT, &n);
+        } else {
+        err = CircBufReadv(&CrcBuf, data, src[0], &n);
+        }
+    if((err != 0) && (err != CCBF_AGAIN)) {fprintf(stderr,"ERROR %d F:%s L:%d\n",err,__FILE__,__LINE__); return 1;}
+    if((err == 0) && (n == 0)) {fprintf(stderr,"ERROR unexpected end of file F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+    // ring --> sink:
+    if(use_sock) {
+        err = CircBufSendmsg(&CrcBuf, data, sink[1], NULL, MSG_DONTWAIT, &n);
+        } else {
+        err = CircBufWritev(&CrcBuf, data, sink[1], &n);
+        }
+    if((err != 0) && (err != CCBF_AGAIN)) {fprintf(stderr,"ERROR %d F:%s L:%d\n",err,__FILE__,__LINE__); return 1;}
+
+    // sink:
+    n = MAX_CHUNK * erand48(xsubi);
+    ret = (n > 0) ? read(sink[0], chunk, n) : 0;
+    if(ret < 0) {
+        if(errno != EAGAIN) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+        ret = 0;
+        }
+    for(i = 0; i < (size_t)ret; i++) {
+        if(chunk[i] != (n_check + i) % 251) {fprintf(stderr,"ERROR incorrect byte at %zu F:%s L:%d\n",n_check + i,__FILE__,__LINE__); return 1;}
+        }
+    n_check += ret;
+   }
+
+if(CircBufAvailRd(&CrcBuf) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+// end of file:
+close(src[1]);
+if(CircBufReadv(&CrcBuf, data, src[0], &n) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(n != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+close(src[0]);
+close(sink[0]);
+close(sink[1]);
+free(data);
+return 0;
+}
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+unsigned int ring_size;
+size_t nber_test_bytes;
+
+fprintf(stderr,"Test of the iovec bridge\n");
+
+if(argc != 3) {
+    fprintf(stderr,"ERROR: pass the size of the ring (bytes), then the number of bytes to transfer\n");
+    return 1;
+   }
+if(sscanf(argv[1],"%u",&ring_size) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(sscanf(argv[2],"%zu",&nber_test_bytes) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+if(iov_test() != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+fprintf(stderr,"pipes\n");
+if(stream_test(ring_size, nber_test_bytes, 0) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+fprintf(stderr,"sockets\n");
+if(stream_test(ring_size, nber_test_bytes, 1) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
@@ -0,0 +1,177 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Ring metrics (circ_buf.c built with CCBF_METRICS=1)
+
+ - one thread: a known sequence of calls gives known counters,
+ - one writer thread, one reader thread, random batches: the counters match the ones kept by the threads.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "circ_buf.h"
+
+#if !CCBF_METRICS
+#error "this test needs CCBF_METRICS=1"
+#endif
+
+#define RING_SIZE 100
+
+struct shared_thd_data_str
+{
+  CircBuf_t CrcBuf;
+  uint64_t nber_vals;
+  // kept by the threads:
+  uint64_t wr_calls, wr_full, rd_calls, rd_empty;
+  uint64_t wr_batch[CCBF_METRICS_HIST], rd_batch[CCBF_METRICS_HIST];
+};
+
+// ==============================================================================
+
+unsigned bucket(CCBFsize_t n)
+{
+unsigned k = 0;
+while(n != 0) {
+    k++;
+    n >>= 1;
+   }
+return k;
+}
+
+// ==============================================================================
+
+void *writer(void *p_usr_in)
+{
+struct shared_thd_data_str *p_data = p_usr_in;
+unsigned short xsubi[3] = {1, 2, 3};
+CCBFsize_t WrInd[2][2], n;
+uint64_t cur = 0;
+
+while(cur < p_data -> nber_vals) {
+    CircBufWrInd(CIRCBUF(&(p_data -> CrcBuf)), &WrInd);
+    p_data -> wr_calls++;
+    n = CircBufSzSum(WrInd);
+    if(n == 0) {
+        p_data -> wr_full++;
+        sched_yield();
+        continue;
+        }
+    n = (n + 1) * erand48(xsubi); // sometimes 0
+    if(n > CircBufSzSum(WrInd)) n = CircBufSzSum(WrInd);
+    if(n > p_data -> nber_vals - cur) n = p_data -> nber_vals - cur;
+    CircBufUpdtWr(CIRCBUF(&(p_data -> CrcBuf)), n);
+    p_data -> wr_batch[bucket(n)]++;
+    cur += n;
+    if(n == 0) sched_yield();
+   }
+return NULL;
+}
+
+// ==============================================================================
+
+void *reader(void *p_usr_in)
+{
+struct shared_thd_data_str *p_data = p_usr_in;
+unsigned short xsubi[3] = {4, 5, 6};
+CCBFsize_t RdInd[2][2], n;
+uint64_t cur = 0;
+
+while(cur < p_data -> nber_vals) {
+    CircBufRdInd(CIRCBUF(&(p_data -> CrcBuf)), &RdInd);
+    p_data -> rd_calls++;
+    n = CircBufSzSum(RdInd);
+    if(n == 0) {
+        p_data -> rd_empty++;
+        sched_yield();
+        continue;
+        }
+    n = 1 + (n - 1) * erand48(xsubi);
+    CircBufUpdtRd(CIRCBUF(&(p_data -> CrcBuf)), n);
+    p_data -> rd_batch[bucket(n)]++;
+    cur += n;
+   }
+return NULL;
+}
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+static struct shared_thd_data_str data;
+CircBuf_t CrcBuf;
+CircBufMetrics_t M;
+CCBFsize_t Ind[2][2];
+pthread_t thd_wr, thd_rd;
+unsigned long nber_vals;
+unsigned k;
+
+fprintf(stderr,"Test of the ring metrics\n");
+
+if(argc != 2) {
+    fprintf(stderr,"ERROR: pass the number of elements to transfer\n");
+    return 1;
+   }
+if(sscanf(argv[1],"%lu",&nber_vals) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+// known sequence:
+if(CircBufInit(CIRCBUF(&CrcBuf), 10) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufMetricsGet(CIRCBUF(&CrcBuf), 8, NULL) == 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+CircBufRdInd(CIRCBUF(&CrcBuf), &Ind); // empty
+CircBufWrInd(CIRCBUF(&CrcBuf), &Ind);
+CircBufUpdtWr(CIRCBUF(&CrcBuf), 5); // 5 used
+CircBufRdInd(CIRCBUF(&CrcBuf), &Ind);
+CircBufUpdtRd(CIRCBUF(&CrcBuf), 3); // 2 used
+CircBufWrInd(CIRCBUF(&CrcBuf), &Ind);
+CircBufUpdtWr(CIRCBUF(&CrcBuf), 7); // 9 used: full
+CircBufWrInd(CIRCBUF(&CrcBuf), &Ind); // full
+CircBufUpdtWr(CIRCBUF(&CrcBuf), 0);
+CircBufRdInd(CIRCBUF(&CrcBuf), &Ind);
+CircBufUpdtRd(CIRCBUF(&CrcBuf), 9);
+CircBufWrInd(CIRCBUF(&CrcBuf), &Ind);
+CircBufUpdtWr(CIRCBUF(&CrcBuf), 1); // 1 used
+
+if(CircBufMetricsGet(CIRCBUF(&CrcBuf), 8, &M) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if((M.ElemInBuf != 10) || (M.MaxUsed != 9)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if((M.WrCalls != 4) || (M.WrFull != 1) || (M.RdCalls != 3) || (M.RdEmpty != 1)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if((M.ItemsWr != 13) || (M.ItemsRd != 12) || (M.BytesWr != 13 * 8) || (M.BytesRd != 12 * 8)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+// writes of 5, 7, 0, 1 elements / reads of 3, 9 elements:
+if((M.WrBatch[0] != 1) || (M.WrBatch[1] != 1) || (M.WrBatch[2] != 0) || (M.WrBatch[3] != 2) || (M.WrBatch[4] != 0)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if((M.RdBatch[0] != 0) || (M.RdBatch[2] != 1) || (M.RdBatch[3] != 0) || (M.RdBatch[4] != 1)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+// reset:
+if(CircBufInit(CIRCBUF(&CrcBuf), 10) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufMetricsGet(CIRCBUF(&CrcBuf), 8, &M) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if((M.MaxUsed != 0) || (M.WrCalls != 0) || (M.ItemsRd != 0) || (M.WrBatch[3] != 0)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+// two threads:
+data.nber_vals = nber_vals;
+if(CircBufInit(CIRCBUF(&(data.CrcBuf)), RING_SIZE) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(pthread_create(&thd_wr, NULL, writer, &data) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(pthread_create(&thd_rd, NULL, reader, &data) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+pthread_join(thd_wr, NULL);
+pthread_join(thd_rd, NULL);
+
+if(CircBufMetricsGet(CIRCBUF(&(data.CrcBuf)), 4, &M) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+fprintf(stderr,"high-water mark %u / %u, %lu full / %lu writes, %lu empty / %lu reads\n", M.MaxUsed, RING_SIZE - 1,
+        (unsigned long)M.WrFull, (unsigned long)M.WrCalls, (unsigned long)M.RdEmpty, (unsigned long)M.RdCalls);
+if((M.ItemsWr != nber_vals) || (M.ItemsRd != nber_vals) || (M.BytesWr != 4 * (uint64_t)nber_vals)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if((M.WrCalls != data.wr_calls) || (M.WrFull != data.wr_full) || (M.RdCalls != data.rd_calls) || (M.RdEmpty != data.rd_empty)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if((M.MaxUsed == 0) || (M.MaxUsed > RING_SIZE - 1)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+for(k = 0; k < CCBF_METRICS_HIST; k++) {
+    if((M.WrBatch[k] != data.wr_batch[k]) || (M.RdBatch[k] != data.rd_batch[k])) {fprintf(stderr,"ERROR bucket %u F:%s L:%d\n",k,__FILE__,__LINE__); exit(1);}
+   }
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
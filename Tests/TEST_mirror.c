@@ -0,0 +1,118 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Double-mapped data buffer (circ_buf_mirror.c)
+
+ - a write through the first mapping is seen through the second one, and vice versa,
+ - random insertions / deletions with elements whose size does not divide the page size: each insertion and each read
+   is done with a single memcpy() / memcmp() over the contiguous region returned by CircBufMirrorSpan().
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "circ_buf.h"
+#include "circ_buf_mirror.h"
+
+
+typedef struct {
+  uint32_t val[3]; // 12 bytes
+} elem_t;
+
+// ==============================================================================
+
+void fill_elems(elem_t *tab, size_t N, uint32_t first)
+{
+size_t i;
+for(i = 0; i < N; i++) {
+    tab[i].val[0] = first + i;
+    tab[i].val[1] = ~(first + i);
+    tab[i].val[2] = (first + i) * 2654435761u;
+    }
+}
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+unsigned int nber_pages_mult;
+size_t nber_test_elems;
+CircBufMirror_t Mirror;
+CircBuf_t CrcBuf;
+CCBFsize_t ElemInBuf, IndTab[2][2], start, len;
+elem_t *buf, *tmp;
+uint8_t *bytes;
+uint32_t cur_write = 0, cur_check = 0;
+unsigned short xsubi[3] = {5, 6, 7};
+
+fprintf(stderr,"Randomized test of the double-mapped buffer\n");
+
+if(argc != 3) {
+    fprintf(stderr,"ERROR: pass the size of the buffer (multiple of the minimal size), then the number of elements to insert\n");
+    return 1;
+   }
+if(sscanf(argv[1],"%u",&nber_pages_mult) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(sscanf(argv[2],"%zu",&nber_test_elems) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+// sizes that are not page multiples are refused:
+if(CircBufMirrorAlloc(&Mirror, CircBufMirrorElemMultiple(sizeof(elem_t)) + 1, sizeof(elem_t)) == 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+ElemInBuf = nber_pages_mult * CircBufMirrorElemMultiple(sizeof(elem_t));
+fprintf(stderr,"%u elements of %zu bytes\n", ElemInBuf, sizeof(elem_t));
+if(CircBufMirrorAlloc(&Mirror, ElemInBuf, sizeof(elem_t)) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(Mirror.Size != ElemInBuf * sizeof(elem_t)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+buf = Mirror.Data;
+bytes = Mirror.Data;
+
+// both mappings are the same memory:
+bytes[0] = 0x5A;
+bytes[Mirror.Size + Mirror.Size - 1] = 0xA5;
+if((bytes[Mirror.Size] != 0x5A) || (bytes[Mirror.Size - 1] != 0xA5)) {fprintf(stderr,"ERROR mappings differ F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+if(CircBufInit(&CrcBuf, ElemInBuf) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+tmp = malloc(ElemInBuf * sizeof(elem_t));
+if(tmp == NULL) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+while(cur_check < nber_test_elems) {
+    // add:
+    if(CircBufWrInd(&CrcBuf, &IndTab) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    len = CircBufMirrorSpan(&IndTab, &start);
+    if(len != CircBufSzSum(IndTab)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if(len > nber_test_elems - cur_write) len = nber_test_elems - cur_write;
+    len = (len + 1) * erand48(xsubi);
+    if(len > 0) {
+        fill_elems(tmp, len, cur_write);
+        memcpy(&buf[start], tmp, len * sizeof(elem_t)); // may go past the end of the first mapping
+        cur_write += len;
+        }
+    if(CircBufUpdtWr(&CrcBuf, len) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    // read:
+    if(CircBufRdInd(&CrcBuf, &IndTab) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    len = CircBufMirrorSpan(&IndTab, &start);
+    if(len != cur_write - cur_check) {fprintf(stderr,"ERROR incorrect nber of items in buffer F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    len = (len + 1) * erand48(xsubi);
+    if(len > cur_write - cur_check) len = cur_write - cur_check;
+    if(len > 0) {
+        fill_elems(tmp, len, cur_check);
+        if(memcmp(&buf[start], tmp, len * sizeof(elem_t)) != 0) {fprintf(stderr,"ERROR incorrect items in buffer F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+        cur_check += len;
+        }
+    if(CircBufUpdtRd(&CrcBuf, len) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+   }
+
+free(tmp);
+if(CircBufMirrorFree(&Mirror) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(Mirror.Data != NULL) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
@@ -0,0 +1,185 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Several writers, several readers (circ_buf_mpmc.h)
+
+ Each writer inserts its own sequence of values, tagged with its writer number.
+ Every reader checks that the values of a given writer come in increasing order,
+ and at the end we check that every value has been read exactly once (count and sum per writer).
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#include "circ_buf_mpmc.h"
+
+
+typedef uint64_t elem_t; // (writer number << 32) | value
+
+#define MAX_THREADS 64
+
+
+struct shared_thd_data_str
+{
+elem_t *buf;
+CCBFvolcount_t *seq; // sequence counters, next to the data
+CircBufMpmc_t *p_CrcBuf; // must be aligned on a cache line: allocated with aligned_alloc()
+size_t max_val; // every writer inserts max_val elements, with values from 0 to max_val-1 included
+int Nwriters;
+atomic_size_t Nread; // total number of elements read by all the readers
+atomic_size_t count[MAX_THREADS]; // number of values read, per writer
+atomic_size_t sum[MAX_THREADS]; // sum of the values read, per writer
+};
+
+struct thd_data_str
+{
+struct shared_thd_data_str *p_shared;
+int id;
+pthread_t thd;
+};
+
+
+void *writer(void *p_usr_in)
+{
+int ret;
+struct thd_data_str *p_thd = p_usr_in;
+struct shared_thd_data_str *p_data = p_thd -> p_shared;
+size_t cur_val = 0;
+CCBFsize_t ind;
+CCBFcount_t ticket;
+
+while(cur_val < p_data -> max_val) {
+    ret = CircBufMpmcWrClaim(CIRCBUFMPMC(p_data -> p_CrcBuf), &ind, &ticket);
+    if(ret == CCBF_AGAIN) {
+        sched_yield(); // full: let the readers run
+        continue;
+       }
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    p_data -> buf[ind] = (((elem_t)p_thd -> id) << 32) | cur_val;
+    cur_val++;
+
+    ret = CircBufMpmcWrCommit(CIRCBUFMPMC(p_data -> p_CrcBuf), ticket);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+  }
+return NULL;
+}
+
+
+void *reader(void *p_usr_in)
+{
+int ret;
+struct thd_data_str *p_thd = p_usr_in;
+struct shared_thd_data_str *p_data = p_thd -> p_shared;
+const size_t Ntotal = p_data -> max_val * p_data -> Nwriters;
+int64_t last_val[MAX_THREADS]; // last value read from every writer
+CCBFsize_t ind;
+CCBFcount_t ticket;
+elem_t val;
+int id;
+
+for(id=0; id< MAX_THREADS; id++) last_val[id] = -1;
+
+while(atomic_load(&(p_data -> Nread)) < Ntotal) {
+    ret = CircBufMpmcRdClaim(CIRCBUFMPMC(p_data -> p_CrcBuf), &ind, &ticket);
+    if(ret == CCBF_AGAIN) {
+        sched_yield(); // empty: let the writers run
+        continue;
+       }
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    val = p_data -> buf[ind];
+
+    ret = CircBufMpmcRdCommit(CIRCBUFMPMC(p_data -> p_CrcBuf), ticket);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    id = val >> 32;
+    if((id < 0) || (id >= p_data -> Nwriters) || ((int64_t)(val & 0xFFFFFFFF) <= last_val[id])) {
+        fprintf(stderr,"ERROR: bad value. F:%s L:%d\n",__FILE__,__LINE__);
+        exit(1);
+       }
+    last_val[id] = val & 0xFFFFFFFF;
+    atomic_fetch_add(&(p_data -> count[id]), 1);
+    atomic_fetch_add(&(p_data -> sum[id]), val & 0xFFFFFFFF);
+    atomic_fetch_add(&(p_data -> Nread), 1);
+  }
+return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+size_t MaxVal;
+size_t Nbufsz;
+int Nwriters, Nreaders;
+int ret, k;
+struct shared_thd_data_str *p_data;
+struct thd_data_str wr_data[MAX_THREADS], rd_data[MAX_THREADS];
+
+if(argc != 5) {
+    fprintf(stderr,"ERROR: pass the buffer size (power of two), the number of writers, the number of readers and the number of elements inserted by every writer\n");
+    return 1;
+   }
+ret = sscanf(argv[1],"%zu",&Nbufsz);
+if(ret != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = sscanf(argv[2],"%d",&Nwriters);
+if((ret != 1) || (Nwriters < 1) || (Nwriters > MAX_THREADS)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = sscanf(argv[3],"%d",&Nreaders);
+if((ret != 1) || (Nreaders < 1) || (Nreaders > MAX_THREADS)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = sscanf(argv[4],"%zu",&MaxVal);
+if(ret != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+printf("Randomized test of the MPMC ring buffer: %d writers x %llu insertions, %d readers\n", Nwriters, (long long unsigned)MaxVal, Nreaders);
+
+p_data = calloc(1, sizeof(*p_data));
+if(p_data == NULL) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+p_data -> buf = malloc(Nbufsz * sizeof(*(p_data -> buf)));
+p_data -> seq = malloc(Nbufsz * sizeof(*(p_data -> seq)));
+p_data -> p_CrcBuf = aligned_alloc(CCBF_CACHE_LINE, sizeof(*(p_data -> p_CrcBuf)));
+if((p_data -> buf == NULL) || (p_data -> seq == NULL) || (p_data -> p_CrcBuf == NULL)) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+ret = CircBufMpmcInit(CIRCBUFMPMC(p_data -> p_CrcBuf), Nbufsz, p_data -> seq);
+if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+p_data -> max_val = MaxVal;
+p_data -> Nwriters = Nwriters;
+
+for(k=0; k< Nreaders; k++) {
+    rd_data[k].p_shared = p_data;
+    rd_data[k].id = k;
+    ret = pthread_create(&(rd_data[k].thd), NULL, reader, &(rd_data[k]));
+    if(ret != 0) {fprintf(stderr,"ERROR: cannot create thread. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+   }
+for(k=0; k< Nwriters; k++) {
+    wr_data[k].p_shared = p_data;
+    wr_data[k].id = k;
+    ret = pthread_create(&(wr_data[k].thd), NULL, writer, &(wr_data[k]));
+    if(ret != 0) {fprintf(stderr,"ERROR: cannot create thread. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+   }
+
+for(k=0; k< Nwriters; k++) pthread_join(wr_data[k].thd, NULL);
+for(k=0; k< Nreaders; k++) pthread_join(rd_data[k].thd, NULL);
+
+// every value read exactly once:
+for(k=0; k< Nwriters; k++) {
+    if(atomic_load(&(p_data -> count[k])) != MaxVal) {fprintf(stderr,"ERROR: bad count for writer %d. F:%s L:%d\n",k,__FILE__,__LINE__); exit(1);}
+    if(atomic_load(&(p_data -> sum[k])) != MaxVal * (MaxVal - 1) / 2) {fprintf(stderr,"ERROR: bad sum for writer %d. F:%s L:%d\n",k,__FILE__,__LINE__); exit(1);}
+   }
+
+free(p_data -> buf);
+free(p_data -> seq);
+free(p_data -> p_CrcBuf);
+free(p_data);
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
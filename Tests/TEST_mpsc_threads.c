@@ -0,0 +1,186 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Several writers, one reader (circ_buf_mp.h)
+
+ Each writer inserts its own sequence of values, tagged with its writer number, using randomized claim sizes.
+ The reader checks that the values of every writer come in order, with none missing.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sched.h>
+
+#include "circ_buf_mp.h"
+
+
+typedef uint64_t elem_t; // (writer number << 32) | value
+
+#define MAX_WRITERS 64
+#define MAX_CLAIM 8 // maximum size of a claim
+
+
+struct shared_thd_data_str
+{
+elem_t *buf;
+CircBufMp_t *p_CrcBuf; // must be aligned on a cache line: allocated with aligned_alloc()
+size_t max_val; // every writer inserts max_val elements, with values from 0 to max_val-1 included
+int Nwriters;
+};
+
+struct writer_data_str
+{
+struct shared_thd_data_str *p_shared;
+int id;
+pthread_t thd;
+};
+
+
+void *writer(void *p_usr_in)
+{
+int ret;
+struct writer_data_str *p_wr = p_usr_in;
+struct shared_thd_data_str *p_data = p_wr -> p_shared;
+size_t cur_val = 0; // next value to insert, not yet inserted
+CCBFsize_t WrInd[2][2]; // always 2x2
+CCBFcount_t ticket;
+unsigned short xsubi[3] = {p_wr -> id, 1234, 5678}; // per thread random state
+
+size_t NtoAdd;
+int m;
+size_t i;
+
+while(cur_val < p_data -> max_val) {
+
+    // choose the number of elements to claim:
+    NtoAdd = 1 + MAX_CLAIM * erand48(xsubi);
+    if(NtoAdd > MAX_CLAIM) NtoAdd = MAX_CLAIM;
+    if(NtoAdd > p_data -> max_val - cur_val) NtoAdd = p_data -> max_val - cur_val;
+
+    ret = CircBufMpClaim(CIRCBUFMP(p_data -> p_CrcBuf), NtoAdd, &WrInd, &ticket);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if(CircBufSzSum(WrInd) == 0) {
+        sched_yield(); // no space: let the reader run, then try again
+        continue;
+       }
+    if(CircBufSzSum(WrInd) != NtoAdd) {fprintf(stderr,"ERROR bad claim size. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    // write:
+    for(m=0; m<2; m++) {
+        for(i=WrInd[m][0]; i<= WrInd[m][1]; i++) {
+            p_data -> buf[i] = (((elem_t)p_wr -> id) << 32) | cur_val;
+            cur_val++;
+        } // i
+    }// m
+
+    ret = CircBufMpCommit(CIRCBUFMP(p_data -> p_CrcBuf), ticket, NtoAdd);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+  } // end of while
+
+return NULL;
+}
+
+
+void *reader(void *p_usr_in)
+{
+int ret;
+struct shared_thd_data_str *p_data = p_usr_in;
+size_t next_val[MAX_WRITERS] = {0}; // next value expected from every writer
+size_t Nremaining = p_data -> max_val * p_data -> Nwriters;
+
+CCBFsize_t RdInd[2][2]; // always 2x2
+
+size_t Nread;
+int m, id;
+size_t i;
+
+// the reader is the classic one: CircBufRdInd() and CircBufUpdtRd() on the Ring member
+while(Nremaining > 0) {
+
+    ret = CircBufRdInd(CIRCBUF(&(p_data -> p_CrcBuf -> Ring)), &RdInd);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    Nread = 0;
+    for(m=0; m<2; m++) {
+        for(i=RdInd[m][0]; i<= RdInd[m][1]; i++) {
+            id = p_data -> buf[i] >> 32;
+            if((id < 0) || (id >= p_data -> Nwriters) || ((p_data -> buf[i] & 0xFFFFFFFF) != next_val[id])) {
+                fprintf(stderr,"ERROR: bad value. F:%s L:%d\n",__FILE__,__LINE__);
+                exit(1);
+               }
+            next_val[id]++;
+            Nread++;
+            }// i
+       }// m
+
+    ret = CircBufUpdtRd(CIRCBUF(&(p_data -> p_CrcBuf -> Ring)), Nread);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    Nremaining -= Nread;
+    if(Nread == 0) sched_yield(); // the writers may be preempted in the middle of a claim
+} // while
+
+fprintf(stderr,"Reader finished: all values OK.\n");
+return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+size_t MaxVal;
+size_t Nbufsz;
+int Nwriters;
+int ret, k;
+pthread_t reader_thd;
+struct shared_thd_data_str shrd_data;
+struct writer_data_str wr_data[MAX_WRITERS];
+
+if(argc != 4) {
+    fprintf(stderr,"ERROR: pass the buffer size, the number of writers and the number of elements inserted by every writer\n");
+    return 1;
+   }
+ret = sscanf(argv[1],"%zu",&Nbufsz);
+if(ret != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = sscanf(argv[2],"%d",&Nwriters);
+if((ret != 1) || (Nwriters < 1) || (Nwriters > MAX_WRITERS)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = sscanf(argv[3],"%zu",&MaxVal);
+if(ret != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(Nbufsz <= MAX_CLAIM) {fprintf(stderr,"ERROR: the buffer must hold more than %d elements F:%s L:%d\n", MAX_CLAIM, __FILE__,__LINE__); exit(1);}
+
+printf("Randomized test of the MPSC ring buffer: %d writers x %llu insertions\n", Nwriters, (long long unsigned)MaxVal);
+
+shrd_data.buf = malloc(Nbufsz * sizeof(*(shrd_data.buf)));
+if(shrd_data.buf == NULL) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+shrd_data.p_CrcBuf = aligned_alloc(CCBF_CACHE_LINE, sizeof(*(shrd_data.p_CrcBuf)));
+if(shrd_data.p_CrcBuf == NULL) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = CircBufMpInit(CIRCBUFMP(shrd_data.p_CrcBuf), Nbufsz);
+if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+shrd_data.max_val = MaxVal;
+shrd_data.Nwriters = Nwriters;
+
+ret = pthread_create(&reader_thd, NULL, reader, &shrd_data);
+if(ret != 0) {fprintf(stderr,"ERROR: cannot create thread. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+for(k=0; k< Nwriters; k++) {
+    wr_data[k].p_shared = &shrd_data;
+    wr_data[k].id = k;
+    ret = pthread_create(&(wr_data[k].thd), NULL, writer, &(wr_data[k]));
+    if(ret != 0) {fprintf(stderr,"ERROR: cannot create thread. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+   }
+
+for(k=0; k< Nwriters; k++) pthread_join(wr_data[k].thd, NULL);
+pthread_join(reader_thd, NULL);
+
+free(shrd_data.buf);
+free(shrd_data.p_CrcBuf);
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
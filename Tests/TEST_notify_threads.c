@@ -0,0 +1,185 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ One writer, one reader driven by epoll (circ_buf_notify.h)
+
+ The writer inserts random amounts of data, and flushes the notifier at the end of the stream.
+ The reader sleeps in epoll_wait() on the eventfd, reads the ring until it is empty, and re-arms the notifier.
+ A signal that is lost shows up as an epoll timeout while the ring holds enough data.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "circ_buf_notify.h"
+
+
+typedef uint32_t elem_t;
+
+#define EPOLL_TIMEOUT_MS 5000 // much longer than any scheduling delay
+
+
+struct shared_thd_data_str
+{
+elem_t *buf;
+CircBufNt_t CrcBuf;
+size_t max_val; // insert max_val elements in the ring buffer, with values from 0 to max_val-1 included
+size_t Nupdates; // number of CircBufNtUpdtWr() calls
+size_t Nwakeups; // number of times the reader has been woken up
+};
+
+// ==============================================================================
+
+void *writer(void *p_usr_in)
+{
+int ret;
+struct shared_thd_data_str *p_data = p_usr_in;
+size_t cur_val = 0; // next value to insert, not yet inserted
+unsigned short xsubi[3] = {1, 2, 3};
+CCBFsize_t WrInd[2][2]; // always 2x2
+size_t max_add, NtoAdd, Nwritten;
+int m;
+size_t i;
+
+while(cur_val < p_data -> max_val) {
+    ret = CircBufWrInd(CIRCBUF(&(p_data -> CrcBuf.Ring)), &WrInd);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    max_add = CircBufSzSum(WrInd);
+    if(max_add == 0) {
+        sched_yield(); // full: let the reader run
+        continue;
+       }
+    NtoAdd = 1 + max_add * erand48(xsubi);
+    if(NtoAdd > max_add) NtoAdd = max_add;
+
+    Nwritten = 0;
+    for(m=0; m<2; m++) {
+        for(i=WrInd[m][0]; (i<= WrInd[m][1]) && (Nwritten < NtoAdd) && (cur_val < p_data -> max_val); i++) {
+            p_data -> buf[i] = cur_val;
+            cur_val++;
+            Nwritten++;
+        } // i
+    }// m
+
+    ret = CircBufNtUpdtWr(&(p_data -> CrcBuf), Nwritten);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    p_data -> Nupdates++;
+  }
+
+// the end of the stream may stay below the threshold:
+ret = CircBufNtFlush(&(p_data -> CrcBuf));
+if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+return NULL;
+}
+
+// ==============================================================================
+
+void *reader(void *p_usr_in)
+{
+int ret;
+struct shared_thd_data_str *p_data = p_usr_in;
+size_t next_val = 0; // next value expected
+CCBFsize_t RdInd[2][2]; // always 2x2
+CCBFsize_t Nread;
+struct epoll_event ev;
+int epfd;
+int m;
+size_t i;
+
+epfd = epoll_create1(0);
+if(epfd < 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ev.events = EPOLLIN;
+ev.data.ptr = &(p_data -> CrcBuf);
+ret = epoll_ctl(epfd, EPOLL_CTL_ADD, CircBufNtFd(&(p_data -> CrcBuf)), &ev);
+if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+while(next_val < p_data -> max_val) {
+    ret = epoll_wait(epfd, &ev, 1, EPOLL_TIMEOUT_MS);
+    if(ret < 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if(ret == 0) {fprintf(stderr,"ERROR: lost signal, %u elements in the ring F:%s L:%d\n",(unsigned)CircBufAvailRd(CIRCBUF(&(p_data -> CrcBuf.Ring))),__FILE__,__LINE__); exit(1);}
+    p_data -> Nwakeups++;
+
+    do {
+        // read until empty:
+        do {
+            ret = CircBufRdInd(CIRCBUF(&(p_data -> CrcBuf.Ring)), &RdInd);
+            if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+            Nread = 0;
+            for(m=0; m<2; m++) {
+                for(i=RdInd[m][0]; i<= RdInd[m][1]; i++) {
+                    if(p_data -> buf[i] != next_val) {fprintf(stderr,"ERROR: bad value. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+                    next_val++;
+                    Nread++;
+                } // i
+            }// m
+            ret = CircBufUpdtRd(CIRCBUF(&(p_data -> CrcBuf.Ring)), Nread);
+            if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+        } while(Nread > 0);
+
+        ret = CircBufNtRearm(&(p_data -> CrcBuf));
+    } while(ret == CCBF_AGAIN);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+  }
+
+close(epfd);
+return NULL;
+}
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+int ret;
+size_t Nbufsz, MaxVal, Threshold;
+pthread_t writer_thd, reader_thd;
+struct shared_thd_data_str shrd_data;
+
+if(argc != 4) {
+    fprintf(stderr,"ERROR: pass the buffer size, the threshold and the number of elements to insert\n");
+    return 1;
+   }
+ret = sscanf(argv[1],"%zu",&Nbufsz);
+if(ret != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = sscanf(argv[2],"%zu",&Threshold);
+if(ret != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = sscanf(argv[3],"%zu",&MaxVal);
+if(ret != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+printf("Randomized test of the eventfd notifier: %zu insertions, threshold %zu\n", MaxVal, Threshold);
+
+shrd_data.buf = malloc(Nbufsz * sizeof(*(shrd_data.buf)));
+if(shrd_data.buf == NULL) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = CircBufNtInit(&(shrd_data.CrcBuf), Nbufsz, Threshold);
+if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+shrd_data.max_val = MaxVal;
+shrd_data.Nupdates = 0;
+shrd_data.Nwakeups = 0;
+
+ret = pthread_create(&reader_thd, NULL, reader, &shrd_data);
+if(ret != 0) {fprintf(stderr,"ERROR: cannot create thread. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = pthread_create(&writer_thd, NULL, writer, &shrd_data);
+if(ret != 0) {fprintf(stderr,"ERROR: cannot create thread. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+pthread_join(writer_thd, NULL);
+pthread_join(reader_thd, NULL);
+
+printf("%zu updates, %llu signals, %zu wake-ups\n", shrd_data.Nupdates, (long long unsigned)shrd_data.CrcBuf.Nsignals, shrd_data.Nwakeups);
+if(shrd_data.CrcBuf.Nsignals > shrd_data.Nupdates + 1) {fprintf(stderr,"ERROR: signals not coalesced F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+CircBufNtClose(&(shrd_data.CrcBuf));
+free(shrd_data.buf);
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
@@ -0,0 +1,158 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Variable-length records (circ_buf_rec.h), one writer thread and one reader thread.
+
+ The writer inserts records of random lengths (from 0 to the largest payload), filled with a pattern
+ that depends on the record number. The reader draws the same random lengths, and checks
+ the length, the alignment and the content of every record.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <sched.h>
+
+#include "circ_buf_rec.h"
+
+
+struct shared_thd_data_str
+{
+CircBufRec_t CrcBuf;
+size_t Nrecords; // number of records inserted
+size_t MaxLen; // largest payload
+};
+
+// ==============================================================================
+
+static uint8_t pattern(size_t rec, size_t j)
+{
+return (rec * 131 + j * 7) & 0xFF;
+}
+
+// ==============================================================================
+
+static size_t rand_len(unsigned short xsubi[3], size_t MaxLen)
+{
+size_t Len = (MaxLen + 1) * erand48(xsubi);
+if(Len > MaxLen) Len = MaxLen;
+return Len;
+}
+
+// ==============================================================================
+
+void *writer(void *p_usr_in)
+{
+int ret;
+struct shared_thd_data_str *p_data = p_usr_in;
+unsigned short xsubi[3] = {1, 2, 3}; // same sequence as the reader
+CircBufRecSpan_t span[2];
+size_t rec, Len, j, k;
+int m;
+
+for(rec=0; rec< p_data -> Nrecords; rec++) {
+    Len = rand_len(xsubi, p_data -> MaxLen);
+    while((ret = CircBufRecWrReserve(&(p_data -> CrcBuf), Len, &span)) == CCBF_AGAIN) sched_yield(); // full: let the reader run
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if(span[0].len + span[1].len != Len) {fprintf(stderr,"ERROR bad span length F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    j = 0;
+    for(m=0; m<2; m++) {
+        for(k=0; k< span[m].len; k++) span[m].ptr[k] = pattern(rec, j++);
+       }
+
+    ret = CircBufRecWrCommit(&(p_data -> CrcBuf));
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+   }
+return NULL;
+}
+
+// ==============================================================================
+
+void *reader(void *p_usr_in)
+{
+int ret;
+struct shared_thd_data_str *p_data = p_usr_in;
+unsigned short xsubi[3] = {1, 2, 3}; // same sequence as the writer
+CircBufRecSpan_t span[2];
+size_t rec, Len, j, k;
+int m;
+
+for(rec=0; rec< p_data -> Nrecords; rec++) {
+    Len = rand_len(xsubi, p_data -> MaxLen);
+    while((ret = CircBufRecRdPeek(&(p_data -> CrcBuf), &span)) == CCBF_AGAIN) sched_yield(); // empty: let the writer run
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if(span[0].len + span[1].len != Len) {fprintf(stderr,"ERROR bad record length F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if(((uintptr_t)span[0].ptr & (p_data -> CrcBuf.Unit - 1)) != 0) {fprintf(stderr,"ERROR payload not aligned F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    j = 0;
+    for(m=0; m<2; m++) {
+        for(k=0; k< span[m].len; k++) {
+            if(span[m].ptr[k] != pattern(rec, j++)) {fprintf(stderr,"ERROR bad value in record %zu F:%s L:%d\n",rec,__FILE__,__LINE__); exit(1);}
+           }
+       }
+
+    ret = CircBufRecRdRelease(&(p_data -> CrcBuf));
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+   }
+return NULL;
+}
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+int ret;
+size_t Nunits, Nrecords;
+CCBFsize_t Unit;
+pthread_t writer_thd, reader_thd;
+struct shared_thd_data_str shrd_data;
+void *mem;
+
+if(argc != 3) {
+    fprintf(stderr,"ERROR: pass the size of the ring in units, and the number of records to insert\n");
+    return 1;
+   }
+ret = sscanf(argv[1],"%zu",&Nunits);
+if(ret != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = sscanf(argv[2],"%zu",&Nrecords);
+if(ret != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+for(Unit = 8; Unit <= 64; Unit *= 8) {
+    printf("Randomized test of the record layer: %zu records, units of %u bytes\n", Nrecords, (unsigned)Unit);
+
+    mem = aligned_alloc(Unit, Nunits * Unit);
+    if(mem == NULL) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    ret = CircBufRecInit(&(shrd_data.CrcBuf), mem, Nunits, Unit);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    shrd_data.Nrecords = Nrecords;
+    shrd_data.MaxLen = (Nunits - 2) * Unit;
+
+    // records that can never fit must be refused:
+    {
+    CircBufRecSpan_t span[2];
+    ret = CircBufRecWrReserve(&(shrd_data.CrcBuf), shrd_data.MaxLen + 1, &span);
+    if((ret == 0) || (ret == CCBF_AGAIN)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    }
+
+    ret = pthread_create(&writer_thd, NULL, writer, &shrd_data);
+    if(ret != 0) {fprintf(stderr,"ERROR: cannot create thread. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    ret = pthread_create(&reader_thd, NULL, reader, &shrd_data);
+    if(ret != 0) {fprintf(stderr,"ERROR: cannot create thread. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    pthread_join(writer_thd, NULL);
+    pthread_join(reader_thd, NULL);
+
+    free(mem);
+   }
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
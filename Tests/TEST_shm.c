@@ -0,0 +1,271 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Process-shared ring (circ_buf_shm.c), with fork()
+
+ - anonymous segment: a child process attaches with the inherited descriptor and writes, the parent reads,
+ - named segment, two data arrays: a first writer process claims the writer side, writes half of the values and dies without releasing it.
+   Another process can't claim the side while the first one is alive, then takes it over and writes the rest.
+   Halfway through, the reader detaches without committing what it read, attaches again: it gets the same values again.
+ - anonymous segment, a writer process that waits for batches of free space of random sizes, then a reader that waits
+   for batches of data of random sizes, up to the whole ring: the private copy of the other index must be read again while they wait.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "circ_buf.h"
+#include "circ_buf_spsc.h"
+#include "circ_buf_shm.h"
+
+
+// ==============================================================================
+
+//
+// writes the values [First, Last), and their squares in the second array if there is one
+// Batch > 0 : random batches from 1 to Batch values: waits until the batch fits (or all the values left), and writes exactly it
+//
+int write_values(CircBufShm_t *p_shm, uint32_t First, uint32_t Last, CCBFsize_t Batch)
+{
+CCBFsize_t IndTab[2][2];
+uint32_t *vals = CircBufShmArray(p_shm, 0);
+uint64_t *squares = CircBufShmArray(p_shm, 1);
+uint32_t cur = First;
+CCBFsize_t n, i, Need = 0;
+int y;
+
+while(cur < Last) {
+    if(CircBufSpscWrInd(p_shm -> p_Ring, &IndTab) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    if(Batch > 0) {
+        if(Need == 0) Need = 1 + rand() % Batch;
+        if((CircBufSzSum(IndTab) < Need) && (CircBufSzSum(IndTab) < Last - cur)) {
+            sched_yield();
+            continue;
+            }
+        }
+    n = 0;
+    for(y = 0; y < 2; y++) {
+        for(i = IndTab[y][0]; (i <= IndTab[y][1]) && (IndTab[y][0] <= IndTab[y][1]) && (cur < Last) && ((Need == 0) || (n < Need)); i++) {
+            vals[i] = cur;
+            if(squares != NULL) squares[i] = (uint64_t)cur * cur;
+            cur++;
+            n++;
+            }
+        }
+    if(CircBufSpscUpdtWr(p_shm -> p_Ring, n) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    Need = 0;
+    if(n == 0) sched_yield();
+   }
+return 0;
+}
+
+// ==============================================================================
+
+//
+// reads and checks the values up to Last (excluded), from *p_cur
+// Commit == 0 : stops at the first batch, without committing it
+// Batch > 0 : random batches from 1 to Batch values: waits until the batch is there (or all the values left), and reads exactly it
+//
+int read_values(CircBufShm_t *p_shm, uint32_t *p_cur, uint32_t Last, int Commit, CCBFsize_t Batch)
+{
+CCBFsize_t IndTab[2][2];
+uint32_t *vals = CircBufShmArray(p_shm, 0);
+uint64_t *squares = CircBufShmArray(p_shm, 1);
+uint32_t cur = *p_cur;
+CCBFsize_t n, i, Need = 0;
+int y;
+
+while(cur < Last) {
+    if(CircBufSpscRdInd(p_shm -> p_Ring, &IndTab) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    if(Batch > 0) {
+        if(Need == 0) Need = 1 + rand() % Batch;
+        if((CircBufSzSum(IndTab) < Need) && (CircBufSzSum(IndTab) < Last - cur)) {
+            sched_yield();
+            continue;
+            }
+        }
+    n = 0;
+    for(y = 0; y < 2; y++) {
+        for(i = IndTab[y][0]; (i <= IndTab[y][1]) && (IndTab[y][0] <= IndTab[y][1]) && (cur < Last) && ((Need == 0) || (n < Need)); i++) {
+            if(vals[i] != cur) {fprintf(stderr,"ERROR %u instead of %u F:%s L:%d\n",vals[i],cur,__FILE__,__LINE__); return 1;}
+            if((squares != NULL) && (squares[i] != (uint64_t)cur * cur)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+            cur++;
+            n++;
+            }
+        }
+    if(!Commit && (n > 0)) {
+        return 0; // *p_cur unchanged: these values must come again
+        }
+    if(CircBufSpscUpdtRd(p_shm -> p_Ring, n) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    *p_cur = cur;
+    Need = 0;
+    if(n == 0) sched_yield();
+   }
+return 0;
+}
+
+// ==============================================================================
+
+int anon_test(CCBFsize_t bufsize, uint32_t nber_vals)
+{
+CircBufShm_t Shm, ShmChild;
+size_t ElemSize = sizeof(uint32_t);
+uint32_t cur = 0;
+int status;
+pid_t pid;
+
+if(CircBufShmCreate(&Shm, NULL, bufsize, &ElemSize, 1) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufShmClaim(&Shm, CCBF_RD) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+pid = fork();
+if(pid < 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(pid == 0) {
+    if(CircBufShmAttachFd(&ShmChild, Shm.Fd) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    if(CircBufShmClaim(&ShmChild, CCBF_RD) != CCBF_AGAIN) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    if(CircBufShmClaim(&ShmChild, CCBF_WR) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    if(write_values(&ShmChild, 0, nber_vals, 0) != 0) _exit(1);
+    if(CircBufShmDetach(&ShmChild) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    _exit(0);
+    }
+
+if(read_values(&Shm, &cur, nber_vals, 1, 0) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if((waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufShmEpoch(&Shm, CCBF_WR) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufShmDetach(&Shm) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+return 0;
+}
+
+// ==============================================================================
+
+int recovery_test(CCBFsize_t bufsize, uint32_t nber_vals)
+{
+CircBufShm_t Shm, ShmChild;
+size_t ElemSize[2] = {sizeof(uint32_t), sizeof(uint64_t)};
+char name[64];
+uint32_t cur = 0, half = nber_vals / 2;
+int go[2], status;
+char c = 0;
+pid_t pid1, pid2;
+
+snprintf(name, sizeof(name), "/ccbf_test_shm_%d", (int)getpid());
+if(CircBufShmCreate(&Shm, name, bufsize, ElemSize, 2) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufShmCreate(&ShmChild, name, bufsize, ElemSize, 2) == 0) {fprintf(stderr,"ERROR created twice F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufShmClaim(&Shm, CCBF_RD) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(pipe(go) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+// first writer: dies without releasing its side
+pid1 = fork();
+if(pid1 < 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(pid1 == 0) {
+    if(CircBufShmAttach(&ShmChild, name) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    if(CircBufShmClaim(&ShmChild, CCBF_WR) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    if(write_values(&ShmChild, 0, half, 0) != 0) _exit(1);
+    if(read(go[0], &c, 1) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    _exit(0); // crash
+    }
+
+if(read_values(&Shm, &cur, half, 1, 0) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufShmClaim(&Shm, CCBF_WR) != CCBF_AGAIN) {fprintf(stderr,"ERROR the writer is alive F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(write(go[1], &c, 1) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if((waitpid(pid1, &status, 0) != pid1) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufShmEpoch(&Shm, CCBF_WR) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+// second writer: takes over
+pid2 = fork();
+if(pid2 < 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(pid2 == 0) {
+    if(CircBufShmAttach(&ShmChild, name) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    if(CircBufShmClaim(&ShmChild, CCBF_WR) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    if(CircBufShmEpoch(&ShmChild, CCBF_WR) != 2) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    if(write_values(&ShmChild, half, nber_vals, 0) != 0) _exit(1);
+    if(CircBufShmDetach(&ShmChild) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    _exit(0);
+    }
+
+// reader restart: what was read and not committed comes again
+if(read_values(&Shm, &cur, nber_vals, 0, 0) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufShmDetach(&Shm) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufShmAttach(&Shm, name) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufShmClaim(&Shm, CCBF_RD) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufShmEpoch(&Shm, CCBF_RD) != 2) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(read_values(&Shm, &cur, nber_vals, 1, 0) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+if((waitpid(pid2, &status, 0) != pid2) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufShmUnlink(name) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufShmDetach(&Shm) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufShmAttach(&Shm, name) == 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+close(go[0]);
+close(go[1]);
+return 0;
+}
+
+// ==============================================================================
+
+//
+// WrBatch, RdBatch : see write_values() and read_values()
+//
+int batch_test(CCBFsize_t bufsize, uint32_t nber_vals, CCBFsize_t WrBatch, CCBFsize_t RdBatch)
+{
+CircBufShm_t Shm, ShmChild;
+size_t ElemSize = sizeof(uint32_t);
+uint32_t cur = 0;
+int status;
+pid_t pid;
+
+if(CircBufShmCreate(&Shm, NULL, bufsize, &ElemSize, 1) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufShmClaim(&Shm, CCBF_RD) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+pid = fork();
+if(pid < 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(pid == 0) {
+    if(CircBufShmAttachFd(&ShmChild, Shm.Fd) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    if(CircBufShmClaim(&ShmChild, CCBF_WR) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    if(write_values(&ShmChild, 0, nber_vals, WrBatch) != 0) _exit(1);
+    if(CircBufShmDetach(&ShmChild) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); _exit(1);}
+    _exit(0);
+    }
+
+if(read_values(&Shm, &cur, nber_vals, 1, RdBatch) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if((waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufShmDetach(&Shm) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+return 0;
+}
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+unsigned int bufsize, nber_vals;
+
+fprintf(stderr,"Test of the process-shared ring\n");
+
+if(argc != 3) {
+    fprintf(stderr,"ERROR: pass the size of the ring, then the number of values to transfer\n");
+    return 1;
+   }
+if(sscanf(argv[1],"%u",&bufsize) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(sscanf(argv[2],"%u",&nber_vals) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+fprintf(stderr,"anonymous segment\n");
+if(anon_test(bufsize, nber_vals) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+fprintf(stderr,"named segment, writer crash\n");
+if(recovery_test(bufsize, nber_vals) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+fprintf(stderr,"writer waiting for batches\n");
+if(batch_test(bufsize, nber_vals, bufsize - 1, 0) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+fprintf(stderr,"reader waiting for batches\n");
+if(batch_test(bufsize, nber_vals, 0, bufsize - 1) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
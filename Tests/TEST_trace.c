@@ -0,0 +1,168 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Trace points of circ_buf.c and trace recorder (circ_buf_trace.c)
+
+ - one writer thread, one reader thread, random batches, plus a second ring used by the main thread:
+   every call is recorded, with the right ring, event and count, and the file saved gives the same records,
+ - a recorder too small counts the events dropped,
+ - only one recorder at a time.
+
+ The capture is left in place for Tools/ccbf_trace.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "circ_buf.h"
+#include "circ_buf_trace.h"
+
+
+#define RING_SIZE 100
+
+struct shared_thd_data_str
+{
+  CircBuf_t CrcBuf;
+  uint64_t nber_vals;
+  uint64_t wr_calls, rd_calls, wr_updts, rd_updts; // kept by the threads
+};
+
+// ==============================================================================
+
+void *writer(void *p_usr_in)
+{
+struct shared_thd_data_str *p_data = p_usr_in;
+unsigned short xsubi[3] = {1, 2, 3};
+CCBFsize_t WrInd[2][2], n;
+uint64_t cur = 0;
+
+while(cur < p_data -> nber_vals) {
+    CircBufWrInd(CIRCBUF(&(p_data -> CrcBuf)), &WrInd);
+    p_data -> wr_calls++;
+    n = CircBufSzSum(WrInd);
+    if(n == 0) {
+        sched_yield();
+        continue;
+        }
+    n = 1 + (n - 1) * erand48(xsubi);
+    if(n > p_data -> nber_vals - cur) n = p_data -> nber_vals - cur;
+    CircBufUpdtWr(CIRCBUF(&(p_data -> CrcBuf)), n);
+    p_data -> wr_updts++;
+    cur += n;
+   }
+return NULL;
+}
+
+// ==============================================================================
+
+void *reader(void *p_usr_in)
+{
+struct shared_thd_data_str *p_data = p_usr_in;
+unsigned short xsubi[3] = {4, 5, 6};
+CCBFsize_t RdInd[2][2], n;
+uint64_t cur = 0;
+
+while(cur < p_data -> nber_vals) {
+    CircBufRdInd(CIRCBUF(&(p_data -> CrcBuf)), &RdInd);
+    p_data -> rd_calls++;
+    n = CircBufSzSum(RdInd);
+    if(n == 0) {
+        sched_yield();
+        continue;
+        }
+    n = 1 + (n - 1) * erand48(xsubi);
+    CircBufUpdtRd(CIRCBUF(&(p_data -> CrcBuf)), n);
+    p_data -> rd_updts++;
+    cur += n;
+   }
+return NULL;
+}
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+static struct shared_thd_data_str data;
+CircBufTrace_t Trace, Trace2;
+CircBufTraceRec_t *Recs, *Loaded, Small[10];
+CircBuf_t Other;
+CCBFsize_t Ind[2][2];
+pthread_t thd_wr, thd_rd;
+unsigned long nber_vals;
+uint64_t capacity, count, dropped, i, nev[4] = {0, 0, 0, 0}, items = 0;
+char *path;
+
+fprintf(stderr,"Test of the trace recorder\n");
+
+if(argc != 3) {
+    fprintf(stderr,"ERROR: pass the path of the capture, then the number of elements to transfer\n");
+    return 1;
+   }
+path = argv[1];
+if(sscanf(argv[2],"%lu",&nber_vals) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+capacity = 8 * (uint64_t)nber_vals + 1000;
+Recs = malloc(capacity * sizeof(CircBufTraceRec_t));
+if(Recs == NULL) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+data.nber_vals = nber_vals;
+if(CircBufInit(CIRCBUF(&(data.CrcBuf)), RING_SIZE) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufInit(CIRCBUF(&Other), 10) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+CircBufWrInd(CIRCBUF(&Other), &Ind); // not recorded
+
+if(CircBufTraceStart(&Trace, Recs, capacity) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufTraceStart(&Trace2, Small, 10) == 0) {fprintf(stderr,"ERROR two recorders F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(pthread_create(&thd_wr, NULL, writer, &data) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(pthread_create(&thd_rd, NULL, reader, &data) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+CircBufWrInd(CIRCBUF(&Other), &Ind);
+CircBufUpdtWr(CIRCBUF(&Other), 7);
+CircBufRdInd(CIRCBUF(&Other), &Ind);
+CircBufUpdtRd(CIRCBUF(&Other), 7);
+pthread_join(thd_wr, NULL);
+pthread_join(thd_rd, NULL);
+if(CircBufTraceStop(&Trace) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+CircBufUpdtWr(CIRCBUF(&Other), 1); // not recorded
+
+count = CircBufTraceCount(&Trace);
+if((CircBufTraceDropped(&Trace) != 0) || (count != data.wr_calls + data.rd_calls + data.wr_updts + data.rd_updts + 4)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(CircBufTraceSave(&Trace, path) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+// the file:
+if(CircBufTraceLoad(path, &Loaded, &count, &dropped) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if((count != CircBufTraceCount(&Trace)) || (dropped != 0) || (memcmp(Loaded, Recs, count * sizeof(CircBufTraceRec_t)) != 0)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+for(i = 0; i < count; i++) {
+    if(Loaded[i].Ring == (uintptr_t)&Other) {
+        if((Loaded[i].ElemInBuf != 10) || (Loaded[i].N != ((Loaded[i].Event == CCBF_TRACE_WRIND) ? 9 : 7))) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+        continue;
+        }
+    if((Loaded[i].Ring != (uintptr_t)&(data.CrcBuf)) || (Loaded[i].ElemInBuf != RING_SIZE) || (Loaded[i].Event > CCBF_TRACE_UPDTRD)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if((Loaded[i].Rd >= RING_SIZE) || (Loaded[i].Wr >= RING_SIZE) || (Loaded[i].Tid == 0)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    nev[Loaded[i].Event]++;
+    if(Loaded[i].Event == CCBF_TRACE_UPDTWR) items += Loaded[i].N;
+   }
+if((nev[CCBF_TRACE_WRIND] != data.wr_calls) || (nev[CCBF_TRACE_RDIND] != data.rd_calls)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if((nev[CCBF_TRACE_UPDTWR] != data.wr_updts) || (nev[CCBF_TRACE_UPDTRD] != data.rd_updts) || (items != nber_vals)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+free(Loaded);
+
+// too small:
+if(CircBufTraceStart(&Trace2, Small, 10) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+for(i = 0; i < 12; i++) {
+    CircBufRdInd(CIRCBUF(&Other), &Ind);
+    }
+if(CircBufTraceStop(&Trace2) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if((CircBufTraceCount(&Trace2) != 10) || (CircBufTraceDropped(&Trace2) != 2)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+free(Recs);
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
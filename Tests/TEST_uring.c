@@ -0,0 +1,237 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ io_uring pump (circ_buf_uring.c)
+
+ - file --> ring --> file: positioned reads and writes, several in flight, the output file must be a copy of the input one,
+ - pipe --> ring --> unix socket: a thread writes a sequence of bytes into the pipe, another one checks it on the socket,
+ - closing a pump while a read is pending on an empty pipe.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+
+#include "circ_buf.h"
+#include "circ_buf_uring.h"
+
+
+#define DEPTH 8
+#define CHUNK 4096
+
+static size_t nber_test_bytes;
+
+static uint8_t test_byte(size_t i)
+{
+return (i * 7 + (i >> 13)) % 251;
+}
+
+// ==============================================================================
+
+//
+// runs both pumps until the input reaches its end and the ring is empty
+//
+int run_pumps(CircBuf_t *p_CrcBuf, CircBufUring_t *p_in, CircBufUring_t *p_out, size_t *p_total)
+{
+CCBFsize_t n_in, n_out;
+int err;
+
+*p_total = 0;
+while(!(p_in -> Eof) || (CircBufUringInflight(p_in) > 0) || (CircBufAvailRd(p_CrcBuf) > 0) || (CircBufUringInflight(p_out) > 0)) {
+    if((err = CircBufUringPump(p_in, 0, &n_in)) != 0) {fprintf(stderr,"ERROR %d F:%s L:%d\n",err,__FILE__,__LINE__); return 1;}
+    if((err = CircBufUringPump(p_out, 0, &n_out)) != 0) {fprintf(stderr,"ERROR %d F:%s L:%d\n",err,__FILE__,__LINE__); return 1;}
+    *p_total += n_in;
+    if((n_in == 0) && (n_out == 0)) sched_yield();
+   }
+return 0;
+}
+
+// ==============================================================================
+
+int file_test(CCBFsize_t ring_size)
+{
+char name_in[] = "/tmp/ccbf_uring_in_XXXXXX", name_out[] = "/tmp/ccbf_uring_out_XXXXXX";
+int fd_in, fd_out;
+CircBuf_t CrcBuf;
+CircBufUring_t In, Out;
+CircBufUringOp_t OpsIn[DEPTH], OpsOut[DEPTH];
+uint8_t *data, chunk[CHUNK];
+size_t i, n, total;
+
+fd_in = mkstemp(name_in);
+fd_out = mkstemp(name_out);
+if((fd_in < 0) || (fd_out < 0)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+unlink(name_in);
+unlink(name_out);
+for(i = 0; i < nber_test_bytes; i += n) {
+    n = (nber_test_bytes - i < CHUNK) ? nber_test_bytes - i : CHUNK;
+    for(size_t k = 0; k < n; k++) chunk[k] = test_byte(i + k);
+    if(write(fd_in, chunk, n) != (ssize_t)n) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    }
+
+data = malloc(ring_size);
+if(data == NULL) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufInit(&CrcBuf, ring_size) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufUringInit(&In, &CrcBuf, data, CCBF_URING_IN, fd_in, 0, OpsIn, DEPTH, CHUNK) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufUringInit(&Out, &CrcBuf, data, CCBF_URING_OUT, fd_out, 0, OpsOut, DEPTH, CHUNK) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+fprintf(stderr,"fixed buffers: %d\n", In.Fixed);
+
+if(run_pumps(&CrcBuf, &In, &Out, &total) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(total != nber_test_bytes) {fprintf(stderr,"ERROR %zu bytes read F:%s L:%d\n",total,__FILE__,__LINE__); return 1;}
+if(CircBufUringClose(&In) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufUringClose(&Out) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+// check the copy:
+for(i = 0; i < nber_test_bytes; i += n) {
+    n = (nber_test_bytes - i < CHUNK) ? nber_test_bytes - i : CHUNK;
+    if(pread(fd_out, chunk, n, i) != (ssize_t)n) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+    for(size_t k = 0; k < n; k++) {
+        if(chunk[k] != test_byte(i + k)) {fprintf(stderr,"ERROR incorrect byte at %zu F:%s L:%d\n",i + k,__FILE__,__LINE__); return 1;}
+        }
+    }
+if(pread(fd_out, chunk, 1, nber_test_bytes) != 0) {fprintf(stderr,"ERROR output too long F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+close(fd_in);
+close(fd_out);
+free(data);
+return 0;
+}
+
+// ==============================================================================
+
+void *pipe_writer(void *arg)
+{
+int fd = *(int *)arg;
+uint8_t chunk[CHUNK];
+unsigned short xsubi[3] = {1, 2, 3};
+size_t i, n, k;
+ssize_t ret;
+
+for(i = 0; i < nber_test_bytes; i += n) {
+    n = 1 + (CHUNK - 1) * erand48(xsubi);
+    if(n > nber_test_bytes - i) n = nber_test_bytes - i;
+    for(k = 0; k < n; k++) chunk[k] = test_byte(i + k);
+    for(k = 0; k < n; k += ret) {
+        ret = write(fd, chunk + k, n - k);
+        if(ret <= 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+        }
+    }
+close(fd); // end of file for the pump
+return NULL;
+}
+
+void *sock_checker(void *arg)
+{
+int fd = *(int *)arg;
+uint8_t chunk[CHUNK];
+size_t i = 0, k;
+ssize_t ret;
+
+while((ret = read(fd, chunk, CHUNK)) > 0) {
+    for(k = 0; k < (size_t)ret; k++) {
+        if(chunk[k] != test_byte(i + k)) {fprintf(stderr,"ERROR incorrect byte at %zu F:%s L:%d\n",i + k,__FILE__,__LINE__); exit(1);}
+        }
+    i += ret;
+    }
+if((ret < 0) || (i != nber_test_bytes)) {fprintf(stderr,"ERROR %zu bytes received F:%s L:%d\n",i,__FILE__,__LINE__); exit(1);}
+return NULL;
+}
+
+// ==============================================================================
+
+int stream_test(CCBFsize_t ring_size)
+{
+int fds_pipe[2], fds_sock[2];
+pthread_t writer, checker;
+CircBuf_t CrcBuf;
+CircBufUring_t In, Out;
+CircBufUringOp_t OpsIn[DEPTH], OpsOut[DEPTH];
+uint8_t *data;
+size_t total;
+
+if(pipe(fds_pipe) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds_sock) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+data = malloc(ring_size);
+if(data == NULL) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufInit(&CrcBuf, ring_size) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufUringInit(&In, &CrcBuf, data, CCBF_URING_IN, fds_pipe[0], -1, OpsIn, DEPTH, CHUNK) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufUringInit(&Out, &CrcBuf, data, CCBF_URING_OUT, fds_sock[0], -1, OpsOut, DEPTH, CHUNK) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+if(pthread_create(&writer, NULL, pipe_writer, &fds_pipe[1]) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(pthread_create(&checker, NULL, sock_checker, &fds_sock[1]) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+
+if(run_pumps(&CrcBuf, &In, &Out, &total) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(total != nber_test_bytes) {fprintf(stderr,"ERROR %zu bytes read F:%s L:%d\n",total,__FILE__,__LINE__); return 1;}
+shutdown(fds_sock[0], SHUT_WR); // end of file for the checker
+
+pthread_join(writer, NULL);
+pthread_join(checker, NULL);
+if(CircBufUringClose(&In) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufUringClose(&Out) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+close(fds_pipe[0]);
+close(fds_sock[0]);
+close(fds_sock[1]);
+free(data);
+return 0;
+}
+
+// ==============================================================================
+
+int cancel_test(void)
+{
+int fds_pipe[2];
+CircBuf_t CrcBuf;
+CircBufUring_t In;
+CircBufUringOp_t Ops[DEPTH];
+uint8_t data[100];
+CCBFsize_t n;
+
+if(pipe(fds_pipe) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufInit(&CrcBuf, sizeof(data)) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufUringInit(&In, &CrcBuf, data, CCBF_URING_IN, fds_pipe[0], -1, Ops, DEPTH, CHUNK) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufUringPump(&In, 0, &n) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if((n != 0) || (CircBufUringInflight(&In) != 1)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufUringClose(&In) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+if(CircBufAvailRd(&CrcBuf) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); return 1;}
+close(fds_pipe[0]);
+close(fds_pipe[1]);
+return 0;
+}
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+unsigned int ring_size;
+
+fprintf(stderr,"Test of the io_uring pump\n");
+
+if(argc != 3) {
+    fprintf(stderr,"ERROR: pass the size of the ring (bytes), then the number of bytes to transfer\n");
+    return 1;
+   }
+if(sscanf(argv[1],"%u",&ring_size) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+if(sscanf(argv[2],"%zu",&nber_test_bytes) != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+fprintf(stderr,"file\n");
+if(file_test(ring_size) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+fprintf(stderr,"pipe and socket\n");
+if(stream_test(ring_size) != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+fprintf(stderr,"cancel\n");
+if(cancel_test() != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
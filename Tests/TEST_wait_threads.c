@@ -0,0 +1,166 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ One writer, one reader, that wait for the ring instead of polling it (circ_buf_wait.h)
+
+ The writer waits for a random amount of free space and fills it, the reader waits for a random amount of data and checks it.
+ Before that, the timeouts are checked on an empty ring.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "circ_buf_wait.h"
+
+
+typedef uint32_t elem_t;
+
+
+struct shared_thd_data_str
+{
+elem_t *buf;
+CircBufWt_t CrcBuf;
+size_t max_val; // insert max_val elements in the ring buffer, with values from 0 to max_val-1 included
+};
+
+// ==============================================================================
+
+void *writer(void *p_usr_in)
+{
+int ret;
+struct shared_thd_data_str *p_data = p_usr_in;
+size_t cur_val = 0; // next value to insert, not yet inserted
+unsigned short xsubi[3] = {1, 2, 3};
+CCBFsize_t WrInd[2][2]; // always 2x2
+CCBFsize_t Nwait, Nwritten;
+int m;
+size_t i;
+
+while(cur_val < p_data -> max_val) {
+    Nwait = 1 + (p_data -> CrcBuf.Ring.ElemInBuf - 1) * erand48(xsubi); // from 1 to ElemInBuf - 1
+    if(Nwait > p_data -> CrcBuf.Ring.ElemInBuf - 1) Nwait = p_data -> CrcBuf.Ring.ElemInBuf - 1;
+    ret = CircBufWtWaitWr(&(p_data -> CrcBuf), Nwait, -1);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    ret = CircBufWrInd(CIRCBUF(&(p_data -> CrcBuf.Ring)), &WrInd);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if(CircBufSzSum(WrInd) < Nwait) {fprintf(stderr,"ERROR woken up too early F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    Nwritten = 0;
+    for(m=0; m<2; m++) {
+        for(i=WrInd[m][0]; (i<= WrInd[m][1]) && (cur_val < p_data -> max_val); i++) {
+            p_data -> buf[i] = cur_val;
+            cur_val++;
+            Nwritten++;
+        } // i
+    }// m
+
+    ret = CircBufWtUpdtWr(&(p_data -> CrcBuf), Nwritten);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+  }
+return NULL;
+}
+
+// ==============================================================================
+
+void *reader(void *p_usr_in)
+{
+int ret;
+struct shared_thd_data_str *p_data = p_usr_in;
+size_t next_val = 0; // next value expected
+unsigned short xsubi[3] = {4, 5, 6};
+CCBFsize_t RdInd[2][2]; // always 2x2
+CCBFsize_t Nwait, Nread;
+int m;
+size_t i;
+
+while(next_val < p_data -> max_val) {
+    Nwait = 1 + (p_data -> CrcBuf.Ring.ElemInBuf - 1) * erand48(xsubi);
+    if(Nwait > p_data -> CrcBuf.Ring.ElemInBuf - 1) Nwait = p_data -> CrcBuf.Ring.ElemInBuf - 1;
+    if(Nwait > p_data -> max_val - next_val) Nwait = p_data -> max_val - next_val; // the end of the stream
+    ret = CircBufWtWaitRd(&(p_data -> CrcBuf), Nwait, -1);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    ret = CircBufRdInd(CIRCBUF(&(p_data -> CrcBuf.Ring)), &RdInd);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+    if(CircBufSzSum(RdInd) < Nwait) {fprintf(stderr,"ERROR woken up too early F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+    Nread = 0;
+    for(m=0; m<2; m++) {
+        for(i=RdInd[m][0]; i<= RdInd[m][1]; i++) {
+            if(p_data -> buf[i] != next_val) {fprintf(stderr,"ERROR: bad value. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+            next_val++;
+            Nread++;
+        } // i
+    }// m
+
+    ret = CircBufWtUpdtRd(&(p_data -> CrcBuf), Nread);
+    if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+  }
+return NULL;
+}
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+int ret;
+size_t Nbufsz, MaxVal;
+pthread_t writer_thd, reader_thd;
+struct shared_thd_data_str shrd_data;
+struct timespec t0, t1;
+int64_t elapsed;
+
+if(argc != 3) {
+    fprintf(stderr,"ERROR: pass the buffer size and the number of elements to insert\n");
+    return 1;
+   }
+ret = sscanf(argv[1],"%zu",&Nbufsz);
+if(ret != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = sscanf(argv[2],"%zu",&MaxVal);
+if(ret != 1) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+printf("Randomized test of the blocking waits: %zu insertions\n", MaxVal);
+
+shrd_data.buf = malloc(Nbufsz * sizeof(*(shrd_data.buf)));
+if(shrd_data.buf == NULL) {fprintf(stderr,"ERROR: malloc failed. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = CircBufWtInit(&(shrd_data.CrcBuf), Nbufsz);
+if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+shrd_data.max_val = MaxVal;
+
+// empty ring: all the space can be written, nothing can be read
+ret = CircBufWtWaitWr(&(shrd_data.CrcBuf), Nbufsz - 1, 0);
+if(ret != 0) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = CircBufWtWaitRd(&(shrd_data.CrcBuf), 1, 0);
+if(ret != CCBF_TIMEOUT) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+clock_gettime(CLOCK_MONOTONIC, &t0);
+ret = CircBufWtWaitRd(&(shrd_data.CrcBuf), 1, 20000000); // 20 ms
+clock_gettime(CLOCK_MONOTONIC, &t1);
+if(ret != CCBF_TIMEOUT) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+elapsed = (t1.tv_sec - t0.tv_sec) * 1000000000LL + (t1.tv_nsec - t0.tv_nsec);
+if(elapsed < 20000000) {fprintf(stderr,"ERROR: timeout too short F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = CircBufWtWaitRd(&(shrd_data.CrcBuf), Nbufsz, -1);
+if((ret == 0) || (ret == CCBF_TIMEOUT)) {fprintf(stderr,"ERROR F:%s L:%d\n",__FILE__,__LINE__); exit(1);} // can never happen
+
+ret = pthread_create(&reader_thd, NULL, reader, &shrd_data);
+if(ret != 0) {fprintf(stderr,"ERROR: cannot create thread. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+ret = pthread_create(&writer_thd, NULL, writer, &shrd_data);
+if(ret != 0) {fprintf(stderr,"ERROR: cannot create thread. F:%s L:%d\n",__FILE__,__LINE__); exit(1);}
+
+pthread_join(writer_thd, NULL);
+pthread_join(reader_thd, NULL);
+
+free(shrd_data.buf);
+
+fprintf(stderr,"OK.\n");
+
+return 0;
+}
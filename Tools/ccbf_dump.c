@@ -0,0 +1,86 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Post-mortem dump of a persistent ring (circ_buf_file.h): the elements that a process would get by reopening the file,
+ oldest first. The file is not modified.
+
+ usage: ccbf_dump [-r] [-c] file
+   -r : raw elements on stdout (default: one element per line, in hexadecimal, after its index)
+   -c : the elements of the last checkpoint, instead of the recovered ones
+ The header is described on stderr.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "circ_buf.h"
+#include "circ_buf_file.h"
+
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+CircBufFile_t File;
+const char *path = NULL;
+const char *origins[] = {"new", "live", "checkpoint"};
+int raw = 0, ckpt = 0, i, err;
+CCBFsize_t Rd, Wr, N, n, k;
+size_t b;
+uint8_t *elem;
+
+for(i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "-r") == 0) raw = 1;
+    else if(strcmp(argv[i], "-c") == 0) ckpt = 1;
+    else path = argv[i];
+    }
+if(path == NULL) {
+    fprintf(stderr,"usage: %s [-r] [-c] file\n", argv[0]);
+    return 1;
+   }
+
+if((err = CircBufFileOpen(&File, path, 0, 0, CCBF_FILE_RDONLY)) != 0) {
+    fprintf(stderr,"ERROR: %s is not a ring file (%d)\n", path, err);
+    return 1;
+   }
+
+N = File.p_Hdr -> Ring.ElemInBuf;
+if(ckpt) {
+    Rd = File.p_Hdr -> CkRdPos;
+    Wr = File.p_Hdr -> CkWrPos;
+    if((Rd >= N) || (Wr >= N)) {fprintf(stderr,"ERROR: invalid checkpoint\n"); return 1;}
+    } else {
+    Rd = File.RdPos0;
+    Wr = File.WrPos0;
+    }
+n = CircBufUsedCount(Rd, Wr, N);
+
+fprintf(stderr,"%s: %u elements of %zu bytes, boot %.36s\n", path, N, File.ElemSize, File.p_Hdr -> BootId);
+fprintf(stderr,"live indexes [%u, %u), checkpoint %lu [%u, %u), recovered from: %s\n",
+        (unsigned)CCBF_LOAD_RLX(File.p_Hdr -> Ring.RdPos), (unsigned)CCBF_LOAD_RLX(File.p_Hdr -> Ring.WrPos),
+        (unsigned long)File.p_Hdr -> Nsync, File.p_Hdr -> CkRdPos, File.p_Hdr -> CkWrPos, origins[File.Origin]);
+fprintf(stderr,"dumping %u elements from %s [%u, %u)\n", n, ckpt ? "the checkpoint" : "the recovered indexes", Rd, Wr);
+
+for(k = 0; k < n; k++) {
+    elem = File.Data + (size_t)((Rd + k) % N) * File.ElemSize;
+    if(raw) {
+        if(fwrite(elem, File.ElemSize, 1, stdout) != 1) {fprintf(stderr,"ERROR: write failed\n"); return 1;}
+        continue;
+        }
+    printf("%u:", (Rd + k) % N);
+    for(b = 0; b < File.ElemSize; b++) {
+        printf(" %02x", elem[b]);
+        }
+    printf("\n");
+    }
+
+CircBufFileClose(&File);
+return 0;
+}
@@ -0,0 +1,209 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Analysis of a capture of the trace recorder (circ_buf_trace.h).
+
+ For each ring: the occupancy over time (rebuilt from the indexes seen by every call), its maximum and its time-weighted mean,
+ the producer / consumer rates, and the stall intervals: the writer finds the ring full (from the first CircBufWrInd() that
+ finds no room, to the next one that finds some), the reader finds it empty (same with CircBufRdInd()).
+
+ usage: ccbf_trace [-s min_stall_ns] [-t] [-w window_ns] file
+   -s : stall intervals at least that long are listed one by one (default 100000 ns)
+   -t : timeline on stdout (CSV): time_ns, ring, tid, event, occupancy. One line per event.
+   -w : rates on stdout (CSV), per time window: window_start_ns, ring, produced_per_s, consumed_per_s, max_occupancy
+ The times are relative to the first event. The summary is printed on stdout, or on stderr with -t / -w.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "circ_buf.h"
+#include "circ_buf_trace.h"
+
+#define MAX_RINGS 64
+
+typedef struct ring_stat_str
+{
+  uint64_t Ring;
+  uint32_t ElemInBuf;
+  uint64_t Nev[4]; // per event
+  uint64_t ItemsWr, ItemsRd;
+  uint64_t FirstT, LastT;
+  uint32_t Occ, MaxOcc;
+  double OccArea; // sum of occupancy * ns
+  // stalls, seen by each side: [0] full (writer), [1] empty (reader)
+  int InStall[2];
+  uint64_t StallStart[2], NbStalls[2], StallNs[2], MaxStallNs[2];
+  // current window (-w)
+  uint64_t WinStart, WinWr, WinRd;
+  uint32_t WinMaxOcc;
+} ring_stat_t;
+
+static const char *EventNames[4] = {"wr_ind", "rd_ind", "updt_wr", "updt_rd"};
+static const char *StallNames[2] = {"full", "empty"};
+
+// ==============================================================================
+
+int cmp_time(const void *a, const void *b)
+{
+const CircBufTraceRec_t *x = a, *y = b;
+return (x -> TimeNs > y -> TimeNs) - (x -> TimeNs < y -> TimeNs);
+}
+
+// ==============================================================================
+
+void stall_end(ring_stat_t *p_st, int Side, uint64_t T, uint64_t T0, uint64_t MinStall, FILE *out, int Id)
+{
+uint64_t d;
+if(!p_st -> InStall[Side]) return;
+p_st -> InStall[Side] = 0;
+d = T - p_st -> StallStart[Side];
+p_st -> NbStalls[Side]++;
+p_st -> StallNs[Side] += d;
+if(d > p_st -> MaxStallNs[Side]) p_st -> MaxStallNs[Side] = d;
+if(d >= MinStall) {
+    fprintf(out,"  ring %d %-5s at %12.3f us for %10.3f us\n", Id, StallNames[Side], (p_st -> StallStart[Side] - T0) / 1e3, d / 1e3);
+    }
+}
+
+// ==============================================================================
+
+void window_flush(ring_stat_t *p_st, uint64_t T, uint64_t Window, uint64_t T0, int Id)
+{
+while(T >= p_st -> WinStart + Window) {
+    printf("%" PRIu64 ",%d,%.0f,%.0f,%u\n", p_st -> WinStart - T0, Id,
+           p_st -> WinWr * 1e9 / Window, p_st -> WinRd * 1e9 / Window, p_st -> WinMaxOcc);
+    p_st -> WinStart += Window;
+    p_st -> WinWr = p_st -> WinRd = 0;
+    p_st -> WinMaxOcc = p_st -> Occ;
+   }
+}
+
+// ==============================================================================
+
+int main(int argc, char *argv[])
+{
+static ring_stat_t Stats[MAX_RINGS];
+CircBufTraceRec_t *Recs, *p_rec;
+ring_stat_t *p_st;
+const char *path = NULL;
+uint64_t count, dropped, i, T0, MinStall = 100000, Window = 0, dt;
+int timeline = 0, nrings = 0, id, err, side, k;
+FILE *out;
+
+for(k = 1; k < argc; k++) {
+    if(strcmp(argv[k], "-t") == 0) timeline = 1;
+    else if((strcmp(argv[k], "-s") == 0) && (k + 1 < argc) && (sscanf(argv[k + 1], "%" SCNu64, &MinStall) == 1)) k++;
+    else if((strcmp(argv[k], "-w") == 0) && (k + 1 < argc) && (sscanf(argv[k + 1], "%" SCNu64, &Window) == 1)) k++;
+    else path = argv[k];
+    }
+if((path == NULL) || (timeline && (Window != 0))) {
+    fprintf(stderr,"usage: %s [-s min_stall_ns] [-t] [-w window_ns] file (-t and -w are exclusive)\n", argv[0]);
+    return 1;
+   }
+if((err = CircBufTraceLoad(path, &Recs, &count, &dropped)) != 0) {
+    fprintf(stderr,"ERROR: %s is not a trace file (%d)\n", path, err);
+    return 1;
+   }
+out = (timeline || (Window != 0)) ? stderr : stdout;
+fprintf(out,"%s: %" PRIu64 " events, %" PRIu64 " dropped\n", path, count, dropped);
+if(count == 0) {
+    free(Recs);
+    return 0;
+   }
+
+qsort(Recs, count, sizeof(CircBufTraceRec_t), cmp_time); // the slots are claimed before the clock is read
+T0 = Recs[0].TimeNs;
+if(timeline) printf("time_ns,ring,tid,event,occupancy\n");
+if(Window != 0) printf("window_start_ns,ring,produced_per_s,consumed_per_s,max_occupancy\n");
+fprintf(out,"stalls of %" PRIu64 " ns or more:\n", MinStall);
+
+for(i = 0; i < count; i++) {
+    p_rec = Recs + i;
+    if((p_rec -> Event > CCBF_TRACE_UPDTRD) || (p_rec -> ElemInBuf < 2) || (p_rec -> Rd >= p_rec -> ElemInBuf) || (p_rec -> Wr >= p_rec -> ElemInBuf)) {
+        fprintf(stderr,"ERROR: invalid record %" PRIu64 "\n", i);
+        free(Recs);
+        return 1;
+        }
+    for(id = 0; (id < nrings) && (Stats[id].Ring != p_rec -> Ring); id++);
+    if(id == nrings) {
+        if(nrings == MAX_RINGS) continue; // too many rings: the next ones are ignored
+        nrings++;
+        p_st = Stats + id;
+        p_st -> Ring = p_rec -> Ring;
+        p_st -> ElemInBuf = p_rec -> ElemInBuf;
+        p_st -> FirstT = p_st -> LastT = p_rec -> TimeNs;
+        p_st -> WinStart = T0; // the same windows for every ring
+        }
+    p_st = Stats + id;
+    if(Window != 0) window_flush(p_st, p_rec -> TimeNs, Window, T0, id);
+
+    // occupancy: a snapshot of both indexes in every record
+    dt = p_rec -> TimeNs - p_st -> LastT;
+    p_st -> OccArea += (double)p_st -> Occ * dt;
+    p_st -> LastT = p_rec -> TimeNs;
+    p_st -> Occ = CircBufUsedCount(p_rec -> Rd, p_rec -> Wr, p_rec -> ElemInBuf);
+    if(p_st -> Occ > p_st -> MaxOcc) p_st -> MaxOcc = p_st -> Occ;
+    if(p_st -> Occ > p_st -> WinMaxOcc) p_st -> WinMaxOcc = p_st -> Occ;
+    p_st -> Nev[p_rec -> Event]++;
+
+    switch(p_rec -> Event) {
+        case CCBF_TRACE_WRIND:
+        case CCBF_TRACE_RDIND:
+            side = (p_rec -> Event == CCBF_TRACE_WRIND) ? 0 : 1;
+            if(p_rec -> N == 0) {
+                if(!p_st -> InStall[side]) {
+                    p_st -> InStall[side] = 1;
+                    p_st -> StallStart[side] = p_rec -> TimeNs;
+                    }
+                } else {
+                stall_end(p_st, side, p_rec -> TimeNs, T0, MinStall, out, id);
+                }
+            break;
+        case CCBF_TRACE_UPDTWR:
+            p_st -> ItemsWr += p_rec -> N;
+            p_st -> WinWr += p_rec -> N;
+            break;
+        default:
+            p_st -> ItemsRd += p_rec -> N;
+            p_st -> WinRd += p_rec -> N;
+            break;
+        }
+    if(timeline) {
+        printf("%" PRIu64 ",%d,%u,%s,%u\n", p_rec -> TimeNs - T0, id, p_rec -> Tid, EventNames[p_rec -> Event], p_st -> Occ);
+        }
+   }
+
+// stalls still running at the end of the capture, last windows:
+for(id = 0; id < nrings; id++) {
+    p_st = Stats + id;
+    stall_end(p_st, 0, p_st -> LastT, T0, MinStall, out, id);
+    stall_end(p_st, 1, p_st -> LastT, T0, MinStall, out, id);
+    if(Window != 0) window_flush(p_st, p_st -> WinStart + Window, Window, T0, id);
+   }
+
+for(id = 0; id < nrings; id++) {
+    p_st = Stats + id;
+    dt = p_st -> LastT - p_st -> FirstT;
+    fprintf(out,"ring %d (0x%" PRIx64 ", %u elements): %" PRIu64 " wr_ind, %" PRIu64 " rd_ind, %" PRIu64 " updt_wr, %" PRIu64 " updt_rd over %.3f ms\n",
+            id, p_st -> Ring, p_st -> ElemInBuf, p_st -> Nev[0], p_st -> Nev[1], p_st -> Nev[2], p_st -> Nev[3], dt / 1e6);
+    fprintf(out,"  occupancy: max %u, mean %.1f\n", p_st -> MaxOcc, (dt > 0) ? p_st -> OccArea / dt : (double)p_st -> Occ);
+    fprintf(out,"  produced %" PRIu64 " (%.0f /s), consumed %" PRIu64 " (%.0f /s)\n",
+            p_st -> ItemsWr, (dt > 0) ? p_st -> ItemsWr * 1e9 / dt : 0.0, p_st -> ItemsRd, (dt > 0) ? p_st -> ItemsRd * 1e9 / dt : 0.0);
+    for(side = 0; side < 2; side++) {
+        fprintf(out,"  %-5s: %" PRIu64 " intervals, %.3f us in total (%.1f %%), longest %.3f us\n", StallNames[side],
+                p_st -> NbStalls[side], p_st -> StallNs[side] / 1e3, (dt > 0) ? 100.0 * p_st -> StallNs[side] / dt : 0.0, p_st -> MaxStallNs[side] / 1e3);
+        }
+   }
+
+free(Recs);
+return 0;
+}
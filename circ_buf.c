@@ -9,6 +9,67 @@
 #include <stddef.h>
 #include "circ_buf.h"
 
+#if CCBF_TRACE
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define CCBF_USDT 1
+#endif
+#endif
+
+CircBufTraceHook_t volatile CircBufTraceHook = NULL;
+
+static inline void CircBufTrace(int Event, const CircBuf_t *p_circ, CCBFsize_t Rd, CCBFsize_t Wr, CCBFsize_t N)
+{
+CircBufTraceHook_t hook = CircBufTraceHook;
+if(hook != NULL) {
+    hook(Event, p_circ, Rd, Wr, N);
+    }
+}
+
+#ifdef CCBF_USDT
+#define CCBF_TRACE_POINT(Name, Event, p_circ, Rd, Wr, N) do { \
+    DTRACE_PROBE5(ccbf, Name, p_circ, Rd, Wr, (p_circ) -> ElemInBuf, N); \
+    CircBufTrace(Event, p_circ, Rd, Wr, N); \
+    } while(0)
+#else
+#define CCBF_TRACE_POINT(Name, Event, p_circ, Rd, Wr, N) CircBufTrace(Event, p_circ, Rd, Wr, N)
+#endif
+#else
+#define CCBF_TRACE_POINT(Name, Event, p_circ, Rd, Wr, N) do {} while(0) // the arguments are not evaluated
+#endif
+
+#if CCBF_METRICS
+// counters have a single writer: no read-modify-write instruction needed
+#define CCBF_METRIC_ADD(x, v) CCBF_STORE_RLX(x, CCBF_LOAD_RLX(x) + (v))
+
+// ==============================================================================
+
+static void CircBufMetricsClear(CircBufSideMetrics_t *p_side)
+{
+unsigned k;
+CCBF_STORE_RLX(p_side -> Calls, 0);
+CCBF_STORE_RLX(p_side -> Stalls, 0);
+CCBF_STORE_RLX(p_side -> Items, 0);
+CCBF_STORE_RLX(p_side -> MaxUsed, 0);
+for(k = 0; k < CCBF_METRICS_HIST; k++) {
+    CCBF_STORE_RLX(p_side -> Batch[k], 0);
+    }
+}
+
+// ==============================================================================
+
+//
+// one more update of N elements: bucket = number of bits of N
+//
+static void CircBufMetricsBatch(CircBufSideMetrics_t *p_side, CCBFsize_t N)
+{
+unsigned k = (N == 0) ? 0 : 8 * sizeof(unsigned long long) - __builtin_clzll(N);
+CCBF_METRIC_ADD(p_side -> Items, N);
+CCBF_METRIC_ADD(p_side -> Batch[k], 1);
+}
+#endif
+
 // ==============================================================================
 
 // SizeOfBuf : in elements (NOT bytes!) must be >= 2
@@ -28,13 +89,70 @@ if(p_circ == NULL){
     return __LINE__;
     }
 p_circ -> ElemInBuf = SizeOfBuf;
-p_circ ->RdPos = 0;
-p_circ ->WrPos = 0;
+CCBF_STORE_RLX(p_circ -> RdPos, 0);
+CCBF_STORE_RLX(p_circ -> WrPos, 0);
+#if CCBF_METRICS
+CircBufMetricsClear(&(p_circ -> WrStats));
+CircBufMetricsClear(&(p_circ -> RdStats));
+#endif
 return 0;
 }
 
 // ==============================================================================
 
+//
+// number of elements that can be written (resp. read) for a snapshot of the indexes.
+// Computed without branches: the conditions are turned into masks.
+//
+CCBFsize_t CircBufFreeCount(CCBFsize_t Rd, CCBFsize_t Wr, CCBFsize_t ElemInBuf)
+{
+CCBFbigsize_t t = (CCBFbigsize_t)Rd + ElemInBuf - Wr - 1; // in [0, 2*ElemInBuf-2]
+return t - (ElemInBuf & -(CCBFsize_t)(t >= ElemInBuf));
+}
+
+CCBFsize_t CircBufUsedCount(CCBFsize_t Rd, CCBFsize_t Wr, CCBFsize_t ElemInBuf)
+{
+CCBFbigsize_t t = (CCBFbigsize_t)Wr + ElemInBuf - Rd; // in [1, 2*ElemInBuf-1]
+return t - (ElemInBuf & -(CCBFsize_t)(t >= ElemInBuf));
+}
+
+// ==============================================================================
+
+//
+// returns the ranges of a region of Len elements starting at index Start
+// a region that doesn't wrap is returned in (*p)[1], as with CircBufWrRange() and CircBufRdRange()
+//
+// Computed without branches, as the three cases (empty, one block, wrapped) are data dependent and thus badly predicted:
+//   empty    : [0] = (1, 0)           [1] = (1, 0)
+//   one block: [0] = (1, 0)           [1] = (Start, End-1)
+//   wrapped  : [0] = (Start, Size-1)  [1] = (0, End-Size-1)
+//
+void CircBufSpanRange(CCBFsize_t Start, CCBFsize_t Len, CCBFsize_t ElemInBuf, CCBFsize_t (*p)[2][2])
+{
+CCBFbigsize_t End = (CCBFbigsize_t)Start + Len; // here we need to store up to almost twice the maximum buffer size !
+CCBFsize_t Wrap = -(CCBFsize_t)(End > ElemInBuf); // all bits set if the region wraps around
+CCBFsize_t Some = -(CCBFsize_t)(Len != 0); // all bits set if the region is not empty
+
+(*p)[0][0] = (Start & Wrap) | (1 & ~Wrap);
+(*p)[0][1] = (ElemInBuf - 1) & Wrap;
+(*p)[1][0] = (Start & ~Wrap & Some) | (1 & ~Some);
+(*p)[1][1] = ((CCBFsize_t)End - 1 - (ElemInBuf & Wrap)) & Some;
+}
+
+// ==============================================================================
+
+//
+// returns the buffers where data can be written, from a snapshot of the indexes
+//
+// if(Rd == Wr) --> buffer empty: we can write up to Rd-2 included (one element is always left unused)
+//
+void CircBufWrRange(CCBFsize_t Rd, CCBFsize_t Wr, CCBFsize_t ElemInBuf, CCBFsize_t (*p)[2][2])
+{
+CircBufSpanRange(Wr, CircBufFreeCount(Rd, Wr, ElemInBuf), ElemInBuf, p);
+}
+
+// ==============================================================================
+
 //
 // returns the buffers where data can be written
 //
@@ -56,58 +174,29 @@ if(p_circ == NULL){
     return __LINE__;
     }
 
-Rd = p_circ -> RdPos;
-Wr = p_circ -> WrPos;
-
-if(Rd == 0) {
-    if(Wr == 0) {
-       // buffer is empty
-       // [0]: empty range 
-       (*p)[1][0] = 0; 
-       (*p)[1][1] = p_circ -> ElemInBuf - 2;
-    } else if(Wr == p_circ -> ElemInBuf - 1) {
-       // buffer is full! -> empty range
-    } else {
-       // only one buffer to write to
-       (*p)[1][0] = Wr; // 1: write between Wr included, and Size-2 included
-       (*p)[1][1] = p_circ -> ElemInBuf - 2;   
-    }
-    
-} else if(Rd == 1) {
-    if(Wr == 0) {
-       // buffer is full! -> empty range
-    } else if(Wr == 1) {
-       // buffer is empty
-       (*p)[1][0] = 1;
-       (*p)[1][1] = p_circ -> ElemInBuf - 1;
-    } else { // Wr > Rd (=1)
-       // only one buffer to write to as with Rd == 0, but this time we can go up to Size-1 instead of Size-2 included
-       (*p)[1][0] = Wr; // 1: write between Wr included, and Size-1 included
-       (*p)[1][1] = p_circ -> ElemInBuf - 1;
-    }
-} else {
-    if(Wr < Rd - 1) {
-       // one zone
-       (*p)[1][0] = Wr; // 1: write between Wr included, and Rd-2 included
-       (*p)[1][1] = Rd - 2;
-    } else if(Wr == Rd - 1){
-       // buffer is full! -> empty range
-    } else if(Wr == Rd) {
-       // buffer is empty
-       (*p)[0][0] = Wr;
-       (*p)[0][1] = p_circ -> ElemInBuf - 1;
-       (*p)[1][0] = 0;
-       (*p)[1][1] = Wr - 2;
-    } else { // Wr > Rd
-       // two buffers
-       (*p)[0][0] = Wr; // 1: write between Wr included, and Size-1 included
-       (*p)[0][1] = p_circ -> ElemInBuf - 1;
-       (*p)[1][0] = 0;
-       (*p)[1][1] = Rd - 2;
+Rd = CCBF_LOAD_ACQ(p_circ -> RdPos); // owned by the reader: the reader must be done with the data before we overwrite it
+Wr = CCBF_LOAD_RLX(p_circ -> WrPos); // our own index
+
+CircBufWrRange(Rd, Wr, p_circ -> ElemInBuf, p);
+
+#if CCBF_METRICS
+CCBF_METRIC_ADD(p_circ -> WrStats.Calls, 1);
+if(CircBufSzSum((*p)) == 0) { // (the macro needs the parentheses)
+    CCBF_METRIC_ADD(p_circ -> WrStats.Stalls, 1);
     }
+#endif
+CCBF_TRACE_POINT(wr_ind, CCBF_TRACE_WRIND, p_circ, Rd, Wr, CircBufSzSum((*p)));
+return 0;
 }
 
-return 0;
+// ==============================================================================
+
+//
+// returns the buffers where data can be read, from a snapshot of the indexes
+//
+void CircBufRdRange(CCBFsize_t Rd, CCBFsize_t Wr, CCBFsize_t ElemInBuf, CCBFsize_t (*p)[2][2])
+{
+CircBufSpanRange(Rd, CircBufUsedCount(Rd, Wr, ElemInBuf), ElemInBuf, p);
 }
 
 // ==============================================================================
@@ -133,31 +222,18 @@ if(p_circ == NULL){
     return __LINE__;
    }
 
-Rd = p_circ -> RdPos;
-Wr = p_circ -> WrPos;
+Rd = CCBF_LOAD_RLX(p_circ -> RdPos); // our own index
+Wr = CCBF_LOAD_ACQ(p_circ -> WrPos); // owned by the writer: the data must be visible before we read them
 
-// special case: buffer is empty:
-if(Rd == Wr) {
-    // empty buffer: p already filled
-} else if(Rd < Wr) {
-    // only one block  containing data
-    (*p)[1][0] = Rd;
-    (*p)[1][1] = Wr - 1;
-} else {
-  // Rd > Wr
-  if(Wr == 0) {
-    // only one block  containing data
-    (*p)[1][0] = Rd;
-    (*p)[1][1] = p_circ -> ElemInBuf - 1;
-  } else {
-      // Wr > 0
-     (*p)[0][0] = Rd; // 0: empty ranges
-     (*p)[0][1] = p_circ -> ElemInBuf - 1;
-     (*p)[1][0] = 0;
-     (*p)[1][1] = Wr - 1;
-   }
-  }
+CircBufRdRange(Rd, Wr, p_circ -> ElemInBuf, p);
 
+#if CCBF_METRICS
+CCBF_METRIC_ADD(p_circ -> RdStats.Calls, 1);
+if(CircBufSzSum((*p)) == 0) { // (the macro needs the parentheses)
+    CCBF_METRIC_ADD(p_circ -> RdStats.Stalls, 1);
+    }
+#endif
+CCBF_TRACE_POINT(rd_ind, CCBF_TRACE_RDIND, p_circ, Rd, Wr, CircBufSzSum((*p)));
 return 0;
 }
 
@@ -174,10 +250,22 @@ int CircBufUpdtWr(CircBuf_t *p_circ, CCBFsize_t Nconsumed)
 {   
 // TODO: add tests on Nconsumed
 CCBFbigsize_t Wr;  // here we need to store up to almost twice the maximum buffer size !
-Wr =  p_circ -> WrPos; 
+#if CCBF_METRICS
+CCBFsize_t Used;
+#endif
+Wr =  CCBF_LOAD_RLX(p_circ -> WrPos); 
 Wr += Nconsumed;
 if(Wr >= p_circ -> ElemInBuf) Wr = Wr - p_circ -> ElemInBuf;
-p_circ -> WrPos = Wr;
+CCBF_STORE_REL(p_circ -> WrPos, Wr); // publishes the data written before this call
+#if CCBF_METRICS
+CircBufMetricsBatch(&(p_circ -> WrStats), Nconsumed);
+// the occupancy only grows here. The reader may have moved on since: this is a bound the buffer has actually reached
+Used = CircBufUsedCount(CCBF_LOAD_RLX(p_circ -> RdPos), Wr, p_circ -> ElemInBuf);
+if(Used > CCBF_LOAD_RLX(p_circ -> WrStats.MaxUsed)) {
+    CCBF_STORE_RLX(p_circ -> WrStats.MaxUsed, Used);
+    }
+#endif
+CCBF_TRACE_POINT(updt_wr, CCBF_TRACE_UPDTWR, p_circ, CCBF_LOAD_RLX(p_circ -> RdPos), (CCBFsize_t)Wr, Nconsumed);
 return 0;
 }
 
@@ -192,14 +280,98 @@ int CircBufUpdtRd(CircBuf_t *p_circ, CCBFsize_t Nconsumed)
 {
 // TODO: add tests on Nconsumed
 CCBFbigsize_t Rd;  // here we need to store up to almost twice the maximum buffer size !
-Rd =  p_circ -> RdPos; 
+Rd =  CCBF_LOAD_RLX(p_circ -> RdPos); 
 Rd += Nconsumed;
 if(Rd >= p_circ -> ElemInBuf) Rd = Rd - p_circ -> ElemInBuf;
-p_circ -> RdPos = Rd;
+CCBF_STORE_REL(p_circ -> RdPos, Rd); // frees the space only after the data have been read
+#if CCBF_METRICS
+CircBufMetricsBatch(&(p_circ -> RdStats), Nconsumed);
+#endif
+CCBF_TRACE_POINT(updt_rd, CCBF_TRACE_UPDTRD, p_circ, (CCBFsize_t)Rd, CCBF_LOAD_RLX(p_circ -> WrPos), Nconsumed);
 return 0;
 }
 
+// ==============================================================================
 
+//
+// number of elements that can be read, without building the ranges
+//
+CCBFsize_t CircBufAvailRd(CircBuf_t *p_circ)
+{
+CCBFsize_t Rd = CCBF_LOAD_RLX(p_circ -> RdPos);
+CCBFsize_t Wr = CCBF_LOAD_ACQ(p_circ -> WrPos);
+return CircBufUsedCount(Rd, Wr, p_circ -> ElemInBuf);
+}
 
+// ==============================================================================
 
+//
+// number of elements that can be written, without building the ranges
+//
+CCBFsize_t CircBufAvailWr(CircBuf_t *p_circ)
+{
+CCBFsize_t Rd = CCBF_LOAD_ACQ(p_circ -> RdPos);
+CCBFsize_t Wr = CCBF_LOAD_RLX(p_circ -> WrPos);
+return CircBufFreeCount(Rd, Wr, p_circ -> ElemInBuf);
+}
 
+// ==============================================================================
+
+//
+// first contiguous block that can be read (Side == CCBF_RD) or written (Side == CCBF_WR)
+//
+// *p_start : first index of the block
+// returns the number of elements in the block
+//
+CCBFsize_t CircBufFirstContig(CircBuf_t *p_circ, int Side, CCBFsize_t *p_start)
+{
+CCBFsize_t Rd, Wr, Start, Len, ToEnd;
+if(Side == CCBF_WR) {
+    Rd = CCBF_LOAD_ACQ(p_circ -> RdPos);
+    Wr = CCBF_LOAD_RLX(p_circ -> WrPos);
+    Start = Wr;
+    Len = CircBufFreeCount(Rd, Wr, p_circ -> ElemInBuf);
+} else {
+    Rd = CCBF_LOAD_RLX(p_circ -> RdPos);
+    Wr = CCBF_LOAD_ACQ(p_circ -> WrPos);
+    Start = Rd;
+    Len = CircBufUsedCount(Rd, Wr, p_circ -> ElemInBuf);
+}
+ToEnd = p_circ -> ElemInBuf - Start;
+*p_start = Start;
+return Len < ToEnd ? Len : ToEnd;
+}
+
+// ==============================================================================
+
+//
+// snapshot of the counters (CCBF_METRICS builds)
+//
+int CircBufMetricsGet(CircBuf_t *p_circ, size_t ElemSize, CircBufMetrics_t *p_metrics)
+{
+#if CCBF_METRICS
+unsigned k;
+#endif
+if((p_circ == NULL) || (p_metrics == NULL)) {
+    return __LINE__;
+    }
+#if CCBF_METRICS
+p_metrics -> ElemInBuf = p_circ -> ElemInBuf;
+p_metrics -> MaxUsed = CCBF_LOAD_RLX(p_circ -> WrStats.MaxUsed);
+p_metrics -> WrCalls = CCBF_LOAD_RLX(p_circ -> WrStats.Calls);
+p_metrics -> WrFull = CCBF_LOAD_RLX(p_circ -> WrStats.Stalls);
+p_metrics -> RdCalls = CCBF_LOAD_RLX(p_circ -> RdStats.Calls);
+p_metrics -> RdEmpty = CCBF_LOAD_RLX(p_circ -> RdStats.Stalls);
+p_metrics -> ItemsWr = CCBF_LOAD_RLX(p_circ -> WrStats.Items);
+p_metrics -> ItemsRd = CCBF_LOAD_RLX(p_circ -> RdStats.Items);
+p_metrics -> BytesWr = p_metrics -> ItemsWr * ElemSize;
+p_metrics -> BytesRd = p_metrics -> ItemsRd * ElemSize;
+for(k = 0; k < CCBF_METRICS_HIST; k++) {
+    p_metrics -> WrBatch[k] = CCBF_LOAD_RLX(p_circ -> WrStats.Batch[k]);
+    p_metrics -> RdBatch[k] = CCBF_LOAD_RLX(p_circ -> RdStats.Batch[k]);
+    }
+return 0;
+#else
+return __LINE__; // not compiled in
+#endif
+}
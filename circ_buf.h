@@ -6,8 +6,34 @@
  
  */
 
+#ifndef CIRC_BUF_H
+#define CIRC_BUF_H
+
+#include <stddef.h>
 #include "custom_circ_buf.h"
 
+// returned by the index managers that hand out one slot at a time (ex: circ_buf_mpmc.h) when nothing could be done:
+// buffer full or empty, try again later. This is not an error (errors are > 0).
+#define CCBF_AGAIN (-1)
+
+// returned by the blocking waits (ex: circ_buf_wait.h) when the timeout has expired. Not an error either.
+#define CCBF_TIMEOUT (-2)
+
+// log2 histogram of the batch sizes: bucket 0 counts the updates of 0 element, bucket k > 0 counts those of [2^(k-1), 2^k - 1] elements
+#define CCBF_METRICS_HIST (1 + 8 * sizeof(CCBFsize_t))
+
+#if CCBF_METRICS
+// counters updated by one side only (CCBF_METRICS builds)
+typedef struct CircBufSideMetrics_str
+{
+  CCBFvolcount_t Calls; // CircBufWrInd() (resp. CircBufRdInd()) calls
+  CCBFvolcount_t Stalls; // ... that found the buffer full (resp. empty)
+  CCBFvolcount_t Items; // sum of the Nconsumed passed to CircBufUpdtWr() (resp. CircBufUpdtRd())
+  CCBFvolcount_t Batch[CCBF_METRICS_HIST]; // histogram of these Nconsumed
+  CCBFvolsize_t MaxUsed; // writer only: highest number of elements in the buffer after CircBufUpdtWr()
+} CircBufSideMetrics_t;
+#endif
+
 typedef struct CircBuf_str
 {
   CCBFsize_t ElemInBuf; // buffer size in elements (NOT bytes!)
@@ -17,6 +43,16 @@ typedef struct CircBuf_str
   // WrPos == RdPos-1 (or ElemInBuf-1 when RdPos==0) --> buffer full
   CCBFvolsize_t RdPos; // start index of valid data in buffer
   CCBFvolsize_t WrPos; // next index to write
+
+#if CCBF_METRICS
+  // the padding keeps the indexes, the writer's counters and the reader's counters on separate cache lines
+  // (no alignment required from the caller)
+  char Pad0[CCBF_CACHE_LINE];
+  CircBufSideMetrics_t WrStats;
+  char Pad1[CCBF_CACHE_LINE];
+  CircBufSideMetrics_t RdStats;
+  char Pad2[CCBF_CACHE_LINE];
+#endif
     
 } CircBuf_t;
 
@@ -24,6 +60,18 @@ typedef struct CircBuf_str
 
 #define CIRCBUF(x) ((CircBuf_t *)x)
 
+#if CCBF_TRACE
+// events of the trace points (CCBF_TRACE builds):
+#define CCBF_TRACE_WRIND  0 // CircBufWrInd()  : N = elements that can be written
+#define CCBF_TRACE_RDIND  1 // CircBufRdInd()  : N = elements that can be read
+#define CCBF_TRACE_UPDTWR 2 // CircBufUpdtWr() : N = Nconsumed, Wr = the new WrPos
+#define CCBF_TRACE_UPDTRD 3 // CircBufUpdtRd() : N = Nconsumed, Rd = the new RdPos
+
+// called by the trace points when not NULL, in the thread of the caller (set by circ_buf_trace.c)
+typedef void (*CircBufTraceHook_t)(int Event, const CircBuf_t *p_circ, CCBFsize_t Rd, CCBFsize_t Wr, CCBFsize_t N);
+extern CircBufTraceHook_t volatile CircBufTraceHook;
+#endif
+
 
 // ElemInBuf : in elements (NOT bytes!)
 int CircBufInit(CircBuf_t *p_circ, CCBFsize_t SizeOfBuf);
@@ -43,6 +91,41 @@ int CircBufWrInd(CircBuf_t *p_circ, CCBFsize_t (*p)[2][2]);
 //
 int CircBufRdInd(CircBuf_t *p_circ, CCBFsize_t (*p)[2][2]);
 
+//
+// Same as above, but computed from a snapshot of the indexes (Rd, Wr) of a buffer of ElemInBuf elements.
+// No check is done here: this is the building block for the other index managers of this library.
+//
+void CircBufWrRange(CCBFsize_t Rd, CCBFsize_t Wr, CCBFsize_t ElemInBuf, CCBFsize_t (*p)[2][2]);
+void CircBufRdRange(CCBFsize_t Rd, CCBFsize_t Wr, CCBFsize_t ElemInBuf, CCBFsize_t (*p)[2][2]);
+
+//
+// Same layout, from the first index and the number of elements of the region (Len <= ElemInBuf).
+//
+void CircBufSpanRange(CCBFsize_t Start, CCBFsize_t Len, CCBFsize_t ElemInBuf, CCBFsize_t (*p)[2][2]);
+
+//
+// Number of elements that can be written (resp. read) for a snapshot of the indexes (Rd, Wr)
+//
+CCBFsize_t CircBufFreeCount(CCBFsize_t Rd, CCBFsize_t Wr, CCBFsize_t ElemInBuf);
+CCBFsize_t CircBufUsedCount(CCBFsize_t Rd, CCBFsize_t Wr, CCBFsize_t ElemInBuf);
+
+//
+// Number of elements that can be read (resp. written), without building the ranges: 
+// same as CircBufSzSum() of the ranges returned by CircBufRdInd() (resp. CircBufWrInd()), but much cheaper.
+// Note: p_circ is not checked here.
+//
+CCBFsize_t CircBufAvailRd(CircBuf_t *p_circ);
+CCBFsize_t CircBufAvailWr(CircBuf_t *p_circ);
+
+//
+// First contiguous block that can be read (Side == CCBF_RD) or written (Side == CCBF_WR):
+// *p_start receives its first index, and the number of elements is returned.
+// Note: p_circ is not checked here.
+//
+#define CCBF_RD 0
+#define CCBF_WR 1
+CCBFsize_t CircBufFirstContig(CircBuf_t *p_circ, int Side, CCBFsize_t *p_start);
+
 //
 // Computes the size from ranges
 //
@@ -66,6 +149,29 @@ int CircBufUpdtWr(CircBuf_t *p_circ, CCBFsize_t Nconsumed);
 //
 int CircBufUpdtRd(CircBuf_t *p_circ, CCBFsize_t Nconsumed);
 
+//
+// Snapshot of the counters of a ring (CCBF_METRICS builds), from any thread.
+// Each counter is read atomically, but the snapshot is not a consistent state of the whole ring:
+// the two sides may move on while it is taken.
+//
+typedef struct CircBufMetrics_str
+{
+  CCBFsize_t ElemInBuf;
+  CCBFsize_t MaxUsed; // occupancy high-water mark, in elements (at most ElemInBuf - 1)
+  uint64_t WrCalls, WrFull; // CircBufWrInd() calls, and those that found the buffer full
+  uint64_t RdCalls, RdEmpty; // CircBufRdInd() calls, and those that found the buffer empty
+  uint64_t ItemsWr, ItemsRd; // elements inserted / deleted
+  uint64_t BytesWr, BytesRd; // same, times ElemSize
+  uint64_t WrBatch[CCBF_METRICS_HIST]; // log2 histograms of the Nconsumed of CircBufUpdtWr() / CircBufUpdtRd(): see CCBF_METRICS_HIST
+  uint64_t RdBatch[CCBF_METRICS_HIST];
+} CircBufMetrics_t;
 
+//
+// ElemSize : bytes per element (summed over the data arrays managed by the ring), for the byte counts.
+// The counters are reset by CircBufInit().
+//
+// returns 0 if no error, and an error if the library was built without CCBF_METRICS.
+//
+int CircBufMetricsGet(CircBuf_t *p_circ, size_t ElemSize, CircBufMetrics_t *p_metrics);
 
-
+#endif // CIRC_BUF_H
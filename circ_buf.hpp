@@ -0,0 +1,176 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ C++ version of circ_buf.c, header only (C++20: std::span).
+
+ Same semantics as CircBufWrInd() / CircBufRdInd() / CircBufUpdtWr() / CircBufUpdtRd(), one writer thread and one reader thread,
+ but the element type, the capacity and the index type are template parameters instead of the global settings of custom_circ_buf.h:
+  - the index type defaults to the smallest unsigned type that can hold N - 1, so that small rings have small headers,
+  - the wrap arithmetic is done on compile-time constants: a mask when N is a power of two, a compare otherwise,
+  - the two segments are returned as std::span, in order: segment [0] first, then segment [1] (empty if there is no wrap around).
+
+ As in circ_buf.c one element is left unused: the ring holds at most N - 1 elements.
+ The indexes are std::atomic: acquire/release as with CCBF_ATOMICS=1.
+
+ */
+
+#ifndef CIRC_BUF_HPP
+#define CIRC_BUF_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <type_traits>
+
+namespace ccbf {
+
+// smallest unsigned type that can hold MaxVal
+template<std::size_t MaxVal>
+using uint_for = std::conditional_t<(MaxVal <= UINT8_MAX), std::uint8_t,
+                 std::conditional_t<(MaxVal <= UINT16_MAX), std::uint16_t,
+                 std::conditional_t<(MaxVal <= UINT32_MAX), std::uint32_t, std::uint64_t>>>;
+
+// ==============================================================================
+
+//
+// Index arithmetic of a ring of N elements, shared by the C++ rings (see also circ_buf_obj.hpp).
+// All the functions take and return values < N.
+//
+template<std::size_t N>
+struct RingIndex
+{
+  static_assert(N >= 2, "a ring holds at least 2 elements (one is always left unused)");
+
+  static constexpr bool IsPow2 = (N & (N - 1)) == 0;
+
+  // i < 2 * N
+  static constexpr std::size_t wrap(std::size_t i) noexcept
+  {
+    if constexpr (IsPow2) return i & (N - 1);
+    else return (i >= N) ? i - N : i;
+  }
+
+  // number of elements that can be read
+  static constexpr std::size_t used(std::size_t Rd, std::size_t Wr) noexcept
+  {
+    return wrap(Wr + N - Rd);
+  }
+
+  // number of elements that can be written
+  static constexpr std::size_t free(std::size_t Rd, std::size_t Wr) noexcept
+  {
+    return N - 1 - used(Rd, Wr);
+  }
+
+  // the Len elements from Start, as two segments [Start, Start + Len0) and [0, Len - Len0)
+  static constexpr std::size_t first_len(std::size_t Start, std::size_t Len) noexcept
+  {
+    return (Len < N - Start) ? Len : N - Start;
+  }
+};
+
+// ==============================================================================
+
+template<typename T, std::size_t N, typename Index = uint_for<N - 1>>
+class RingBuffer
+{
+  static_assert(std::is_unsigned_v<Index>, "the index type must be unsigned");
+  static_assert(N - 1 <= std::numeric_limits<Index>::max(), "the index type is too small for N");
+  static_assert(std::atomic<Index>::is_always_lock_free, "the index type must be lock free");
+
+  using Ind = RingIndex<N>;
+
+public:
+  using value_type = T;
+  using index_type = Index;
+  using segments = std::array<std::span<T>, 2>; // [0] then [1]
+
+  static constexpr std::size_t ElemInBuf = N;
+  static constexpr std::size_t capacity() noexcept { return N - 1; }
+
+  //
+  // the segments where data can be written
+  //
+  segments WrInd() noexcept
+  {
+    std::size_t Rd = RdPos.load(std::memory_order_acquire); // owned by the reader: the reader must be done with the data before we overwrite it
+    std::size_t Wr = WrPos.load(std::memory_order_relaxed); // our own index
+    return span_range(Wr, Ind::free(Rd, Wr));
+  }
+
+  //
+  // the segments where data can be read
+  //
+  segments RdInd() noexcept
+  {
+    std::size_t Rd = RdPos.load(std::memory_order_relaxed); // our own index
+    std::size_t Wr = WrPos.load(std::memory_order_acquire); // owned by the writer: the data must be visible before we read them
+    return span_range(Rd, Ind::used(Rd, Wr));
+  }
+
+  //
+  // Nconsumed elements have been written: publishes them
+  //
+  // returns 0 if no error.
+  //
+  int UpdtWr(std::size_t Nconsumed) noexcept
+  {
+    std::size_t Rd = RdPos.load(std::memory_order_acquire);
+    std::size_t Wr = WrPos.load(std::memory_order_relaxed);
+    if(Nconsumed > Ind::free(Rd, Wr)) {
+        return __LINE__;
+        }
+    WrPos.store(static_cast<Index>(Ind::wrap(Wr + Nconsumed)), std::memory_order_release);
+    return 0;
+  }
+
+  //
+  // Nconsumed elements have been read: frees their space
+  //
+  // returns 0 if no error.
+  //
+  int UpdtRd(std::size_t Nconsumed) noexcept
+  {
+    std::size_t Rd = RdPos.load(std::memory_order_relaxed);
+    std::size_t Wr = WrPos.load(std::memory_order_acquire);
+    if(Nconsumed > Ind::used(Rd, Wr)) {
+        return __LINE__;
+        }
+    RdPos.store(static_cast<Index>(Ind::wrap(Rd + Nconsumed)), std::memory_order_release);
+    return 0;
+  }
+
+  //
+  // number of elements that can be read (resp. written), without building the segments
+  //
+  std::size_t AvailRd() const noexcept
+  {
+    return Ind::used(RdPos.load(std::memory_order_relaxed), WrPos.load(std::memory_order_acquire));
+  }
+  std::size_t AvailWr() const noexcept
+  {
+    return Ind::free(RdPos.load(std::memory_order_acquire), WrPos.load(std::memory_order_relaxed));
+  }
+
+private:
+  segments span_range(std::size_t Start, std::size_t Len) noexcept
+  {
+    std::size_t Len0 = Ind::first_len(Start, Len);
+    return {std::span<T>(Buf + Start, Len0), std::span<T>(Buf, Len - Len0)};
+  }
+
+  std::atomic<Index> RdPos{0}; // start index of valid data in buffer
+  std::atomic<Index> WrPos{0}; // next index to write
+  T Buf[N];
+};
+
+} // namespace ccbf
+
+#endif // CIRC_BUF_HPP
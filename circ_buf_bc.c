@@ -0,0 +1,217 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Joining a reader while the writer runs:
+   the reader claims its slot as CCBF_BC_JOINING, then reads WrPos (seq_cst, on both sides), and publishes
+   this position as its RdPos, once, before the slot becomes CCBF_BC_ACTIVE.
+   Either the writer sees the slot in CircBufBcWrInd(), or the reader sees all the elements published before
+   that CircBufBcWrInd() and starts after them: the space given to the writer is then never read by the new reader
+   before being published.
+   While the slot is CCBF_BC_JOINING, the writer does not know yet where the reader starts: it gets no space
+   (a few instructions of the reader). Ignoring the slot would let it lap the position that the reader is about to publish.
+
+ */
+
+#include <stddef.h>
+#include "circ_buf_bc.h"
+
+// ==============================================================================
+
+// SizeOfBuf : in elements (NOT bytes!) must be a power of two
+int CircBufBcInit(CircBufBc_t *p_circ, CCBFsize_t SizeOfBuf, CircBufBcReader_t *Readers, CCBFsize_t Nreaders)
+{
+CCBFsize_t i;
+if(SizeOfBuf == 0) {
+    return __LINE__;
+    }
+if((SizeOfBuf & (SizeOfBuf - 1)) != 0) {
+    return __LINE__; // not a power of two
+    }
+if((p_circ == NULL) || (Readers == NULL) || (Nreaders == 0)){
+    return __LINE__;
+    }
+p_circ -> ElemInBuf = SizeOfBuf;
+p_circ -> Mask = SizeOfBuf - 1;
+p_circ -> Nreaders = Nreaders;
+p_circ -> Readers = Readers;
+for(i=0; i< Nreaders; i++) {
+    CCBF_STORE_RLX(Readers[i].State, CCBF_BC_FREE);
+    CCBF_STORE_RLX(Readers[i].RdPos, 0);
+   }
+CCBF_STORE_RLX(p_circ -> WrPos, 0);
+atomic_thread_fence(memory_order_release); // the slots must be ready before the threads start
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufBcJoin(CircBufBc_t *p_circ, CCBFsize_t *p_id)
+{
+CCBFsize_t i;
+CCBFsize_t State;
+CircBufBcReader_t *p_rd;
+
+if((p_circ == NULL) || (p_id == NULL)){
+    return __LINE__;
+    }
+
+for(i=0; i< p_circ -> Nreaders; i++) {
+    p_rd = &(p_circ -> Readers[i]);
+    State = CCBF_BC_FREE;
+    // seq_cst: pairs with the fence of CircBufBcWrInd(). From now on, the writer waits for our RdPos:
+    if(atomic_compare_exchange_strong(&(p_rd -> State), &State, CCBF_BC_JOINING)) {
+        // start after what the writer may have reserved without seeing us (see the top of this file):
+        CCBF_STORE_RLX(p_rd -> RdPos, atomic_load(&(p_circ -> WrPos)));
+        CCBF_STORE_REL(p_rd -> State, CCBF_BC_ACTIVE); // RdPos is visible before the writer uses it
+        *p_id = i;
+        return 0;
+       }
+   }
+return CCBF_AGAIN; // all the slots are taken
+}
+
+// ==============================================================================
+
+int CircBufBcLeave(CircBufBc_t *p_circ, CCBFsize_t Id)
+{
+if(p_circ == NULL){
+    return __LINE__;
+    }
+if(Id >= p_circ -> Nreaders) {
+    return __LINE__;
+    }
+if(CCBF_LOAD_RLX(p_circ -> Readers[Id].State) != CCBF_BC_ACTIVE) {
+    return __LINE__; // not joined
+    }
+CCBF_STORE_REL(p_circ -> Readers[Id].State, CCBF_BC_FREE); // we are done with the data
+return 0;
+}
+
+// ==============================================================================
+
+//
+// returns the buffers where data can be written
+//
+// returns 0 if no error.
+//
+int CircBufBcWrInd(CircBufBc_t *p_circ, CCBFsize_t (*p)[2][2])
+{
+CCBFcount_t Rd, Wr;
+CCBFcount_t Used = 0; // elements not yet read by the slowest reader
+CCBFsize_t i, State;
+CircBufBcReader_t *p_rd;
+
+if(p == NULL) {
+    return __LINE__;
+    }
+if(p_circ == NULL){
+    CircBufSpanRange(0, 0, 0, p); // set empty ranges
+    return __LINE__;
+    }
+
+Wr = CCBF_LOAD_RLX(p_circ -> WrPos); // our own index
+atomic_thread_fence(memory_order_seq_cst); // our last WrPos before the reader states: pairs with CircBufBcJoin()
+
+for(i=0; i< p_circ -> Nreaders; i++) {
+    p_rd = &(p_circ -> Readers[i]);
+    State = CCBF_LOAD_ACQ(p_rd -> State);
+    if(State == CCBF_BC_JOINING) {
+        Used = p_circ -> ElemInBuf; // its RdPos is not published yet: no space for now
+        break;
+        }
+    if(State != CCBF_BC_ACTIVE) continue;
+    Rd = CCBF_LOAD_ACQ(p_rd -> RdPos); // the reader must be done with the data before we overwrite it
+    if(Wr - Rd > Used) Used = Wr - Rd;
+   }
+if(Used > p_circ -> ElemInBuf) Used = p_circ -> ElemInBuf; // a slot that left and joined again during the scan
+
+CircBufSpanRange(Wr & p_circ -> Mask, p_circ -> ElemInBuf - (CCBFsize_t)Used, p_circ -> ElemInBuf, p);
+return 0;
+}
+
+// ==============================================================================
+
+//
+// returns the buffers where data can be read
+//
+// returns 0 if no error.
+//
+int CircBufBcRdInd(CircBufBc_t *p_circ, CCBFsize_t Id, CCBFsize_t (*p)[2][2])
+{
+CCBFcount_t Rd, Wr;
+
+if(p == NULL) {
+    return __LINE__;
+    }
+if((p_circ == NULL) || (Id >= p_circ -> Nreaders)){
+    CircBufSpanRange(0, 0, 0, p); // set empty ranges
+    return __LINE__;
+    }
+if(CCBF_LOAD_RLX(p_circ -> Readers[Id].State) != CCBF_BC_ACTIVE) {
+    CircBufSpanRange(0, 0, 0, p);
+    return __LINE__; // not joined: the writer doesn't follow this RdPos
+    }
+
+Rd = CCBF_LOAD_RLX(p_circ -> Readers[Id].RdPos); // our own index
+Wr = CCBF_LOAD_ACQ(p_circ -> WrPos); // owned by the writer: the data must be visible before we read them
+
+CircBufSpanRange(Rd & p_circ -> Mask, (CCBFsize_t)(Wr - Rd), p_circ -> ElemInBuf, p);
+return 0;
+}
+
+// ==============================================================================
+
+//
+// Updates the buffer as Nconsumed items have been inserted in the buffer
+//
+int CircBufBcUpdtWr(CircBufBc_t *p_circ, CCBFsize_t Nconsumed)
+{
+if(p_circ == NULL){
+    return __LINE__;
+    }
+if(Nconsumed > p_circ -> ElemInBuf) {
+    return __LINE__;
+    }
+CCBF_STORE_REL(p_circ -> WrPos, CCBF_LOAD_RLX(p_circ -> WrPos) + Nconsumed); // publishes the data written before this call
+return 0;
+}
+
+// ==============================================================================
+
+//
+// Updates the buffer as Nconsumed items have been read by the reader Id
+//
+int CircBufBcUpdtRd(CircBufBc_t *p_circ, CCBFsize_t Id, CCBFsize_t Nconsumed)
+{
+CircBufBcReader_t *p_rd;
+if(p_circ == NULL){
+    return __LINE__;
+    }
+if((Id >= p_circ -> Nreaders) || (Nconsumed > p_circ -> ElemInBuf)) {
+    return __LINE__;
+    }
+p_rd = &(p_circ -> Readers[Id]);
+if(CCBF_LOAD_RLX(p_rd -> State) != CCBF_BC_ACTIVE) {
+    return __LINE__; // not joined: the slot may be given to a new reader
+    }
+CCBF_STORE_REL(p_rd -> RdPos, CCBF_LOAD_RLX(p_rd -> RdPos) + Nconsumed); // frees the space only after the data have been read
+return 0;
+}
+
+// ==============================================================================
+
+CCBFcount_t CircBufBcWrOffset(CircBufBc_t *p_circ)
+{
+return CCBF_LOAD_ACQ(p_circ -> WrPos);
+}
+
+// ==============================================================================
+
+CCBFcount_t CircBufBcRdOffset(CircBufBc_t *p_circ, CCBFsize_t Id)
+{
+return CCBF_LOAD_ACQ(p_circ -> Readers[Id].RdPos);
+}
@@ -0,0 +1,105 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Broadcast (fan-out) index manager: one writer, several readers on the same buffer.
+
+ Every element written is read by all the readers: each reader has its own read position,
+ and the writer only gets the space that the slowest reader has already read.
+ A writer with no reader never blocks: the data are simply not kept (except for the few instructions of a CircBufBcJoin()).
+
+ The readers are kept in a caller-provided array of CircBufBcReader_t (one cache line each).
+ Readers can join and leave at any time: a reader that joins starts with the next element written.
+
+ The buffer size must be a power of two, and the positions are free running counters as in circ_buf_p2.h:
+ all ElemInBuf elements can be used.
+ Requires CCBF_ATOMICS=1 (see custom_circ_buf.h).
+
+ */
+
+#ifndef CIRC_BUF_BC_H
+#define CIRC_BUF_BC_H
+
+#include "circ_buf.h"
+
+#if !CCBF_ATOMICS
+#error "circ_buf_bc.h requires CCBF_ATOMICS=1 (see custom_circ_buf.h)"
+#endif
+
+// state of a reader slot
+#define CCBF_BC_FREE    0 // no reader
+#define CCBF_BC_JOINING 1 // taken by a reader that has not published its RdPos yet: the writer gets no space meanwhile
+#define CCBF_BC_ACTIVE  2 // the writer does not overwrite the data not yet read
+
+typedef struct CircBufBcReader_str
+{
+  CCBFvolsize_t State; // CCBF_BC_FREE, CCBF_BC_JOINING or CCBF_BC_ACTIVE
+  CCBFvolcount_t RdPos; // number of elements written before the next one to read. (RdPos & Mask) : start index of valid data in buffer
+} __attribute__((aligned(CCBF_CACHE_LINE))) CircBufBcReader_t;
+
+typedef struct CircBufBc_str
+{
+  CCBFsize_t ElemInBuf; // buffer size in elements (NOT bytes!), power of two
+  CCBFsize_t Mask; // ElemInBuf - 1
+  CCBFsize_t Nreaders; // size of the Readers array: maximum number of readers at the same time
+  CircBufBcReader_t *Readers; // caller provided
+
+  CCBFvolcount_t WrPos __attribute__((aligned(CCBF_CACHE_LINE))); // number of elements written since the initialization
+
+} CircBufBc_t;
+
+#define CIRCBUFBC(x) ((CircBufBc_t *)x)
+
+
+// SizeOfBuf : in elements (NOT bytes!), must be a power of two
+// Readers : array of Nreaders slots, that must live as long as the index manager
+int CircBufBcInit(CircBufBc_t *p_circ, CCBFsize_t SizeOfBuf, CircBufBcReader_t *Readers, CCBFsize_t Nreaders);
+
+//
+// Registers a new reader, that will read all the elements written from now on.
+// *p_id receives the reader number, to pass to the reader functions.
+//
+// returns 0 if no error, CCBF_AGAIN if all the reader slots are taken.
+//
+int CircBufBcJoin(CircBufBc_t *p_circ, CCBFsize_t *p_id);
+
+//
+// Unregisters the reader: the writer no longer waits for it. The reader number can then be reused by CircBufBcJoin().
+//
+int CircBufBcLeave(CircBufBc_t *p_circ, CCBFsize_t Id);
+
+//
+// returns the buffers where data can be written: the space already read by all the readers.
+//
+// returns 0 if no error.
+//
+int CircBufBcWrInd(CircBufBc_t *p_circ, CCBFsize_t (*p)[2][2]);
+
+//
+// returns the buffers where data can be read by the reader Id
+//
+// returns 0 if no error (an error if the reader Id is not joined).
+//
+int CircBufBcRdInd(CircBufBc_t *p_circ, CCBFsize_t Id, CCBFsize_t (*p)[2][2]);
+
+//
+// Updates the buffer as Nconsumed items have been inserted in the buffer
+//
+int CircBufBcUpdtWr(CircBufBc_t *p_circ, CCBFsize_t Nconsumed);
+
+//
+// Updates the buffer as Nconsumed items have been read by the reader Id (an error if it is not joined)
+//
+int CircBufBcUpdtRd(CircBufBc_t *p_circ, CCBFsize_t Id, CCBFsize_t Nconsumed);
+
+//
+// Absolute offsets in the stream: number of elements written since the initialization (writer),
+// and position of the reader Id in the stream.
+//
+CCBFcount_t CircBufBcWrOffset(CircBufBc_t *p_circ);
+CCBFcount_t CircBufBcRdOffset(CircBufBc_t *p_circ, CCBFsize_t Id);
+
+#endif // CIRC_BUF_BC_H
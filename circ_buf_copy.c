@@ -0,0 +1,303 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ The non-temporal kernels: a head copied with memcpy() up to the alignment of the stores, unaligned loads
+ and aligned streaming stores for the body, a tail copied with memcpy(), then a store fence
+ (the streaming stores are weakly ordered, even on x86: the release store of CircBufUpdtWr() is not enough).
+
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "circ_buf_copy.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+typedef void (*CircBufStream_t)(void *Dst, const void *Src, size_t Bytes);
+
+static CircBufStream_t CircBufStreamFn = NULL; // selected at the first use
+static const char *CircBufStreamName = "memcpy";
+static pthread_once_t CircBufCopyOnce = PTHREAD_ONCE_INIT;
+
+#if defined(__x86_64__)
+
+// ==============================================================================
+
+static void CircBufStreamSse2(void *Dst, const void *Src, size_t Bytes)
+{
+uint8_t *d = Dst;
+const uint8_t *s = Src;
+size_t head = (-(uintptr_t)d) & 15;
+
+memcpy(d, s, head);
+d += head; s += head; Bytes -= head;
+for(; Bytes >= 64; Bytes -= 64, d += 64, s += 64) {
+    _mm_stream_si128((__m128i *)d,        _mm_loadu_si128((const __m128i *)s));
+    _mm_stream_si128((__m128i *)(d + 16), _mm_loadu_si128((const __m128i *)(s + 16)));
+    _mm_stream_si128((__m128i *)(d + 32), _mm_loadu_si128((const __m128i *)(s + 32)));
+    _mm_stream_si128((__m128i *)(d + 48), _mm_loadu_si128((const __m128i *)(s + 48)));
+   }
+memcpy(d, s, Bytes);
+_mm_sfence();
+}
+
+// ==============================================================================
+
+__attribute__((target("avx2")))
+static void CircBufStreamAvx2(void *Dst, const void *Src, size_t Bytes)
+{
+uint8_t *d = Dst;
+const uint8_t *s = Src;
+size_t head = (-(uintptr_t)d) & 31;
+
+memcpy(d, s, head);
+d += head; s += head; Bytes -= head;
+for(; Bytes >= 128; Bytes -= 128, d += 128, s += 128) {
+    _mm256_stream_si256((__m256i *)d,        _mm256_loadu_si256((const __m256i *)s));
+    _mm256_stream_si256((__m256i *)(d + 32), _mm256_loadu_si256((const __m256i *)(s + 32)));
+    _mm256_stream_si256((__m256i *)(d + 64), _mm256_loadu_si256((const __m256i *)(s + 64)));
+    _mm256_stream_si256((__m256i *)(d + 96), _mm256_loadu_si256((const __m256i *)(s + 96)));
+   }
+memcpy(d, s, Bytes);
+_mm_sfence();
+}
+
+// ==============================================================================
+
+__attribute__((target("avx512f")))
+static void CircBufStreamAvx512(void *Dst, const void *Src, size_t Bytes)
+{
+uint8_t *d = Dst;
+const uint8_t *s = Src;
+size_t head = (-(uintptr_t)d) & 63;
+
+memcpy(d, s, head);
+d += head; s += head; Bytes -= head;
+for(; Bytes >= 256; Bytes -= 256, d += 256, s += 256) {
+    _mm512_stream_si512((void *)d,         _mm512_loadu_si512((const void *)s));
+    _mm512_stream_si512((void *)(d + 64),  _mm512_loadu_si512((const void *)(s + 64)));
+    _mm512_stream_si512((void *)(d + 128), _mm512_loadu_si512((const void *)(s + 128)));
+    _mm512_stream_si512((void *)(d + 192), _mm512_loadu_si512((const void *)(s + 192)));
+   }
+memcpy(d, s, Bytes);
+_mm_sfence();
+}
+
+#endif // __x86_64__
+
+// ==============================================================================
+
+//
+// runtime dispatch, run once by pthread_once()
+//
+static void CircBufCopySelect(void)
+{
+#if defined(__x86_64__)
+__builtin_cpu_init();
+if(__builtin_cpu_supports("avx512f")) {
+    CircBufStreamName = "avx512";
+    CircBufStreamFn = CircBufStreamAvx512;
+    } else if(__builtin_cpu_supports("avx2")) {
+    CircBufStreamName = "avx2";
+    CircBufStreamFn = CircBufStreamAvx2;
+    } else {
+    CircBufStreamName = "sse2"; // always there on x86-64
+    CircBufStreamFn = CircBufStreamSse2;
+    }
+#else
+CircBufStreamFn = (CircBufStream_t)memcpy;
+#endif
+}
+
+// ==============================================================================
+
+int CircBufCopySetKernel(const char *Name)
+{
+pthread_once(&CircBufCopyOnce, CircBufCopySelect);
+if(Name == NULL) {
+    return __LINE__;
+    }
+#if defined(__x86_64__)
+if((strcmp(Name, "avx512") == 0) && __builtin_cpu_supports("avx512f")) {
+    CircBufStreamName = "avx512";
+    CircBufStreamFn = CircBufStreamAvx512;
+    return 0;
+    }
+if((strcmp(Name, "avx2") == 0) && __builtin_cpu_supports("avx2")) {
+    CircBufStreamName = "avx2";
+    CircBufStreamFn = CircBufStreamAvx2;
+    return 0;
+    }
+if(strcmp(Name, "sse2") == 0) {
+    CircBufStreamName = "sse2";
+    CircBufStreamFn = CircBufStreamSse2;
+    return 0;
+    }
+#endif
+if(strcmp(Name, "memcpy") == 0) {
+    CircBufStreamName = "memcpy";
+    CircBufStreamFn = (CircBufStream_t)memcpy;
+    return 0;
+    }
+return __LINE__;
+}
+
+// ==============================================================================
+
+static inline void CircBufCopyBytes(void *Dst, const void *Src, size_t Bytes, int Flags)
+{
+if((Flags & CCBF_COPY_STREAM) && (Bytes >= CCBF_COPY_NT_MIN)) {
+    pthread_once(&CircBufCopyOnce, CircBufCopySelect);
+    CircBufStreamFn(Dst, Src, Bytes);
+    } else {
+    memcpy(Dst, Src, Bytes);
+    }
+}
+
+// ==============================================================================
+
+const char *CircBufCopyKernel(void)
+{
+pthread_once(&CircBufCopyOnce, CircBufCopySelect);
+return CircBufStreamName;
+}
+
+// ==============================================================================
+
+CCBFsize_t CircBufCopyToRanges(void *Data, size_t ElemSize, CCBFsize_t (*p)[2][2], const void *Src, CCBFsize_t N, int Flags)
+{
+CCBFsize_t done = 0, sz;
+int m;
+
+for(m = 0; m < 2; m++) {
+    sz = CircBufSz(m, (*p));
+    if(sz > N - done) sz = N - done;
+    if(sz == 0) continue;
+    CircBufCopyBytes((uint8_t *)Data + (size_t)(*p)[m][0] * ElemSize, (const uint8_t *)Src + (size_t)done * ElemSize, (size_t)sz * ElemSize, Flags);
+    done += sz;
+   }
+return done;
+}
+
+// ==============================================================================
+
+CCBFsize_t CircBufCopyFromRanges(const void *Data, size_t ElemSize, CCBFsize_t (*p)[2][2], void *Dst, CCBFsize_t N, int Flags)
+{
+CCBFsize_t done = 0, sz;
+int m;
+
+for(m = 0; m < 2; m++) {
+    sz = CircBufSz(m, (*p));
+    if(sz > N - done) sz = N - done;
+    if(sz == 0) continue;
+    CircBufCopyBytes((uint8_t *)Dst + (size_t)done * ElemSize, (const uint8_t *)Data + (size_t)(*p)[m][0] * ElemSize, (size_t)sz * ElemSize, Flags);
+    done += sz;
+   }
+return done;
+}
+
+// ==============================================================================
+
+int CircBufCopyIn(CircBuf_t *p_circ, void *Data, size_t ElemSize, const void *Src, CCBFsize_t N, int Flags, CCBFsize_t *p_n)
+{
+CCBFsize_t Ind[2][2], n;
+int err;
+
+if((p_circ == NULL) || (Data == NULL) || (ElemSize == 0) || ((Src == NULL) && (N > 0)) || (p_n == NULL)) {
+    return __LINE__;
+    }
+*p_n = 0;
+if((err = CircBufWrInd(p_circ, &Ind)) != 0) {
+    return err;
+    }
+n = CircBufCopyToRanges(Data, ElemSize, &Ind, Src, N, Flags);
+if(n == 0) {
+    return (N > 0) ? CCBF_AGAIN : 0;
+    }
+if((err = CircBufUpdtWr(p_circ, n)) != 0) {
+    return err;
+    }
+*p_n = n;
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufCopyOut(CircBuf_t *p_circ, const void *Data, size_t ElemSize, void *Dst, CCBFsize_t N, int Flags, CCBFsize_t *p_n)
+{
+CCBFsize_t Ind[2][2], n;
+int err;
+
+if((p_circ == NULL) || (Data == NULL) || (ElemSize == 0) || ((Dst == NULL) && (N > 0)) || (p_n == NULL)) {
+    return __LINE__;
+    }
+*p_n = 0;
+if((err = CircBufRdInd(p_circ, &Ind)) != 0) {
+    return err;
+    }
+n = CircBufCopyFromRanges(Data, ElemSize, &Ind, Dst, N, Flags);
+if(n == 0) {
+    return (N > 0) ? CCBF_AGAIN : 0;
+    }
+if((err = CircBufUpdtRd(p_circ, n)) != 0) {
+    return err;
+    }
+*p_n = n;
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufCopyRing(CircBuf_t *p_src, const void *SrcData, CircBuf_t *p_dst, void *DstData, size_t ElemSize, CCBFsize_t N, int Flags, CCBFsize_t *p_n)
+{
+CCBFsize_t RdInd[2][2], WrInd[2][2], n, done = 0, sz, i = 0, j = 0, ri = 0, wj = 0;
+int err;
+
+if((p_src == NULL) || (SrcData == NULL) || (p_dst == NULL) || (DstData == NULL) || (ElemSize == 0) || (p_n == NULL)) {
+    return __LINE__;
+    }
+*p_n = 0;
+if((err = CircBufRdInd(p_src, &RdInd)) != 0) {
+    return err;
+    }
+if((err = CircBufWrInd(p_dst, &WrInd)) != 0) {
+    return err;
+    }
+n = CircBufSzSum(RdInd);
+if(n > CircBufSzSum(WrInd)) n = CircBufSzSum(WrInd);
+if(n > N) n = N;
+if(n == 0) {
+    return (N > 0) ? CCBF_AGAIN : 0;
+    }
+
+// walks the two segments of each side: i, j the current segments, ri, wj the elements already done in them
+while(done < n) {
+    if(ri == CircBufSz(i, RdInd)) {i++; ri = 0; continue;}
+    if(wj == CircBufSz(j, WrInd)) {j++; wj = 0; continue;}
+    sz = CircBufSz(i, RdInd) - ri;
+    if(sz > CircBufSz(j, WrInd) - wj) sz = CircBufSz(j, WrInd) - wj;
+    if(sz > n - done) sz = n - done;
+    CircBufCopyBytes((uint8_t *)DstData + (size_t)(WrInd[j][0] + wj) * ElemSize, (const uint8_t *)SrcData + (size_t)(RdInd[i][0] + ri) * ElemSize,
+                     (size_t)sz * ElemSize, Flags);
+    ri += sz;
+    wj += sz;
+    done += sz;
+   }
+
+if((err = CircBufUpdtWr(p_dst, n)) != 0) { // the data is in p_dst before it leaves p_src
+    return err;
+    }
+if((err = CircBufUpdtRd(p_src, n)) != 0) {
+    return err;
+    }
+*p_n = n;
+return 0;
+}
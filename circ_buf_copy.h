@@ -0,0 +1,81 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Bulk copies between a linear buffer and the data buffer of a ring, or between two rings, elements of ElemSize bytes.
+
+ The copies follow the [2][2] ranges of any index manager (CircBufCopyToRanges(), CircBufCopyFromRanges()): at most two memcpy(),
+ split at the wrap around. CircBufCopyIn(), CircBufCopyOut() and CircBufCopyRing() also get the ranges and update the indexes of a CircBuf_t.
+
+ The regular copies are memcpy(): the C library already selects the best SIMD version for the CPU at runtime.
+ With CCBF_COPY_STREAM, the segments of CCBF_COPY_NT_MIN bytes or more are copied with non-temporal stores instead
+ (AVX-512, AVX2 or SSE2, chosen at runtime on x86-64; memcpy() elsewhere): the data goes to memory without evicting the cache
+ of this core, which is what we want for large blocks that are consumed by another core or another socket, and that
+ this core won't read again. The stores are fenced before the function returns, so the usual CircBufUpdtWr() publishes them.
+
+ */
+
+#ifndef CIRC_BUF_COPY_H
+#define CIRC_BUF_COPY_H
+
+#include <stddef.h>
+#include "circ_buf.h"
+
+// Flags
+#define CCBF_COPY_STREAM 1 // non-temporal stores for the large segments
+
+// smallest segment (in bytes) copied with non-temporal stores: below, the data fits in the caches anyway
+#ifndef CCBF_COPY_NT_MIN
+#define CCBF_COPY_NT_MIN (256 * 1024)
+#endif
+
+
+//
+// Copies min(N, elements in the ranges) elements from Src to the ranges of Data, in order. Returns the number of elements copied.
+//
+CCBFsize_t CircBufCopyToRanges(void *Data, size_t ElemSize, CCBFsize_t (*p)[2][2], const void *Src, CCBFsize_t N, int Flags);
+
+//
+// Copies min(N, elements in the ranges) elements from the ranges of Data to Dst, in order. Returns the number of elements copied.
+//
+CCBFsize_t CircBufCopyFromRanges(const void *Data, size_t ElemSize, CCBFsize_t (*p)[2][2], void *Dst, CCBFsize_t N, int Flags);
+
+//
+// Writer side: inserts up to N elements of Src in the ring (as many as there is room for), *p_n receives the number inserted.
+//
+// returns 0 if no error, CCBF_AGAIN if the ring is full (N > 0 and nothing inserted).
+//
+int CircBufCopyIn(CircBuf_t *p_circ, void *Data, size_t ElemSize, const void *Src, CCBFsize_t N, int Flags, CCBFsize_t *p_n);
+
+//
+// Reader side: removes up to N elements from the ring, copied to Dst, *p_n receives the number removed.
+//
+// returns 0 if no error, CCBF_AGAIN if the ring is empty (N > 0 and nothing removed).
+//
+int CircBufCopyOut(CircBuf_t *p_circ, const void *Data, size_t ElemSize, void *Dst, CCBFsize_t N, int Flags, CCBFsize_t *p_n);
+
+//
+// Moves up to N elements from the ring p_src (this thread is its reader) to the ring p_dst (this thread is its writer),
+// in at most three copies. *p_n receives the number moved.
+//
+// returns 0 if no error, CCBF_AGAIN if nothing could be moved (N > 0, p_src empty or p_dst full).
+//
+int CircBufCopyRing(CircBuf_t *p_src, const void *SrcData, CircBuf_t *p_dst, void *DstData, size_t ElemSize, CCBFsize_t N, int Flags, CCBFsize_t *p_n);
+
+//
+// Name of the non-temporal copy selected for this CPU: "avx512", "avx2", "sse2", or "memcpy".
+//
+const char *CircBufCopyKernel(void);
+
+//
+// Forces the non-temporal copy: "avx512", "avx2", "sse2" or "memcpy" (tests, comparisons).
+// Not while other threads copy.
+//
+// returns 0 if no error (the CPU has it).
+//
+int CircBufCopySetKernel(const char *Name);
+
+#endif // CIRC_BUF_COPY_H
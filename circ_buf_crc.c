@@ -0,0 +1,289 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ CRC-32C, reflected, polynomial 0x82F63B78. The registers below are the raw CRC (no inversion): the inversions
+ at the start and at the end are done once per call, by the public functions.
+
+ Multiplications modulo the polynomial are done as in zlib (crc32_combine): the bit 31 of a register is x^0, and
+ x^(2^k) mod P is tabulated, so that x^n mod P costs one multiplication per bit of n.
+
+ The three streams version: the data is cut in blocks of 3 * CCBF_CRC_BLOCK bytes, the crc32 instruction runs on the
+ three thirds at the same time (its latency is 3 cycles, but one can start every cycle), then the first two partial CRCs
+ are shifted over the rest with a carry-less multiplication by x^(8 * length - 33) mod P: the product, read as
+ 64 bits of data by the crc32 instruction, gets the last factor x^33.
+
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "circ_buf_crc.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define CCBF_CRC_POLY 0x82F63B78u
+
+// bytes per stream and per iteration of the three streams version
+#ifndef CCBF_CRC_BLOCK
+#define CCBF_CRC_BLOCK 512
+#endif
+
+typedef uint32_t (*CircBufCrcFn_t)(uint32_t crc, const uint8_t *p, size_t len);
+
+static uint32_t CircBufCrcTab[8][256];
+static uint32_t CircBufCrcX2n[64]; // x^(2^k) mod P
+static uint32_t CircBufCrcK1, CircBufCrcK2; // shifts of the three streams version, over 2 and 1 blocks
+
+static CircBufCrcFn_t CircBufCrcFn = NULL; // selected at the first use
+static const char *CircBufCrcName = "slice8";
+static pthread_once_t CircBufCrcOnce = PTHREAD_ONCE_INIT;
+
+// ==============================================================================
+
+// a * b mod P
+static uint32_t CircBufCrcMult(uint32_t a, uint32_t b)
+{
+uint32_t m = (uint32_t)1 << 31, p = 0;
+
+while(m != 0) {
+    if(a & m) {
+        p ^= b;
+        if((a & (m - 1)) == 0) break;
+        }
+    m >>= 1;
+    b = (b & 1) ? (b >> 1) ^ CCBF_CRC_POLY : b >> 1;
+   }
+return p;
+}
+
+// ==============================================================================
+
+// x^n mod P
+static uint32_t CircBufCrcXpow(uint64_t n)
+{
+uint32_t p = (uint32_t)1 << 31; // x^0
+int k = 0;
+
+while(n != 0) {
+    if(n & 1) p = CircBufCrcMult(CircBufCrcX2n[k], p);
+    n >>= 1;
+    k++;
+   }
+return p;
+}
+
+// ==============================================================================
+
+static uint32_t CircBufCrcSlice8Raw(uint32_t crc, const uint8_t *p, size_t len)
+{
+uint64_t w;
+
+while((len > 0) && ((uintptr_t)p & 7)) {
+    crc = CircBufCrcTab[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    len--;
+   }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+for(; len >= 8; len -= 8, p += 8) {
+    memcpy(&w, p, 8);
+    w ^= crc;
+    crc = CircBufCrcTab[7][w & 0xff]         ^ CircBufCrcTab[6][(w >> 8) & 0xff]  ^
+          CircBufCrcTab[5][(w >> 16) & 0xff] ^ CircBufCrcTab[4][(w >> 24) & 0xff] ^
+          CircBufCrcTab[3][(w >> 32) & 0xff] ^ CircBufCrcTab[2][(w >> 40) & 0xff] ^
+          CircBufCrcTab[1][(w >> 48) & 0xff] ^ CircBufCrcTab[0][w >> 56];
+   }
+#else
+(void)w;
+#endif
+while(len > 0) {
+    crc = CircBufCrcTab[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    len--;
+   }
+return crc;
+}
+
+#if defined(__x86_64__)
+
+// ==============================================================================
+
+__attribute__((target("sse4.2")))
+static uint32_t CircBufCrcSse42Raw(uint32_t crc, const uint8_t *p, size_t len)
+{
+uint64_t c = crc, w;
+
+while((len > 0) && ((uintptr_t)p & 7)) {
+    c = _mm_crc32_u8(c, *p++);
+    len--;
+   }
+for(; len >= 8; len -= 8, p += 8) {
+    memcpy(&w, p, 8);
+    c = _mm_crc32_u64(c, w);
+   }
+while(len > 0) {
+    c = _mm_crc32_u8(c, *p++);
+    len--;
+   }
+return c;
+}
+
+// ==============================================================================
+
+// crc * x^(8 * n) mod P, K = x^(8 * n - 33) mod P
+__attribute__((target("sse4.2,pclmul")))
+static inline uint64_t CircBufCrcShift(uint64_t crc, uint32_t K)
+{
+__m128i prod = _mm_clmulepi64_si128(_mm_cvtsi32_si128(crc), _mm_cvtsi32_si128(K), 0);
+return _mm_crc32_u64(0, _mm_cvtsi128_si64(prod));
+}
+
+// ==============================================================================
+
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t CircBufCrcPclmulRaw(uint32_t crc, const uint8_t *p, size_t len)
+{
+uint64_t c0 = crc, c1, c2, w0, w1, w2;
+size_t i;
+
+while((len > 0) && ((uintptr_t)p & 7)) {
+    c0 = _mm_crc32_u8(c0, *p++);
+    len--;
+   }
+for(; len >= 3 * CCBF_CRC_BLOCK; len -= 3 * CCBF_CRC_BLOCK, p += 3 * CCBF_CRC_BLOCK) {
+    c1 = c2 = 0;
+    for(i = 0; i < CCBF_CRC_BLOCK; i += 8) {
+        memcpy(&w0, p + i, 8);
+        memcpy(&w1, p + CCBF_CRC_BLOCK + i, 8);
+        memcpy(&w2, p + 2 * CCBF_CRC_BLOCK + i, 8);
+        c0 = _mm_crc32_u64(c0, w0);
+        c1 = _mm_crc32_u64(c1, w1);
+        c2 = _mm_crc32_u64(c2, w2);
+        }
+    c0 = CircBufCrcShift(c0, CircBufCrcK1) ^ CircBufCrcShift(c1, CircBufCrcK2) ^ c2;
+   }
+return CircBufCrcSse42Raw(c0, p, len);
+}
+
+#endif // __x86_64__
+
+// ==============================================================================
+
+//
+// tables and runtime dispatch, run once by pthread_once(): the other threads wait for the end,
+// and see the tables and the selected version complete.
+//
+static void CircBufCrcSelect(void)
+{
+uint32_t c;
+int n, k;
+
+for(n = 0; n < 256; n++) {
+    c = n;
+    for(k = 0; k < 8; k++) c = (c & 1) ? (c >> 1) ^ CCBF_CRC_POLY : c >> 1;
+    CircBufCrcTab[0][n] = c;
+   }
+for(n = 0; n < 256; n++) {
+    for(k = 1; k < 8; k++) CircBufCrcTab[k][n] = (CircBufCrcTab[k - 1][n] >> 8) ^ CircBufCrcTab[0][CircBufCrcTab[k - 1][n] & 0xff];
+   }
+CircBufCrcX2n[0] = (uint32_t)1 << 30; // x^1
+for(k = 1; k < 64; k++) CircBufCrcX2n[k] = CircBufCrcMult(CircBufCrcX2n[k - 1], CircBufCrcX2n[k - 1]);
+CircBufCrcK1 = CircBufCrcXpow(8 * 2 * CCBF_CRC_BLOCK - 33);
+CircBufCrcK2 = CircBufCrcXpow(8 * CCBF_CRC_BLOCK - 33);
+
+#if defined(__x86_64__)
+__builtin_cpu_init();
+if(__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul")) {
+    CircBufCrcName = "sse4.2+pclmul";
+    CircBufCrcFn = CircBufCrcPclmulRaw;
+    } else if(__builtin_cpu_supports("sse4.2")) {
+    CircBufCrcName = "sse4.2";
+    CircBufCrcFn = CircBufCrcSse42Raw;
+    } else {
+    CircBufCrcFn = CircBufCrcSlice8Raw;
+    }
+#else
+CircBufCrcFn = CircBufCrcSlice8Raw;
+#endif
+}
+
+// ==============================================================================
+
+int CircBufCrcSetKernel(const char *Name)
+{
+pthread_once(&CircBufCrcOnce, CircBufCrcSelect);
+if(Name == NULL) {
+    return __LINE__;
+    }
+#if defined(__x86_64__)
+if((strcmp(Name, "sse4.2+pclmul") == 0) && __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul")) {
+    CircBufCrcName = "sse4.2+pclmul";
+    CircBufCrcFn = CircBufCrcPclmulRaw;
+    return 0;
+    }
+if((strcmp(Name, "sse4.2") == 0) && __builtin_cpu_supports("sse4.2")) {
+    CircBufCrcName = "sse4.2";
+    CircBufCrcFn = CircBufCrcSse42Raw;
+    return 0;
+    }
+#endif
+if(strcmp(Name, "slice8") == 0) {
+    CircBufCrcName = "slice8";
+    CircBufCrcFn = CircBufCrcSlice8Raw;
+    return 0;
+    }
+return __LINE__;
+}
+
+// ==============================================================================
+
+uint32_t CircBufCrc32c(uint32_t crc, const void *buf, size_t len)
+{
+pthread_once(&CircBufCrcOnce, CircBufCrcSelect);
+return ~CircBufCrcFn(~crc, buf, len);
+}
+
+// ==============================================================================
+
+uint32_t CircBufCrc32cSlice8(uint32_t crc, const void *buf, size_t len)
+{
+pthread_once(&CircBufCrcOnce, CircBufCrcSelect);
+return ~CircBufCrcSlice8Raw(~crc, buf, len);
+}
+
+// ==============================================================================
+
+uint32_t CircBufCrc32cCombine(uint32_t crc1, uint32_t crc2, size_t len2)
+{
+pthread_once(&CircBufCrcOnce, CircBufCrcSelect);
+return CircBufCrcMult(CircBufCrcXpow(8 * (uint64_t)len2), crc1) ^ crc2;
+}
+
+// ==============================================================================
+
+uint32_t CircBufCrc32cRanges(uint32_t crc, const void *Data, size_t ElemSize, CCBFsize_t (*p)[2][2], CCBFsize_t N)
+{
+CCBFsize_t done = 0, sz;
+int m;
+
+for(m = 0; m < 2; m++) {
+    sz = CircBufSz(m, (*p));
+    if(sz > N - done) sz = N - done;
+    if(sz == 0) continue;
+    crc = CircBufCrc32c(crc, (const uint8_t *)Data + (size_t)(*p)[m][0] * ElemSize, (size_t)sz * ElemSize);
+    done += sz;
+   }
+return crc;
+}
+
+// ==============================================================================
+
+const char *CircBufCrcKernel(void)
+{
+pthread_once(&CircBufCrcOnce, CircBufCrcSelect);
+return CircBufCrcName;
+}
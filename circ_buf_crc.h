@@ -0,0 +1,64 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ CRC-32C (Castagnoli, the polynomial of iSCSI, ext4, SCTP...) for the data of a ring buffer.
+
+ Same use as crc32() of zlib: start with crc = 0, and pass the previous result to continue over the next bytes:
+ CircBufCrc32c(CircBufCrc32c(0, A, a), B, b) is the CRC of A followed by B.
+
+ The version is chosen at runtime (x86-64):
+   - "sse4.2+pclmul" : the crc32 instruction on three independent streams, merged with carry-less multiplications,
+   - "sse4.2"        : the crc32 instruction, 8 bytes at a time,
+   - "slice8"        : tables, 8 bytes at a time (everywhere else).
+
+ CircBufCrc32cCombine() gives the CRC of A followed by B from the CRC of A and the CRC of B alone, in O(log(length of B)):
+ the two segments of a ring, or the candidates of a parser, can be checked independently and merged afterwards.
+
+ */
+
+#ifndef CIRC_BUF_CRC_H
+#define CIRC_BUF_CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "circ_buf.h"
+
+
+//
+// CRC-32C of len bytes, continued from crc (0 for a new CRC)
+//
+uint32_t CircBufCrc32c(uint32_t crc, const void *buf, size_t len);
+
+//
+// CRC-32C of the sequence A, B from crc1 = CRC of A and crc2 = CRC of B, len2 = size of B in bytes
+//
+uint32_t CircBufCrc32cCombine(uint32_t crc1, uint32_t crc2, size_t len2);
+
+//
+// CRC-32C of the first N elements (ElemSize bytes each) of the ranges of Data (any index manager), across the wrap around,
+// continued from crc. N must not be larger than the number of elements in the ranges.
+//
+uint32_t CircBufCrc32cRanges(uint32_t crc, const void *Data, size_t ElemSize, CCBFsize_t (*p)[2][2], CCBFsize_t N);
+
+//
+// the portable version, always available (tests, comparisons)
+//
+uint32_t CircBufCrc32cSlice8(uint32_t crc, const void *buf, size_t len);
+
+//
+// Name of the version selected for this CPU: "sse4.2+pclmul", "sse4.2" or "slice8".
+//
+const char *CircBufCrcKernel(void);
+
+//
+// Forces the version: "sse4.2+pclmul", "sse4.2" or "slice8" (tests, comparisons). Not while other threads compute CRCs.
+//
+// returns 0 if no error (the CPU has it).
+//
+int CircBufCrcSetKernel(const char *Name);
+
+#endif // CIRC_BUF_CRC_H
@@ -0,0 +1,133 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Wmark is only meaningful when the writer has wrapped around and the reader has not yet:
+   - the writer sets it to the start of the padding when it skips the end of the buffer,
+   - and resets it to ElemInBuf as soon as a block goes past it (the reader is then behind it, in the lower part of the buffer).
+ In both cases Wmark is written before WrPos is published, so the reader always gets the value that matches the WrPos it reads.
+
+ */
+
+#include <stddef.h>
+#include "circ_buf_ctg.h"
+
+// ==============================================================================
+
+// SizeOfBuf : in elements (NOT bytes!) must be >= 2
+int CircBufCtgInit(CircBufCtg_t *p_circ, CCBFsize_t SizeOfBuf)
+{
+int ret;
+if(p_circ == NULL){
+    return __LINE__;
+    }
+ret = CircBufInit(CIRCBUF(&(p_circ -> Ring)), SizeOfBuf);
+if(ret != 0) {
+    return ret;
+    }
+CCBF_STORE_RLX(p_circ -> Wmark, SizeOfBuf);
+p_circ -> WrLen = 0;
+p_circ -> WrSkip = 0;
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufCtgWrReserve(CircBufCtg_t *p_circ, CCBFsize_t Nelem, CCBFsize_t *p_start)
+{
+CCBFsize_t Rd, Wr, Free, Tail;
+
+if((p_circ == NULL) || (p_start == NULL)){
+    return __LINE__;
+    }
+p_circ -> WrLen = 0;
+p_circ -> WrSkip = 0;
+if((Nelem == 0) || (Nelem > p_circ -> Ring.ElemInBuf - 1)) {
+    return __LINE__; // could never be satisfied
+    }
+
+Rd = CCBF_LOAD_ACQ(p_circ -> Ring.RdPos); // owned by the reader: the reader must be done with the data before we overwrite it
+Wr = CCBF_LOAD_RLX(p_circ -> Ring.WrPos); // our own index
+Free = CircBufFreeCount(Rd, Wr, p_circ -> Ring.ElemInBuf);
+Tail = p_circ -> Ring.ElemInBuf - Wr; // up to the end of the buffer
+
+if((Free >= Nelem) && (Tail >= Nelem)) {
+    *p_start = Wr;
+} else if((Free > Tail) && (Free - Tail >= Nelem)) {
+    *p_start = 0; // skip the end of the buffer
+    p_circ -> WrSkip = Tail;
+} else {
+    return CCBF_AGAIN; // not enough contiguous space: wait for the reader
+}
+p_circ -> WrLen = Nelem;
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufCtgUpdtWr(CircBufCtg_t *p_circ, CCBFsize_t Nelem)
+{
+CCBFsize_t Wr;
+
+if(p_circ == NULL){
+    return __LINE__;
+    }
+if(Nelem > p_circ -> WrLen) {
+    return __LINE__; // more than reserved
+    }
+p_circ -> WrLen = 0;
+if(Nelem == 0) {
+    return 0; // cancelled: the skipped space (if any) is kept
+    }
+
+Wr = CCBF_LOAD_RLX(p_circ -> Ring.WrPos);
+if(p_circ -> WrSkip > 0) {
+    CCBF_STORE_RLX(p_circ -> Wmark, Wr); // the padding starts here
+} else if(Wr + Nelem > CCBF_LOAD_RLX(p_circ -> Wmark)) {
+    CCBF_STORE_RLX(p_circ -> Wmark, p_circ -> Ring.ElemInBuf); // the reader is past the old padding
+}
+// the padding is committed along with the data: the release store of WrPos publishes Wmark too
+return CircBufUpdtWr(CIRCBUF(&(p_circ -> Ring)), p_circ -> WrSkip + Nelem);
+}
+
+// ==============================================================================
+
+CCBFsize_t CircBufCtgRdBlock(CircBufCtg_t *p_circ, CCBFsize_t *p_start)
+{
+CCBFsize_t Rd, Wr, Used, Tail, Wmark;
+
+Rd = CCBF_LOAD_RLX(p_circ -> Ring.RdPos); // our own index
+Wr = CCBF_LOAD_ACQ(p_circ -> Ring.WrPos); // owned by the writer: the data (and Wmark) must be visible before we read them
+Used = CircBufUsedCount(Rd, Wr, p_circ -> Ring.ElemInBuf);
+Tail = p_circ -> Ring.ElemInBuf - Rd; // up to the end of the buffer
+
+if(Used < Tail) {
+    *p_start = Rd; // the writer has not wrapped around: no padding
+    return Used;
+    }
+
+// the data go up to the end of the buffer, or wrap around
+Wmark = CCBF_LOAD_RLX(p_circ -> Wmark);
+if(Rd < Wmark) {
+    *p_start = Rd;
+    return Wmark - Rd;
+    }
+
+// only padding is left at the end of the buffer: give it back to the writer, and go on from index 0
+CCBF_STORE_REL(p_circ -> Ring.RdPos, 0);
+*p_start = 0;
+return Used - Tail;
+}
+
+// ==============================================================================
+
+int CircBufCtgUpdtRd(CircBufCtg_t *p_circ, CCBFsize_t Nconsumed)
+{
+if(p_circ == NULL){
+    return __LINE__;
+    }
+return CircBufUpdtRd(CIRCBUF(&(p_circ -> Ring)), Nconsumed);
+}
@@ -0,0 +1,71 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Contiguous reservations (DMA style), on top of CircBuf_t.
+
+ The writer asks for N contiguous elements: if they don't fit in the space left at the end of the buffer,
+ that space is skipped and the block starts at index 0. The skipped tail is remembered here (Wmark),
+ and the reader gets the committed data as contiguous blocks, the padding being skipped automatically.
+ No second ring is needed to remember where the blocks start (compare Example_2/02_ex_DMA.c and 02_ex_DMA_ctg.c).
+
+ One writer, one reader, as with CircBuf_t.
+
+ */
+
+#ifndef CIRC_BUF_CTG_H
+#define CIRC_BUF_CTG_H
+
+#include "circ_buf.h"
+
+typedef struct CircBufCtg_str
+{
+  CircBuf_t Ring; // the usual index manager. The padding at the end of the buffer counts as data written.
+
+  // end of the data at the end of the buffer: [Wmark, ElemInBuf) is padding once the writer has wrapped around.
+  // Written by the writer before it publishes WrPos, read by the reader.
+  CCBFvolsize_t Wmark;
+
+  // last reservation. Only used by the writer.
+  CCBFsize_t WrLen; // number of elements reserved
+  CCBFsize_t WrSkip; // number of elements skipped at the end of the buffer
+
+} CircBufCtg_t;
+
+#define CIRCBUFCTG(x) ((CircBufCtg_t *)x)
+
+
+// SizeOfBuf : in elements (NOT bytes!) must be >= 2
+int CircBufCtgInit(CircBufCtg_t *p_circ, CCBFsize_t SizeOfBuf);
+
+//
+// Reserves Nelem contiguous elements for writing, starting at index *p_start.
+// Nelem must be <= SizeOfBuf - 1, and the largest block that can always be reserved once the reader has caught up is (SizeOfBuf - 1) / 2.
+//
+// returns 0 if the elements have been reserved, CCBF_AGAIN if there is not enough contiguous space (nothing reserved), an error code (> 0) otherwise.
+//
+int CircBufCtgWrReserve(CircBufCtg_t *p_circ, CCBFsize_t Nelem, CCBFsize_t *p_start);
+
+//
+// Commits the Nelem first elements of the last reservation (Nelem <= reserved), and the skipped space if any.
+// Committing 0 elements cancels the reservation.
+//
+int CircBufCtgUpdtWr(CircBufCtg_t *p_circ, CCBFsize_t Nelem);
+
+//
+// Next contiguous block of committed data: *p_start receives its first index, and the number of elements is returned (0: nothing to read).
+// Several blocks committed one after the other may be returned at once.
+// The padding left by the writer at the end of the buffer is skipped here.
+// Note: p_circ is not checked here.
+//
+CCBFsize_t CircBufCtgRdBlock(CircBufCtg_t *p_circ, CCBFsize_t *p_start);
+
+//
+// Updates the buffer as Nconsumed items of the block have been read
+//
+int CircBufCtgUpdtRd(CircBufCtg_t *p_circ, CCBFsize_t Nconsumed);
+
+#endif // CIRC_BUF_CTG_H
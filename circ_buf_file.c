@@ -0,0 +1,302 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "circ_buf_file.h"
+
+// ==============================================================================
+
+static int64_t CircBufFileNow(void)
+{
+struct timespec ts;
+clock_gettime(CLOCK_MONOTONIC, &ts);
+return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// ==============================================================================
+
+//
+// identifier of the current boot, "" if not available (then every opening is considered as a reboot)
+//
+static void CircBufFileBootId(char BootId[40])
+{
+ssize_t n = 0;
+int fd = open("/proc/sys/kernel/random/boot_id", O_RDONLY | O_CLOEXEC);
+memset(BootId, 0, 40);
+if(fd >= 0) {
+    n = read(fd, BootId, 39);
+    close(fd);
+    }
+if(n <= 0) {
+    BootId[0] = 0;
+    }
+}
+
+// ==============================================================================
+
+//
+// indexes to restart from, in *p_Rd, *p_Wr. returns the origin.
+//
+static int CircBufFileRecover(CircBufFileHdr_t *p_hdr, CCBFsize_t *p_Rd, CCBFsize_t *p_Wr)
+{
+char BootId[40];
+CCBFsize_t N = p_hdr -> Ring.ElemInBuf;
+CCBFsize_t Rd = CCBF_LOAD_RLX(p_hdr -> Ring.RdPos);
+CCBFsize_t Wr = CCBF_LOAD_RLX(p_hdr -> Ring.WrPos);
+
+CircBufFileBootId(BootId);
+if((BootId[0] != 0) && (memcmp(BootId, p_hdr -> BootId, 40) == 0) && (Rd < N) && (Wr < N)) {
+    *p_Rd = Rd;
+    *p_Wr = Wr;
+    return CCBF_FILE_LIVE;
+    }
+if((p_hdr -> CkRdPos < N) && (p_hdr -> CkWrPos < N)) {
+    *p_Rd = p_hdr -> CkRdPos;
+    *p_Wr = p_hdr -> CkWrPos;
+    } else {
+    *p_Rd = 0; // corrupted: empty
+    *p_Wr = 0;
+    }
+return CCBF_FILE_CHECKPOINT;
+}
+
+// ==============================================================================
+
+int CircBufFileOpen(CircBufFile_t *p_file, const char *Path, CCBFsize_t SizeOfBuf, size_t ElemSize, int Flags)
+{
+CircBufFileHdr_t *p_hdr;
+struct stat st;
+int RdOnly = (Flags & CCBF_FILE_RDONLY) != 0;
+int New;
+size_t Size;
+int err;
+
+if((p_file == NULL) || (Path == NULL)) {
+    return __LINE__;
+    }
+memset(p_file, 0, sizeof(*p_file));
+p_file -> Flags = Flags;
+p_file -> Fd = open(Path, RdOnly ? (O_RDONLY | O_CLOEXEC) : (O_RDWR | O_CREAT | O_CLOEXEC), 0644);
+if(p_file -> Fd < 0) {
+    return __LINE__;
+    }
+if(fstat(p_file -> Fd, &st) != 0) {
+    err = __LINE__;
+    close(p_file -> Fd);
+    return err;
+    }
+
+New = (st.st_size == 0);
+if(New) {
+    if(RdOnly || (SizeOfBuf < 2) || (ElemSize == 0) || (ElemSize > (SIZE_MAX - CCBF_FILE_DATA_OFF) / SizeOfBuf)) {
+        close(p_file -> Fd);
+        return __LINE__;
+        }
+    Size = CCBF_FILE_DATA_OFF + (size_t)SizeOfBuf * ElemSize;
+    if(ftruncate(p_file -> Fd, Size) != 0) {
+        close(p_file -> Fd);
+        return __LINE__;
+        }
+    } else {
+    Size = st.st_size;
+    if(Size < CCBF_FILE_DATA_OFF) {
+        close(p_file -> Fd);
+        return __LINE__;
+        }
+    }
+
+p_hdr = mmap(NULL, Size, RdOnly ? PROT_READ : (PROT_READ | PROT_WRITE), MAP_SHARED, p_file -> Fd, 0);
+if(p_hdr == MAP_FAILED) {
+    close(p_file -> Fd);
+    return __LINE__;
+    }
+p_file -> p_Hdr = p_hdr;
+p_file -> MapSize = Size;
+
+if(New) {
+    p_hdr -> Version = CCBF_FILE_VERSION;
+    p_hdr -> HdrSize = sizeof(CircBufFileHdr_t);
+    p_hdr -> IndexSize = sizeof(CCBFsize_t);
+    p_hdr -> ElemSize = ElemSize;
+    p_hdr -> DataOff = CCBF_FILE_DATA_OFF;
+    CircBufInit(&(p_hdr -> Ring), SizeOfBuf);
+    p_hdr -> CkRdPos = 0;
+    p_hdr -> CkWrPos = 0;
+    p_hdr -> Magic = CCBF_FILE_MAGIC; // last: a file without it is not a ring
+    p_file -> Origin = CCBF_FILE_NEW;
+    } else {
+    err = 0;
+    if((p_hdr -> Magic != CCBF_FILE_MAGIC) || (p_hdr -> Version != CCBF_FILE_VERSION) ||
+       (p_hdr -> HdrSize != sizeof(CircBufFileHdr_t)) || (p_hdr -> IndexSize != sizeof(CCBFsize_t))) {
+        err = __LINE__;
+        } else if((p_hdr -> DataOff != CCBF_FILE_DATA_OFF) || (p_hdr -> Ring.ElemInBuf < 2) || (p_hdr -> ElemSize == 0) ||
+                  (Size != CCBF_FILE_DATA_OFF + (uint64_t)p_hdr -> Ring.ElemInBuf * p_hdr -> ElemSize)) {
+        err = __LINE__;
+        } else if(((SizeOfBuf != 0) && (SizeOfBuf != p_hdr -> Ring.ElemInBuf)) || ((ElemSize != 0) && (ElemSize != p_hdr -> ElemSize))) {
+        err = __LINE__; // not the expected ring
+        }
+    if(err != 0) {
+        munmap(p_hdr, Size);
+        close(p_file -> Fd);
+        return err;
+        }
+    p_file -> Origin = CircBufFileRecover(p_hdr, &(p_file -> RdPos0), &(p_file -> WrPos0));
+    }
+
+p_file -> p_Ring = &(p_hdr -> Ring);
+p_file -> Data = (uint8_t *)p_hdr + CCBF_FILE_DATA_OFF;
+p_file -> ElemSize = p_hdr -> ElemSize;
+p_file -> LastSyncNs = CircBufFileNow();
+
+if(!RdOnly) {
+    // from now on, the live indexes are the ones of this boot:
+    CCBF_STORE_RLX(p_hdr -> Ring.RdPos, p_file -> RdPos0);
+    CCBF_STORE_RLX(p_hdr -> Ring.WrPos, p_file -> WrPos0);
+    CircBufFileBootId(p_hdr -> BootId);
+    if((err = CircBufFileSync(p_file)) != 0) {
+        munmap(p_hdr, Size);
+        close(p_file -> Fd);
+        return err;
+        }
+    }
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufFileSyncPolicy(CircBufFile_t *p_file, CCBFsize_t SyncEvery, int64_t PeriodNs)
+{
+if((p_file == NULL) || (PeriodNs < 0)) {
+    return __LINE__;
+    }
+p_file -> SyncEvery = SyncEvery;
+p_file -> SyncPeriodNs = PeriodNs;
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufFileAppend(CircBufFile_t *p_file, const void *Elems, CCBFsize_t N)
+{
+CircBufFileHdr_t *p_hdr;
+CCBFsize_t IndTab[2][2], Free, Drop, Rd, Sz0;
+size_t ElemSize;
+int err;
+
+if((p_file == NULL) || (p_file -> p_Hdr == NULL) || (Elems == NULL) || (p_file -> Flags & CCBF_FILE_RDONLY)) {
+    return __LINE__;
+    }
+p_hdr = p_file -> p_Hdr;
+if(N >= p_hdr -> Ring.ElemInBuf) {
+    return __LINE__;
+    }
+if(N == 0) {
+    return 0;
+    }
+ElemSize = p_file -> ElemSize;
+
+// room for the new elements: drop the oldest ones BEFORE overwriting them
+Free = CircBufAvailWr(p_file -> p_Ring);
+if(Free < N) {
+    Drop = N - Free;
+    Rd = CCBF_LOAD_RLX(p_hdr -> Ring.RdPos);
+    // the checkpoint no longer covers the elements dropped (best effort: see circ_buf_file.h)
+    if(CircBufUsedCount(Rd, p_hdr -> CkWrPos, p_hdr -> Ring.ElemInBuf) <= Drop) {
+        p_hdr -> CkRdPos = p_hdr -> CkWrPos = (Rd + Drop) % p_hdr -> Ring.ElemInBuf;
+        } else if(CircBufUsedCount(Rd, p_hdr -> CkRdPos, p_hdr -> Ring.ElemInBuf) < Drop) {
+        p_hdr -> CkRdPos = (Rd + Drop) % p_hdr -> Ring.ElemInBuf;
+        }
+    if((err = CircBufUpdtRd(p_file -> p_Ring, Drop)) != 0) {
+        return err;
+        }
+    }
+
+if((err = CircBufWrInd(p_file -> p_Ring, &IndTab)) != 0) {
+    return err;
+    }
+Sz0 = CircBufSz(0, IndTab);
+if(Sz0 >= N) {
+    memcpy(p_file -> Data + (size_t)IndTab[0][0] * ElemSize, Elems, (size_t)N * ElemSize);
+    } else {
+    if(Sz0 > 0) {
+        memcpy(p_file -> Data + (size_t)IndTab[0][0] * ElemSize, Elems, (size_t)Sz0 * ElemSize);
+        }
+    memcpy(p_file -> Data + (size_t)IndTab[1][0] * ElemSize, (const uint8_t *)Elems + (size_t)Sz0 * ElemSize, (size_t)(N - Sz0) * ElemSize);
+    }
+if((err = CircBufUpdtWr(p_file -> p_Ring, N)) != 0) { // AFTER the data
+    return err;
+    }
+
+// sync policy:
+p_file -> Nunsynced += N;
+if((p_file -> SyncEvery != 0) && (p_file -> Nunsynced >= p_file -> SyncEvery)) {
+    return CircBufFileSync(p_file);
+    }
+if((p_file -> SyncPeriodNs != 0) && (CircBufFileNow() - p_file -> LastSyncNs >= p_file -> SyncPeriodNs)) {
+    return CircBufFileSync(p_file);
+    }
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufFileSync(CircBufFile_t *p_file)
+{
+CircBufFileHdr_t *p_hdr;
+CCBFsize_t Rd, Wr;
+
+if((p_file == NULL) || (p_file -> p_Hdr == NULL) || (p_file -> Flags & CCBF_FILE_RDONLY)) {
+    return __LINE__;
+    }
+p_hdr = p_file -> p_Hdr;
+Rd = CCBF_LOAD_RLX(p_hdr -> Ring.RdPos);
+Wr = CCBF_LOAD_RLX(p_hdr -> Ring.WrPos);
+
+// the data first (only the dirty pages are written), then the indexes that cover it:
+if(msync(p_file -> Data, p_file -> MapSize - CCBF_FILE_DATA_OFF, MS_SYNC) != 0) {
+    return __LINE__;
+    }
+p_hdr -> CkRdPos = Rd;
+p_hdr -> CkWrPos = Wr;
+p_hdr -> Nsync++;
+if(msync(p_hdr, CCBF_FILE_DATA_OFF, MS_SYNC) != 0) {
+    return __LINE__;
+    }
+p_file -> Nunsynced = 0;
+p_file -> LastSyncNs = CircBufFileNow();
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufFileClose(CircBufFile_t *p_file)
+{
+int err = 0;
+if((p_file == NULL) || (p_file -> p_Hdr == NULL)) {
+    return __LINE__;
+    }
+if(!(p_file -> Flags & CCBF_FILE_RDONLY)) {
+    err = CircBufFileSync(p_file);
+    }
+if(munmap(p_file -> p_Hdr, p_file -> MapSize) != 0) {
+    err = __LINE__;
+    }
+close(p_file -> Fd);
+p_file -> p_Hdr = NULL;
+p_file -> p_Ring = NULL;
+p_file -> Data = NULL;
+p_file -> Fd = -1;
+return err;
+}
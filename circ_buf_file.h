@@ -0,0 +1,118 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Persistent ring (flight recorder): the CircBuf_t and its data buffer live in a file mapped in memory (Linux).
+
+ The writer appends fixed size elements, dropping the oldest ones when the ring is full. There is no system call
+ on this path: the data and the indexes are written to the page cache through the mapping, and survive a crash of the process.
+ The indexes are updated in an order that keeps [RdPos, WrPos) consistent at any time:
+   - RdPos is moved forward BEFORE the oldest elements are overwritten,
+   - WrPos is moved forward AFTER the new elements are written.
+ So reopening the file after a crash of the process gives the elements committed before the crash.
+
+ A crash of the system (power loss...) may lose what is still in the page cache only. CircBufFileSync() writes the data to the disk,
+ then a copy of the indexes (checkpoint). The header records the boot of the indexes: reopened after a reboot,
+ the ring restarts from the checkpoint. The sync policy calls it automatically, every N elements and/or every T ns.
+ The oldest elements of a checkpoint may be overwritten by newer ones before the next checkpoint: after a reboot,
+ the data of the checkpoint is only guaranteed for the elements that were not dropped since.
+
+ One writer. The file can be read after the fact with Tools/ccbf_dump, or opened with CCBF_FILE_RDONLY.
+
+ */
+
+#ifndef CIRC_BUF_FILE_H
+#define CIRC_BUF_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "circ_buf.h"
+
+#define CCBF_FILE_MAGIC 0x52464343u // "CCFR"
+#define CCBF_FILE_VERSION 1
+#define CCBF_FILE_DATA_OFF 4096 // the header has its own page: msync() granularity
+
+// flags of CircBufFileOpen()
+#define CCBF_FILE_RDONLY 1 // no modification of the file (dump)
+
+// how the indexes were found at opening: Origin member
+#define CCBF_FILE_NEW        0 // new file
+#define CCBF_FILE_LIVE       1 // indexes of the last process (same boot: the page cache has everything)
+#define CCBF_FILE_CHECKPOINT 2 // indexes of the last checkpoint (reboot, or invalid indexes)
+
+// start of the file
+typedef struct CircBufFileHdr_str
+{
+  uint32_t Magic; // CCBF_FILE_MAGIC, written last when the file is created
+  uint32_t Version; // CCBF_FILE_VERSION
+  uint32_t HdrSize; // sizeof(CircBufFileHdr_t)
+  uint32_t IndexSize; // sizeof(CCBFsize_t)
+  uint64_t ElemSize; // bytes
+  uint64_t DataOff; // offset of the data buffer
+  char BootId[40]; // boot during which Ring was last written
+  CircBuf_t Ring; // live indexes
+  CCBFsize_t CkRdPos; // checkpoint: the data of [CkRdPos, CkWrPos) was on the disk before these indexes
+  CCBFsize_t CkWrPos;
+  uint64_t Nsync; // number of checkpoints
+} CircBufFileHdr_t;
+
+// handle, local to the process
+typedef struct CircBufFile_str
+{
+  CircBufFileHdr_t *p_Hdr; // the mapping
+  CircBuf_t *p_Ring; // &p_Hdr -> Ring: the usual index manager (read-only files: don't use)
+  uint8_t *Data; // data buffer, in the mapping
+  size_t ElemSize;
+  size_t MapSize;
+  int Fd;
+  int Flags;
+
+  int Origin; // CCBF_FILE_NEW, CCBF_FILE_LIVE or CCBF_FILE_CHECKPOINT
+  CCBFsize_t RdPos0, WrPos0; // indexes found at opening (after recovery)
+
+  // sync policy:
+  CCBFsize_t SyncEvery; // elements, 0 : not used
+  int64_t SyncPeriodNs; // 0 : not used
+  CCBFsize_t Nunsynced; // elements appended since the last checkpoint
+  int64_t LastSyncNs; // CLOCK_MONOTONIC
+
+} CircBufFile_t;
+
+#define CIRCBUFFILE(x) ((CircBufFile_t *)x)
+
+
+//
+// Opens the file, or creates it with SizeOfBuf elements (>= 2) of ElemSize bytes.
+// For an existing file, SizeOfBuf and ElemSize must be its own ones, or 0 to accept them.
+// Recovers the indexes (see the top of this file): Origin tells where they come from.
+//
+// returns 0 if no error.
+//
+int CircBufFileOpen(CircBufFile_t *p_file, const char *Path, CCBFsize_t SizeOfBuf, size_t ElemSize, int Flags);
+
+//
+// Sync policy: a checkpoint every SyncEvery elements appended, and/or when PeriodNs elapsed at the next append. 0 : disabled.
+//
+int CircBufFileSyncPolicy(CircBufFile_t *p_file, CCBFsize_t SyncEvery, int64_t PeriodNs);
+
+//
+// Appends N elements (N < SizeOfBuf), dropping the oldest ones if needed. Applies the sync policy.
+//
+// returns 0 if no error.
+//
+int CircBufFileAppend(CircBufFile_t *p_file, const void *Elems, CCBFsize_t N);
+
+//
+// Checkpoint: writes the data to the disk, then the indexes.
+//
+int CircBufFileSync(CircBufFile_t *p_file);
+
+//
+// Checkpoint (unless read-only), and unmaps the file.
+//
+int CircBufFileClose(CircBufFile_t *p_file);
+
+#endif // CIRC_BUF_FILE_H
@@ -0,0 +1,192 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include "circ_buf_iov.h"
+
+// ==============================================================================
+
+//
+// the ranges returned by CircBufWrInd() / CircBufRdInd() as iovecs, skipping the empty ones
+//
+static int CircBufIndToIov(CCBFsize_t (*p)[2][2], uint8_t *Data, size_t ElemSize, struct iovec iov[2])
+{
+int y, cnt = 0;
+for(y = 0; y < 2; y++) {
+    if(CircBufSz(y, (*p)) > 0) {
+        iov[cnt].iov_base = Data + (size_t)(*p)[y][0] * ElemSize;
+        iov[cnt].iov_len = (size_t)CircBufSz(y, (*p)) * ElemSize;
+        cnt++;
+        }
+    }
+return cnt;
+}
+
+// ==============================================================================
+
+int CircBufWrIov(CircBuf_t *p_circ, void *Data, size_t ElemSize, struct iovec iov[2], int *p_iovcnt)
+{
+CCBFsize_t IndTab[2][2];
+int err;
+if((Data == NULL) || (ElemSize == 0) || (iov == NULL) || (p_iovcnt == NULL)) {
+    return __LINE__;
+    }
+if((err = CircBufWrInd(p_circ, &IndTab)) != 0) {
+    return err;
+    }
+*p_iovcnt = CircBufIndToIov(&IndTab, Data, ElemSize, iov);
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufRdIov(CircBuf_t *p_circ, void *Data, size_t ElemSize, struct iovec iov[2], int *p_iovcnt)
+{
+CCBFsize_t IndTab[2][2];
+int err;
+if((Data == NULL) || (ElemSize == 0) || (iov == NULL) || (p_iovcnt == NULL)) {
+    return __LINE__;
+    }
+if((err = CircBufRdInd(p_circ, &IndTab)) != 0) {
+    return err;
+    }
+*p_iovcnt = CircBufIndToIov(&IndTab, Data, ElemSize, iov);
+return 0;
+}
+
+// ==============================================================================
+
+//
+// result of a system call: 0 / CCBF_AGAIN / __LINE__ of the caller, see circ_buf_iov.h
+//
+static int CircBufIovRet(ssize_t ret, size_t *p_n, int Line)
+{
+if(ret >= 0) {
+    *p_n = ret;
+    return 0;
+    }
+*p_n = 0;
+if((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+    return CCBF_AGAIN;
+    }
+return Line;
+}
+
+// ==============================================================================
+
+int CircBufReadv(CircBuf_t *p_circ, uint8_t *Data, int fd, size_t *p_n)
+{
+struct iovec iov[2];
+int cnt, err;
+if(p_n == NULL) {
+    return __LINE__;
+    }
+*p_n = 0;
+if((err = CircBufWrIov(p_circ, Data, 1, iov, &cnt)) != 0) {
+    return err;
+    }
+if(cnt == 0) {
+    return CCBF_AGAIN; // full
+    }
+if((err = CircBufIovRet(readv(fd, iov, cnt), p_n, __LINE__)) != 0) {
+    return err;
+    }
+return (CircBufUpdtWr(p_circ, *p_n) == 0) ? 0 : __LINE__;
+}
+
+// ==============================================================================
+
+int CircBufWritev(CircBuf_t *p_circ, uint8_t *Data, int fd, size_t *p_n)
+{
+struct iovec iov[2];
+int cnt, err;
+if(p_n == NULL) {
+    return __LINE__;
+    }
+*p_n = 0;
+if((err = CircBufRdIov(p_circ, Data, 1, iov, &cnt)) != 0) {
+    return err;
+    }
+if(cnt == 0) {
+    return CCBF_AGAIN; // empty
+    }
+if((err = CircBufIovRet(writev(fd, iov, cnt), p_n, __LINE__)) != 0) {
+    return err;
+    }
+return (CircBufUpdtRd(p_circ, *p_n) == 0) ? 0 : __LINE__;
+}
+
+// ==============================================================================
+
+int CircBufRecvmsg(CircBuf_t *p_circ, uint8_t *Data, int fd, struct msghdr *p_msg, int Flags, size_t *p_n)
+{
+struct iovec iov[2];
+struct msghdr msg;
+int cnt, err;
+if(p_n == NULL) {
+    return __LINE__;
+    }
+*p_n = 0;
+if((err = CircBufWrIov(p_circ, Data, 1, iov, &cnt)) != 0) {
+    return err;
+    }
+if(cnt == 0) {
+    return CCBF_AGAIN; // full
+    }
+if(p_msg != NULL) {
+    msg = *p_msg;
+    } else {
+    memset(&msg, 0, sizeof(msg));
+    }
+msg.msg_iov = iov; // local: not given back to the caller
+msg.msg_iovlen = cnt;
+if((err = CircBufIovRet(recvmsg(fd, &msg, Flags), p_n, __LINE__)) != 0) {
+    return err;
+    }
+if(p_msg != NULL) {
+    p_msg -> msg_namelen = msg.msg_namelen;
+    p_msg -> msg_controllen = msg.msg_controllen;
+    p_msg -> msg_flags = msg.msg_flags; // MSG_TRUNC: the datagram did not fit in the free space, the rest is lost
+    }
+return (CircBufUpdtWr(p_circ, *p_n) == 0) ? 0 : __LINE__;
+}
+
+// ==============================================================================
+
+int CircBufSendmsg(CircBuf_t *p_circ, uint8_t *Data, int fd, const struct msghdr *p_msg, int Flags, size_t *p_n)
+{
+struct iovec iov[2];
+struct msghdr msg;
+int cnt, err;
+if(p_n == NULL) {
+    return __LINE__;
+    }
+*p_n = 0;
+if((err = CircBufRdIov(p_circ, Data, 1, iov, &cnt)) != 0) {
+    return err;
+    }
+if(cnt == 0) {
+    return CCBF_AGAIN; // empty
+    }
+if(p_msg != NULL) {
+    msg = *p_msg;
+    } else {
+    memset(&msg, 0, sizeof(msg));
+    }
+msg.msg_iov = iov;
+msg.msg_iovlen = cnt;
+if((err = CircBufIovRet(sendmsg(fd, &msg, Flags), p_n, __LINE__)) != 0) {
+    return err;
+    }
+return (CircBufUpdtRd(p_circ, *p_n) == 0) ? 0 : __LINE__;
+}
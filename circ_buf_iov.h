@@ -0,0 +1,57 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ iovec bridge (POSIX): the ranges of CircBufWrInd() / CircBufRdInd() as a struct iovec[2], and
+ readv() / writev() / recvmsg() / sendmsg() straight into / out of the ring.
+
+ The data is transferred directly between the kernel and the ring memory, in one system call even when the region wraps around,
+ and the index is updated with the number of bytes transferred.
+
+ CircBufWrIov() / CircBufRdIov() take the size of the elements. The I/O wrappers work on rings of bytes (1 element = 1 byte):
+ a stream socket or a pipe may transfer any number of bytes, that could end in the middle of an element.
+
+ Return value of the I/O wrappers:
+   0           : *p_n bytes transferred. For CircBufReadv() / CircBufRecvmsg(), 0 bytes means end of file (or empty datagram).
+   CCBF_AGAIN  : nothing transferred: the ring is full (resp. empty), or the call would block (EAGAIN), or was interrupted (EINTR).
+   other (> 0) : error, errno is set by the system call.
+
+ */
+
+#ifndef CIRC_BUF_IOV_H
+#define CIRC_BUF_IOV_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include "circ_buf.h"
+
+//
+// Fills iov with the free (resp. used) region of the ring, in order, Data being the first element of the buffer.
+// *p_iovcnt receives the number of entries used: 0 (ring full, resp. empty), 1 or 2.
+//
+// returns 0 if no error.
+//
+int CircBufWrIov(CircBuf_t *p_circ, void *Data, size_t ElemSize, struct iovec iov[2], int *p_iovcnt);
+int CircBufRdIov(CircBuf_t *p_circ, void *Data, size_t ElemSize, struct iovec iov[2], int *p_iovcnt);
+
+//
+// readv() (resp. writev()) into the free space (resp. from the data) of a ring of bytes, then CircBufUpdtWr() (resp. CircBufUpdtRd()).
+// One writer thread calls CircBufReadv(), one reader thread calls CircBufWritev().
+//
+int CircBufReadv(CircBuf_t *p_circ, uint8_t *Data, int fd, size_t *p_n);
+int CircBufWritev(CircBuf_t *p_circ, uint8_t *Data, int fd, size_t *p_n);
+
+//
+// Same with recvmsg() / sendmsg(), for the flags (MSG_DONTWAIT...) and the ancillary data.
+// p_msg may be NULL. Otherwise its name and control fields are used as usual, its iov fields are ignored,
+// and msg_namelen, msg_controllen and msg_flags are updated by CircBufRecvmsg().
+//
+int CircBufRecvmsg(CircBuf_t *p_circ, uint8_t *Data, int fd, struct msghdr *p_msg, int Flags, size_t *p_n);
+int CircBufSendmsg(CircBuf_t *p_circ, uint8_t *Data, int fd, const struct msghdr *p_msg, int Flags, size_t *p_n);
+
+#endif // CIRC_BUF_IOV_H
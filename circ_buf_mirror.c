@@ -0,0 +1,111 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+ */
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "circ_buf_mirror.h"
+
+// ==============================================================================
+
+CCBFsize_t CircBufMirrorElemMultiple(size_t ElemSize)
+{
+size_t a = sysconf(_SC_PAGESIZE), b = ElemSize, t;
+if(ElemSize == 0) {
+    return 0;
+    }
+// page size / gcd(page size, ElemSize)
+while(b != 0) {
+    t = a % b;
+    a = b;
+    b = t;
+   }
+return sysconf(_SC_PAGESIZE) / a;
+}
+
+// ==============================================================================
+
+int CircBufMirrorAlloc(CircBufMirror_t *p_mirror, CCBFsize_t ElemInBuf, size_t ElemSize)
+{
+size_t Size;
+int fd;
+uint8_t *base;
+
+if(p_mirror == NULL){
+    return __LINE__;
+    }
+p_mirror -> Data = NULL;
+p_mirror -> Size = 0;
+if((ElemInBuf == 0) || (ElemSize == 0)) {
+    return __LINE__;
+    }
+if(ElemInBuf > SIZE_MAX / 2 / ElemSize) {
+    return __LINE__; // overflow
+    }
+Size = (size_t)ElemInBuf * ElemSize;
+if((Size % sysconf(_SC_PAGESIZE)) != 0) {
+    return __LINE__; // see CircBufMirrorElemMultiple()
+    }
+
+fd = memfd_create("circ_buf_mirror", MFD_CLOEXEC);
+if(fd < 0) {
+    return __LINE__;
+    }
+if(ftruncate(fd, Size) != 0) {
+    close(fd);
+    return __LINE__;
+    }
+
+// reserve the address space for both mappings, then map the same pages twice over it:
+base = mmap(NULL, 2 * Size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+if(base == MAP_FAILED) {
+    close(fd);
+    return __LINE__;
+    }
+if((mmap(base, Size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) ||
+   (mmap(base + Size, Size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+    munmap(base, 2 * Size);
+    close(fd);
+    return __LINE__;
+    }
+close(fd); // the mappings keep the memory alive
+
+p_mirror -> Data = base;
+p_mirror -> Size = Size;
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufMirrorFree(CircBufMirror_t *p_mirror)
+{
+if(p_mirror == NULL){
+    return __LINE__;
+    }
+if(p_mirror -> Data != NULL) {
+    if(munmap(p_mirror -> Data, 2 * p_mirror -> Size) != 0) {
+        return __LINE__;
+        }
+    }
+p_mirror -> Data = NULL;
+p_mirror -> Size = 0;
+return 0;
+}
+
+// ==============================================================================
+
+CCBFsize_t CircBufMirrorSpan(CCBFsize_t (*p)[2][2], CCBFsize_t *p_start)
+{
+CCBFsize_t Sz0 = CircBufSz(0, (*p));
+CCBFsize_t Sz1 = CircBufSz(1, (*p));
+// the region starts in the first range when it wraps around, in the second one otherwise
+*p_start = (Sz0 > 0) ? (*p)[0][0] : (*p)[1][0];
+return Sz0 + Sz1;
+}
@@ -0,0 +1,59 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Double-mapped data buffer (Linux only): the "magic" ring buffer.
+
+ The data buffer is mapped twice in a row in virtual memory, so that the element ElemInBuf + i is the element i.
+ The two ranges returned by CircBufRdInd() / CircBufWrInd() (or by any other index manager of this library) can then be
+ used as a single contiguous region: see CircBufMirrorSpan(). Parsers, memcpy(), write(), SIMD code... work across the wrap around.
+
+ The index managers are unchanged: this only allocates the data buffer.
+ The size of the buffer in bytes (ElemInBuf * ElemSize) must be a multiple of the page size: see CircBufMirrorElemMultiple().
+
+ */
+
+#ifndef CIRC_BUF_MIRROR_H
+#define CIRC_BUF_MIRROR_H
+
+#include <stddef.h>
+#include "circ_buf.h"
+
+typedef struct CircBufMirror_str
+{
+  void *Data; // first mapping: Size bytes. The second one follows: Data + Size
+  size_t Size; // size of the buffer in bytes: ElemInBuf * ElemSize
+} CircBufMirror_t;
+
+#define CIRCBUFMIRROR(x) ((CircBufMirror_t *)x)
+
+
+//
+// ElemInBuf must be a multiple of the returned value, for elements of ElemSize bytes
+//
+CCBFsize_t CircBufMirrorElemMultiple(size_t ElemSize);
+
+//
+// Allocates a buffer of ElemInBuf elements of ElemSize bytes, mapped twice.
+// Initialize the index manager with the same ElemInBuf.
+//
+// returns 0 if no error.
+//
+int CircBufMirrorAlloc(CircBufMirror_t *p_mirror, CCBFsize_t ElemInBuf, size_t ElemSize);
+
+//
+// Unmaps the buffer
+//
+int CircBufMirrorFree(CircBufMirror_t *p_mirror);
+
+//
+// The two ranges returned by an index manager, as one contiguous region (valid with a double-mapped buffer only):
+// *p_start receives the index of its first element, and the number of elements is returned.
+// The region may go past ElemInBuf - 1: Data + *p_start * ElemSize is valid up to the end of the second mapping.
+//
+CCBFsize_t CircBufMirrorSpan(CCBFsize_t (*p)[2][2], CCBFsize_t *p_start);
+
+#endif // CIRC_BUF_MIRROR_H
@@ -0,0 +1,118 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+ */
+
+#include <stddef.h>
+#include <sched.h>
+#include "circ_buf_mp.h"
+
+#define SPINS_BEFORE_YIELD 64 // when waiting for another writer to commit
+
+// ==============================================================================
+
+//
+// index in the buffer of a count of elements
+//
+static inline CCBFsize_t CircBufMpPos(CircBufMp_t *p_circ, CCBFcount_t Count)
+{
+if(p_circ -> Mask != 0) return Count & p_circ -> Mask;
+return Count % p_circ -> Ring.ElemInBuf;
+}
+
+// ==============================================================================
+
+// SizeOfBuf : in elements (NOT bytes!) must be >= 2
+int CircBufMpInit(CircBufMp_t *p_circ, CCBFsize_t SizeOfBuf)
+{
+int ret;
+if(p_circ == NULL){
+    return __LINE__;
+    }
+ret = CircBufInit(CIRCBUF(&(p_circ -> Ring)), SizeOfBuf);
+if(ret != 0) {
+    return ret;
+    }
+p_circ -> Mask = ((SizeOfBuf & (SizeOfBuf - 1)) == 0) ? SizeOfBuf - 1 : 0;
+CCBF_STORE_RLX(p_circ -> Claimed, 0);
+CCBF_STORE_RLX(p_circ -> Committed, 0);
+return 0;
+}
+
+// ==============================================================================
+
+//
+// Reserves Nclaim elements for the calling writer.
+//
+// returns 0 if no error (even if nothing could be claimed: check the ranges)
+//
+int CircBufMpClaim(CircBufMp_t *p_circ, CCBFsize_t Nclaim, CCBFsize_t (*p)[2][2], CCBFcount_t *p_ticket)
+{
+CCBFcount_t Claimed;
+CCBFsize_t Rd, Wr, Free;
+
+if(p == NULL) {
+    return __LINE__;
+    }
+CircBufSpanRange(0, 0, 0, p); // set empty ranges
+if((p_circ == NULL) || (p_ticket == NULL)){
+    return __LINE__;
+    }
+if((Nclaim == 0) || (Nclaim > p_circ -> Ring.ElemInBuf - 1)) {
+    return __LINE__; // could never be satisfied
+    }
+
+Claimed = atomic_load_explicit(&(p_circ -> Claimed), memory_order_relaxed);
+do {
+    // the reader must be done with the data before we overwrite them.
+    // Rd is read after Claimed: if the CAS below succeeds, no other claim was made in between,
+    // so the reader is still behind Claimed and Free can only be underestimated.
+    Rd = CCBF_LOAD_ACQ(p_circ -> Ring.RdPos);
+    Wr = CircBufMpPos(p_circ, Claimed);
+    Free = CircBufFreeCount(Rd, Wr, p_circ -> Ring.ElemInBuf);
+    if(Free < Nclaim) {
+        return 0; // not enough space: nothing claimed
+       }
+  } while(!atomic_compare_exchange_weak_explicit(&(p_circ -> Claimed), &Claimed, Claimed + Nclaim, memory_order_relaxed, memory_order_relaxed));
+
+*p_ticket = Claimed;
+CircBufSpanRange(Wr, Nclaim, p_circ -> Ring.ElemInBuf, p);
+return 0;
+}
+
+// ==============================================================================
+
+//
+// Makes the Nclaim elements of the claim Ticket visible to the reader.
+//
+// returns 0 if no error.
+//
+int CircBufMpCommit(CircBufMp_t *p_circ, CCBFcount_t Ticket, CCBFsize_t Nclaim)
+{
+int spins = 0;
+
+if(p_circ == NULL){
+    return __LINE__;
+    }
+if(Ticket + Nclaim > atomic_load_explicit(&(p_circ -> Claimed), memory_order_relaxed)) {
+    return __LINE__; // never claimed
+    }
+
+// wait for the previous claims to be committed:
+while(atomic_load_explicit(&(p_circ -> Committed), memory_order_acquire) != Ticket) {
+    if(++spins < SPINS_BEFORE_YIELD) {
+        CCBF_CPU_RELAX();
+    } else {
+        sched_yield(); // the writer we wait for may have been preempted
+        spins = 0;
+    }
+   }
+
+// WrPos first: the next writer only updates WrPos once it sees our Committed, so WrPos never goes backwards.
+CCBF_STORE_REL(p_circ -> Ring.WrPos, CircBufMpPos(p_circ, Ticket + Nclaim)); // publishes our data to the reader
+atomic_store_explicit(&(p_circ -> Committed), Ticket + Nclaim, memory_order_release);
+return 0;
+}
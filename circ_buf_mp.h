@@ -0,0 +1,70 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Multiple producers / single consumer index manager.
+
+ The writers don't use CircBufWrInd()/CircBufUpdtWr() but:
+   - CircBufMpClaim() : reserves Nclaim elements with a single CAS on the claim counter, and returns their ranges,
+   - CircBufMpCommit() : once the data are written in the ranges, makes them visible to the reader.
+ Several writers can claim, fill and commit at the same time: no lock is ever taken.
+
+ The reader is unchanged: it uses CircBufRdInd()/CircBufUpdtRd() on the CircBuf_t member "Ring".
+ It only sees a prefix of the claims once every claim in it has been committed: a writer committing its claim waits
+ until the writers that claimed before it have committed theirs. Fill the claimed ranges promptly!
+
+ Requires CCBF_ATOMICS=1 (see custom_circ_buf.h).
+
+ */
+
+#ifndef CIRC_BUF_MP_H
+#define CIRC_BUF_MP_H
+
+#include "circ_buf.h"
+
+#if !CCBF_ATOMICS
+#error "circ_buf_mp.h requires CCBF_ATOMICS=1 (see custom_circ_buf.h)"
+#endif
+
+typedef struct CircBufMp_str
+{
+  CircBuf_t Ring; // the reader uses CircBufRdInd()/CircBufUpdtRd() on this one. Ring.WrPos: end of the committed data
+  CCBFsize_t Mask; // ElemInBuf - 1 if ElemInBuf is a power of two, 0 otherwise
+
+  // number of elements claimed by all the writers since the initialization
+  // free running, so that a stalled writer can't be fooled by a counter that went full circle (ABA)
+  CCBFvolcount_t Claimed __attribute__((aligned(CCBF_CACHE_LINE)));
+
+  // number of elements committed since the initialization: (Committed % ElemInBuf) == Ring.WrPos
+  CCBFvolcount_t Committed __attribute__((aligned(CCBF_CACHE_LINE)));
+
+} CircBufMp_t;
+
+#define CIRCBUFMP(x) ((CircBufMp_t *)x)
+
+
+// SizeOfBuf : in elements (NOT bytes!) must be >= 2
+int CircBufMpInit(CircBufMp_t *p_circ, CCBFsize_t SizeOfBuf);
+
+//
+// Reserves Nclaim elements for the calling writer.
+//
+// If there is enough space, (*p) receives the ranges to write to, and *p_ticket identifies the claim for CircBufMpCommit().
+// Otherwise nothing is claimed, and (*p) receives empty ranges (CircBufSzSum() == 0): try again later.
+//
+// returns 0 if no error.
+//
+int CircBufMpClaim(CircBufMp_t *p_circ, CCBFsize_t Nclaim, CCBFsize_t (*p)[2][2], CCBFcount_t *p_ticket);
+
+//
+// Makes the Nclaim elements of the claim Ticket visible to the reader.
+// Waits until all the previous claims have been committed.
+//
+// returns 0 if no error.
+//
+int CircBufMpCommit(CircBufMp_t *p_circ, CCBFcount_t Ticket, CCBFsize_t Nclaim);
+
+#endif // CIRC_BUF_MP_H
@@ -0,0 +1,115 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Sequence counter of a slot, for the lap that starts at count "Pos" (Pos & Mask == slot index):
+   Seq == Pos              : free, waiting for the writer of that lap
+   Seq == Pos + 1          : holds data, waiting for the reader of that lap
+   Seq == Pos + ElemInBuf  : read, free for the writer of the next lap
+
+ */
+
+#include <stddef.h>
+#include "circ_buf_mpmc.h"
+
+// ==============================================================================
+
+// SizeOfBuf : in elements (NOT bytes!), power of two >= 2
+int CircBufMpmcInit(CircBufMpmc_t *p_circ, CCBFsize_t SizeOfBuf, CCBFvolcount_t *Seq)
+{
+CCBFsize_t i;
+if(SizeOfBuf < 2) {
+    return __LINE__; // with a single slot, "holds data" and "free for the next lap" would be the same sequence
+    }
+if((SizeOfBuf & (SizeOfBuf - 1)) != 0) {
+    return __LINE__; // not a power of two
+    }
+if((p_circ == NULL) || (Seq == NULL)){
+    return __LINE__;
+    }
+p_circ -> ElemInBuf = SizeOfBuf;
+p_circ -> Mask = SizeOfBuf - 1;
+p_circ -> Seq = Seq;
+for(i=0; i< SizeOfBuf; i++) CCBF_STORE_RLX(Seq[i], i);
+CCBF_STORE_RLX(p_circ -> WrPos, 0);
+CCBF_STORE_RLX(p_circ -> RdPos, 0);
+atomic_thread_fence(memory_order_release); // the counters must be ready before the threads start
+return 0;
+}
+
+// ==============================================================================
+
+//
+// Claims one slot: Offset == 0 for the writers (the slot must be free), Offset == 1 for the readers (the slot must hold data)
+//
+static int CircBufMpmcClaim(CircBufMpmc_t *p_circ, CCBFvolcount_t *p_Pos, CCBFcount_t Offset, CCBFsize_t *p_ind, CCBFcount_t *p_ticket)
+{
+CCBFcount_t Pos, Seq;
+int64_t dif;
+
+Pos = atomic_load_explicit(p_Pos, memory_order_relaxed);
+for(;;) {
+    Seq = CCBF_LOAD_ACQ(p_circ -> Seq[Pos & p_circ -> Mask]); // the other side must be done with the slot
+    dif = (int64_t)(Seq - (Pos + Offset));
+    if(dif == 0) {
+        // the slot is ready for us: try to take it
+        if(atomic_compare_exchange_weak_explicit(p_Pos, &Pos, Pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+            break;
+           }
+        // another thread took it: Pos has been reloaded
+    } else if(dif < 0) {
+        return CCBF_AGAIN; // the slot still belongs to the previous lap: full (writers) or empty (readers)
+    } else {
+        Pos = atomic_load_explicit(p_Pos, memory_order_relaxed); // another thread went past us
+    }
+   }
+
+*p_ind = Pos & p_circ -> Mask;
+*p_ticket = Pos;
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufMpmcWrClaim(CircBufMpmc_t *p_circ, CCBFsize_t *p_ind, CCBFcount_t *p_ticket)
+{
+if((p_circ == NULL) || (p_ind == NULL) || (p_ticket == NULL)){
+    return __LINE__;
+    }
+return CircBufMpmcClaim(p_circ, &(p_circ -> WrPos), 0, p_ind, p_ticket);
+}
+
+// ==============================================================================
+
+int CircBufMpmcWrCommit(CircBufMpmc_t *p_circ, CCBFcount_t Ticket)
+{
+if(p_circ == NULL){
+    return __LINE__;
+    }
+CCBF_STORE_REL(p_circ -> Seq[Ticket & p_circ -> Mask], Ticket + 1); // publishes the data written before this call
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufMpmcRdClaim(CircBufMpmc_t *p_circ, CCBFsize_t *p_ind, CCBFcount_t *p_ticket)
+{
+if((p_circ == NULL) || (p_ind == NULL) || (p_ticket == NULL)){
+    return __LINE__;
+    }
+return CircBufMpmcClaim(p_circ, &(p_circ -> RdPos), 1, p_ind, p_ticket);
+}
+
+// ==============================================================================
+
+int CircBufMpmcRdCommit(CircBufMpmc_t *p_circ, CCBFcount_t Ticket)
+{
+if(p_circ == NULL){
+    return __LINE__;
+    }
+CCBF_STORE_REL(p_circ -> Seq[Ticket & p_circ -> Mask], Ticket + p_circ -> ElemInBuf); // frees the slot only after the data have been read
+return 0;
+}
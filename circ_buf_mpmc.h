@@ -0,0 +1,74 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Multiple producers / multiple consumers index manager (bounded queue of D. Vyukov).
+
+ As with the other index managers, the data live in the caller's arrays: several independent data arrays can share one CircBufMpmc_t.
+ The caller also provides an array of ElemInBuf sequence counters (CCBFvolcount_t), kept next to its data arrays,
+ that tells for every slot whether it is free or holds data, and for which lap.
+
+ Writers and readers get one slot at a time, with a single CAS and no global lock:
+   writer: CircBufMpmcWrClaim() -> write the data at the returned index -> CircBufMpmcWrCommit()
+   reader: CircBufMpmcRdClaim() -> read the data at the returned index  -> CircBufMpmcRdCommit()
+
+ The buffer size must be a power of two (>= 2). All the elements can be used.
+ Requires CCBF_ATOMICS=1 (see custom_circ_buf.h).
+
+ */
+
+#ifndef CIRC_BUF_MPMC_H
+#define CIRC_BUF_MPMC_H
+
+#include "circ_buf.h"
+
+#if !CCBF_ATOMICS
+#error "circ_buf_mpmc.h requires CCBF_ATOMICS=1 (see custom_circ_buf.h)"
+#endif
+
+typedef struct CircBufMpmc_str
+{
+  CCBFsize_t ElemInBuf; // buffer size in elements (NOT bytes!), power of two
+  CCBFsize_t Mask; // ElemInBuf - 1
+  CCBFvolcount_t *Seq; // caller provided: one sequence counter per slot
+
+  CCBFvolcount_t WrPos __attribute__((aligned(CCBF_CACHE_LINE))); // number of slots claimed by the writers since the initialization
+  CCBFvolcount_t RdPos __attribute__((aligned(CCBF_CACHE_LINE))); // number of slots claimed by the readers since the initialization
+
+} CircBufMpmc_t;
+
+#define CIRCBUFMPMC(x) ((CircBufMpmc_t *)x)
+
+
+// SizeOfBuf : in elements (NOT bytes!), power of two >= 2
+// Seq : array of SizeOfBuf counters, that must live as long as the index manager
+int CircBufMpmcInit(CircBufMpmc_t *p_circ, CCBFsize_t SizeOfBuf, CCBFvolcount_t *Seq);
+
+//
+// Claims one free slot for writing: *p_ind receives its index, *p_ticket identifies the claim for CircBufMpmcWrCommit()
+//
+// returns 0 if a slot was claimed, CCBF_AGAIN if the buffer is full, an error code (> 0) otherwise.
+//
+int CircBufMpmcWrClaim(CircBufMpmc_t *p_circ, CCBFsize_t *p_ind, CCBFcount_t *p_ticket);
+
+//
+// The data of the claimed slot have been written: hands the slot over to the readers.
+//
+int CircBufMpmcWrCommit(CircBufMpmc_t *p_circ, CCBFcount_t Ticket);
+
+//
+// Claims the oldest slot containing data: *p_ind receives its index, *p_ticket identifies the claim for CircBufMpmcRdCommit()
+//
+// returns 0 if a slot was claimed, CCBF_AGAIN if the buffer is empty, an error code (> 0) otherwise.
+//
+int CircBufMpmcRdClaim(CircBufMpmc_t *p_circ, CCBFsize_t *p_ind, CCBFcount_t *p_ticket);
+
+//
+// The data of the claimed slot have been read: hands the slot back to the writers.
+//
+int CircBufMpmcRdCommit(CircBufMpmc_t *p_circ, CCBFcount_t Ticket);
+
+#endif // CIRC_BUF_MPMC_H
@@ -0,0 +1,140 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ No lost signal:
+   writer : stores WrPos, fence (seq_cst), then takes Armed (exchange) if the threshold is reached, and signals.
+   reader : Armed = 1 (seq_cst), then checks the threshold, and takes Armed back if it is reached.
+ Either the writer sees Armed, or the reader sees the data. Armed is taken by exchange, so only one of them acts.
+
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "circ_buf_notify.h"
+
+// ==============================================================================
+
+//
+// Writer side: signals the eventfd if armed and at least Nmin elements are in the ring
+//
+static int CircBufNtSignal(CircBufNt_t *p_circ, CCBFsize_t Nmin)
+{
+uint64_t one = 1;
+atomic_thread_fence(memory_order_seq_cst); // WrPos before Armed: see the top of this file
+if(CCBF_LOAD_RLX(p_circ -> Armed) == 0) {
+    return 0; // already signalled: nothing to do, no system call
+    }
+if(CircBufAvailRd(CIRCBUF(&(p_circ -> Ring))) < Nmin) {
+    return 0;
+    }
+if(atomic_exchange(&(p_circ -> Armed), 0) == 0) {
+    return 0; // the reader took it back: it will read the data anyway
+    }
+p_circ -> Nsignals++;
+if(write(p_circ -> Fd, &one, sizeof(one)) != sizeof(one)) {
+    return __LINE__;
+    }
+return 0;
+}
+
+// ==============================================================================
+
+// SizeOfBuf : in elements (NOT bytes!) must be >= 2
+int CircBufNtInit(CircBufNt_t *p_circ, CCBFsize_t SizeOfBuf, CCBFsize_t Threshold)
+{
+int ret;
+if(p_circ == NULL){
+    return __LINE__;
+    }
+if((Threshold == 0) || (Threshold > SizeOfBuf - 1)) {
+    return __LINE__; // would never trigger
+    }
+ret = CircBufInit(CIRCBUF(&(p_circ -> Ring)), SizeOfBuf);
+if(ret != 0) {
+    return ret;
+    }
+p_circ -> Fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+if(p_circ -> Fd < 0) {
+    return __LINE__;
+    }
+p_circ -> Threshold = Threshold;
+p_circ -> Nsignals = 0;
+atomic_store(&(p_circ -> Armed), 1);
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufNtClose(CircBufNt_t *p_circ)
+{
+if(p_circ == NULL){
+    return __LINE__;
+    }
+if(p_circ -> Fd >= 0) close(p_circ -> Fd);
+p_circ -> Fd = -1;
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufNtFd(CircBufNt_t *p_circ)
+{
+if(p_circ == NULL){
+    return -1;
+    }
+return p_circ -> Fd;
+}
+
+// ==============================================================================
+
+int CircBufNtUpdtWr(CircBufNt_t *p_circ, CCBFsize_t Nconsumed)
+{
+int ret;
+if(p_circ == NULL){
+    return __LINE__;
+    }
+ret = CircBufUpdtWr(CIRCBUF(&(p_circ -> Ring)), Nconsumed);
+if(ret != 0) {
+    return ret;
+    }
+return CircBufNtSignal(p_circ, p_circ -> Threshold);
+}
+
+// ==============================================================================
+
+int CircBufNtFlush(CircBufNt_t *p_circ)
+{
+if(p_circ == NULL){
+    return __LINE__;
+    }
+return CircBufNtSignal(p_circ, 1);
+}
+
+// ==============================================================================
+
+int CircBufNtRearm(CircBufNt_t *p_circ)
+{
+uint64_t cnt;
+if(p_circ == NULL){
+    return __LINE__;
+    }
+// clear the eventfd first: a signal sent after this point must stay visible
+if((read(p_circ -> Fd, &cnt, sizeof(cnt)) < 0) && (errno != EAGAIN)) {
+    return __LINE__;
+    }
+atomic_store(&(p_circ -> Armed), 1); // seq_cst: see the top of this file
+if(CircBufAvailRd(CIRCBUF(&(p_circ -> Ring))) < p_circ -> Threshold) {
+    return 0;
+    }
+if(atomic_exchange(&(p_circ -> Armed), 0) == 0) {
+    return 0; // the writer has just signalled: the eventfd is readable
+    }
+return CCBF_AGAIN;
+}
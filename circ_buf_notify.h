@@ -0,0 +1,79 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ eventfd notifier attached to a CircBuf_t (Linux only): lets the ring sit in an epoll / poll / select event loop.
+
+ The eventfd becomes readable when the number of elements in the ring reaches Threshold (1: as soon as it is not empty).
+ Signals are coalesced: once signalled, the notifier is disarmed, and the following CircBufNtUpdtWr() make no system call
+ until the reader re-arms it. The reader:
+   - waits for the eventfd (epoll_wait() etc.),
+   - reads the ring until it is empty (CircBufRdInd() / CircBufUpdtRd() on the Ring member, as usual),
+   - calls CircBufNtRearm(): if it returns CCBF_AGAIN, data arrived in the meantime: read again before going back to the event loop.
+
+ One writer, one reader. Requires CCBF_ATOMICS=1.
+
+ */
+
+#ifndef CIRC_BUF_NOTIFY_H
+#define CIRC_BUF_NOTIFY_H
+
+#include "circ_buf.h"
+
+#if !CCBF_ATOMICS
+#error "circ_buf_notify.h requires CCBF_ATOMICS=1 (see custom_circ_buf.h)"
+#endif
+
+typedef struct CircBufNt_str
+{
+  CircBuf_t Ring; // the usual index manager
+
+  int Fd; // the eventfd, created by CircBufNtInit()
+  CCBFsize_t Threshold; // number of elements in the ring that triggers the signal
+  CCBFvolsize_t Armed; // != 0 : the reader waits for a signal
+
+  CCBFcount_t Nsignals; // number of times the eventfd has been signalled (statistics), only written by the writer
+
+} CircBufNt_t;
+
+#define CIRCBUFNT(x) ((CircBufNt_t *)x)
+
+
+// SizeOfBuf : in elements (NOT bytes!) must be >= 2
+// Threshold : from 1 to SizeOfBuf - 1
+// The notifier starts armed.
+int CircBufNtInit(CircBufNt_t *p_circ, CCBFsize_t SizeOfBuf, CCBFsize_t Threshold);
+
+//
+// Closes the eventfd.
+//
+int CircBufNtClose(CircBufNt_t *p_circ);
+
+//
+// File descriptor to watch for readability (EPOLLIN)
+//
+int CircBufNtFd(CircBufNt_t *p_circ);
+
+//
+// Same as CircBufUpdtWr(), and signals the eventfd if the notifier is armed and the threshold is reached.
+//
+int CircBufNtUpdtWr(CircBufNt_t *p_circ, CCBFsize_t Nconsumed);
+
+//
+// Writer side: signals the eventfd if the notifier is armed and the ring is not empty, whatever the threshold.
+// For the end of a burst that may stay below the threshold.
+//
+int CircBufNtFlush(CircBufNt_t *p_circ);
+
+//
+// Reader side, once the ring has been read: clears the eventfd and re-arms the notifier.
+//
+// returns 0 if the notifier is armed (go back to the event loop), CCBF_AGAIN if the threshold has been reached in the meantime
+// (the notifier is not armed: read the ring and call CircBufNtRearm() again), an error code (> 0) otherwise.
+//
+int CircBufNtRearm(CircBufNt_t *p_circ);
+
+#endif // CIRC_BUF_NOTIFY_H
@@ -0,0 +1,179 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Ring of C++ objects, header only (C++20), one writer thread and one reader thread.
+
+ ccbf::RingBuffer<T, N> (circ_buf.hpp) holds N constructed elements, and the caller copies data into them.
+ ccbf::ObjectRing<T, N> holds uninitialized storage instead: the objects are constructed in place by emplace(),
+ moved out and destroyed by pop(), and only the objects in the ring are alive. Suited for std::unique_ptr, std::string, large structs...
+
+ The bulk variants construct (resp. consume) several objects at once, over the two segments of the ring, and update the index only once.
+
+ */
+
+#ifndef CIRC_BUF_OBJ_HPP
+#define CIRC_BUF_OBJ_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "circ_buf.hpp"
+
+namespace ccbf {
+
+template<typename T, std::size_t N, typename Index = uint_for<N - 1>>
+class ObjectRing
+{
+  static_assert(std::is_unsigned_v<Index>, "the index type must be unsigned");
+  static_assert(N - 1 <= std::numeric_limits<Index>::max(), "the index type is too small for N");
+  static_assert(std::atomic<Index>::is_always_lock_free, "the index type must be lock free");
+  static_assert(std::is_nothrow_destructible_v<T>, "the objects are destroyed by pop()");
+
+  using Ind = RingIndex<N>;
+
+public:
+  using value_type = T;
+  using index_type = Index;
+
+  static constexpr std::size_t capacity() noexcept { return N - 1; }
+
+  ObjectRing() = default;
+  ObjectRing(const ObjectRing &) = delete;
+  ObjectRing &operator=(const ObjectRing &) = delete;
+
+  // destroys the objects still in the ring. No thread may use the ring anymore.
+  ~ObjectRing()
+  {
+    std::size_t Rd = RdPos.load(std::memory_order_relaxed);
+    std::size_t Wr = WrPos.load(std::memory_order_acquire);
+    for(std::size_t n = Ind::used(Rd, Wr); n > 0; n--) {
+        std::destroy_at(slot(Rd));
+        Rd = Ind::wrap(Rd + 1);
+        }
+  }
+
+  // ==============================================================================
+  // writer
+
+  //
+  // Constructs an object at the end of the ring, from Args.
+  // returns false if the ring is full (nothing constructed).
+  //
+  template<typename... Args>
+  bool emplace(Args &&... args)
+  {
+    std::size_t Rd = RdPos.load(std::memory_order_acquire); // the reader must be done with the slot before we reuse it
+    std::size_t Wr = WrPos.load(std::memory_order_relaxed);
+    if(Ind::free(Rd, Wr) == 0) {
+        return false;
+        }
+    ::new (static_cast<void *>(slot(Wr))) T(std::forward<Args>(args)...);
+    WrPos.store(static_cast<Index>(Ind::wrap(Wr + 1)), std::memory_order_release);
+    return true;
+  }
+
+  //
+  // Constructs up to Nmax objects at the end of the ring, each one from make() (that returns a T: it is constructed in place).
+  // returns the number of objects constructed.
+  //
+  template<typename Make>
+  std::size_t emplace_bulk(std::size_t Nmax, Make &&make)
+  {
+    std::size_t Rd = RdPos.load(std::memory_order_acquire);
+    std::size_t Wr = WrPos.load(std::memory_order_relaxed);
+    std::size_t Nfree = Ind::free(Rd, Wr);
+    std::size_t Ntot = (Nmax < Nfree) ? Nmax : Nfree;
+    std::size_t Len0 = Ind::first_len(Wr, Ntot);
+    std::size_t n = 0;
+    try {
+        for(; n < Len0; n++) ::new (static_cast<void *>(slot(Wr + n))) T(make());
+        for(; n < Ntot; n++) ::new (static_cast<void *>(slot(n - Len0))) T(make());
+    } catch(...) {
+        WrPos.store(static_cast<Index>(Ind::wrap(Wr + n)), std::memory_order_release); // keep the objects already constructed
+        throw;
+    }
+    WrPos.store(static_cast<Index>(Ind::wrap(Wr + Ntot)), std::memory_order_release);
+    return Ntot;
+  }
+
+  // ==============================================================================
+  // reader
+
+  //
+  // Moves the first object of the ring to out, and destroys it.
+  // returns false if the ring is empty.
+  //
+  bool pop(T &out)
+  {
+    std::size_t Rd = RdPos.load(std::memory_order_relaxed);
+    std::size_t Wr = WrPos.load(std::memory_order_acquire); // the object must be visible before we read it
+    if(Rd == Wr) {
+        return false;
+        }
+    T *p = slot(Rd);
+    out = std::move(*p);
+    std::destroy_at(p);
+    RdPos.store(static_cast<Index>(Ind::wrap(Rd + 1)), std::memory_order_release);
+    return true;
+  }
+
+  //
+  // Gives up to Nmax objects to consume(T &&), then destroys them.
+  // returns the number of objects consumed.
+  //
+  template<typename Consume>
+  std::size_t consume_bulk(std::size_t Nmax, Consume &&consume)
+  {
+    std::size_t Rd = RdPos.load(std::memory_order_relaxed);
+    std::size_t Wr = WrPos.load(std::memory_order_acquire);
+    std::size_t Nused = Ind::used(Rd, Wr);
+    std::size_t Ntot = (Nmax < Nused) ? Nmax : Nused;
+    std::size_t n = 0;
+    try {
+        for(; n < Ntot; n++) {
+            T *p = slot(Ind::wrap(Rd + n));
+            consume(std::move(*p));
+            std::destroy_at(p);
+            }
+    } catch(...) {
+        std::destroy_at(slot(Ind::wrap(Rd + n))); // the object has been given to consume(): it is not kept
+        RdPos.store(static_cast<Index>(Ind::wrap(Rd + n + 1)), std::memory_order_release);
+        throw;
+    }
+    RdPos.store(static_cast<Index>(Ind::wrap(Rd + Ntot)), std::memory_order_release);
+    return Ntot;
+  }
+
+  //
+  // number of objects that can be popped (resp. emplaced)
+  //
+  std::size_t AvailRd() const noexcept
+  {
+    return Ind::used(RdPos.load(std::memory_order_relaxed), WrPos.load(std::memory_order_acquire));
+  }
+  std::size_t AvailWr() const noexcept
+  {
+    return Ind::free(RdPos.load(std::memory_order_acquire), WrPos.load(std::memory_order_relaxed));
+  }
+
+private:
+  T *slot(std::size_t i) noexcept
+  {
+    return std::launder(reinterpret_cast<T *>(Storage + i * sizeof(T)));
+  }
+
+  std::atomic<Index> RdPos{0}; // first object of the ring
+  std::atomic<Index> WrPos{0}; // next slot to construct
+  alignas(T) unsigned char Storage[N * sizeof(T)]; // uninitialized
+};
+
+} // namespace ccbf
+
+#endif // CIRC_BUF_OBJ_HPP
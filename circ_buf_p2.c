@@ -0,0 +1,131 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+ */
+
+#include <stddef.h>
+#include "circ_buf_p2.h"
+
+// ==============================================================================
+
+// SizeOfBuf : in elements (NOT bytes!) must be a power of two
+int CircBufP2Init(CircBufP2_t *p_circ, CCBFsize_t SizeOfBuf)
+{
+if(SizeOfBuf == 0) {
+    return __LINE__;
+    }
+if((SizeOfBuf & (SizeOfBuf - 1)) != 0) {
+    return __LINE__; // not a power of two
+    }
+if(p_circ == NULL){
+    return __LINE__;
+    }
+p_circ -> ElemInBuf = SizeOfBuf;
+p_circ -> Mask = SizeOfBuf - 1;
+CCBF_STORE_RLX(p_circ -> RdPos, 0);
+CCBF_STORE_RLX(p_circ -> WrPos, 0);
+return 0;
+}
+
+// ==============================================================================
+
+//
+// returns the buffers where data can be written
+//
+// returns 0 if no error.
+//
+int CircBufP2WrInd(CircBufP2_t *p_circ, CCBFsize_t (*p)[2][2])
+{
+CCBFcount_t Rd, Wr;
+
+if(p == NULL) {
+    return __LINE__;
+    }
+if(p_circ == NULL){
+    CircBufSpanRange(0, 0, 0, p); // set empty ranges
+    return __LINE__;
+    }
+
+Rd = CCBF_LOAD_ACQ(p_circ -> RdPos); // owned by the reader: the reader must be done with the data before we overwrite it
+Wr = CCBF_LOAD_RLX(p_circ -> WrPos); // our own index
+
+CircBufSpanRange(Wr & p_circ -> Mask, p_circ -> ElemInBuf - (CCBFsize_t)(Wr - Rd), p_circ -> ElemInBuf, p);
+return 0;
+}
+
+// ==============================================================================
+
+//
+// returns the buffers where data can be read
+//
+// returns 0 if no error.
+//
+int CircBufP2RdInd(CircBufP2_t *p_circ, CCBFsize_t (*p)[2][2])
+{
+CCBFcount_t Rd, Wr;
+
+if(p == NULL) {
+    return __LINE__;
+    }
+if(p_circ == NULL){
+    CircBufSpanRange(0, 0, 0, p); // set empty ranges
+    return __LINE__;
+    }
+
+Rd = CCBF_LOAD_RLX(p_circ -> RdPos); // our own index
+Wr = CCBF_LOAD_ACQ(p_circ -> WrPos); // owned by the writer: the data must be visible before we read them
+
+CircBufSpanRange(Rd & p_circ -> Mask, (CCBFsize_t)(Wr - Rd), p_circ -> ElemInBuf, p);
+return 0;
+}
+
+// ==============================================================================
+
+//
+// Updates the buffer as Nconsumed items have been inserted in the buffer
+//
+int CircBufP2UpdtWr(CircBufP2_t *p_circ, CCBFsize_t Nconsumed)
+{
+if(p_circ == NULL){
+    return __LINE__;
+    }
+if(Nconsumed > p_circ -> ElemInBuf) {
+    return __LINE__;
+    }
+CCBF_STORE_REL(p_circ -> WrPos, CCBF_LOAD_RLX(p_circ -> WrPos) + Nconsumed); // publishes the data written before this call
+return 0;
+}
+
+// ==============================================================================
+
+//
+// Updates the buffer as Nconsumed items have been deleted from the buffer
+//
+int CircBufP2UpdtRd(CircBufP2_t *p_circ, CCBFsize_t Nconsumed)
+{
+if(p_circ == NULL){
+    return __LINE__;
+    }
+if(Nconsumed > p_circ -> ElemInBuf) {
+    return __LINE__;
+    }
+CCBF_STORE_REL(p_circ -> RdPos, CCBF_LOAD_RLX(p_circ -> RdPos) + Nconsumed); // frees the space only after the data have been read
+return 0;
+}
+
+// ==============================================================================
+
+CCBFcount_t CircBufP2WrOffset(CircBufP2_t *p_circ)
+{
+return CCBF_LOAD_ACQ(p_circ -> WrPos);
+}
+
+// ==============================================================================
+
+CCBFcount_t CircBufP2RdOffset(CircBufP2_t *p_circ)
+{
+return CCBF_LOAD_ACQ(p_circ -> RdPos);
+}
@@ -0,0 +1,72 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Power-of-two index manager.
+
+ Same API as CircBuf_t, but the buffer size must be a power of two, and RdPos/WrPos are free running counters
+ (number of elements read/written since the initialization) masked on access:
+  - no element is wasted to tell a full buffer from an empty one: all ElemInBuf elements can be used,
+  - the number of elements in the buffer is WrPos - RdPos, and no modulo is ever needed,
+  - RdPos and WrPos are absolute offsets in the stream, that can be logged to correlate events.
+
+ */
+
+#ifndef CIRC_BUF_P2_H
+#define CIRC_BUF_P2_H
+
+#include "circ_buf.h"
+
+typedef struct CircBufP2_str
+{
+  CCBFsize_t ElemInBuf; // buffer size in elements (NOT bytes!), power of two
+  CCBFsize_t Mask; // ElemInBuf - 1
+
+  // if(RdPos == WrPos) --> buffer empty
+  // if(WrPos - RdPos == ElemInBuf) --> buffer full
+  CCBFvolcount_t RdPos; // number of elements read since the initialization. (RdPos & Mask) : start index of valid data in buffer
+  CCBFvolcount_t WrPos; // number of elements written since the initialization. (WrPos & Mask) : next index to write
+
+} CircBufP2_t;
+
+#define CIRCBUFP2(x) ((CircBufP2_t *)x)
+
+
+// SizeOfBuf : in elements (NOT bytes!), must be a power of two
+int CircBufP2Init(CircBufP2_t *p_circ, CCBFsize_t SizeOfBuf);
+
+//
+// returns the buffers where data can be written
+//
+// returns 0 if no error.
+//
+int CircBufP2WrInd(CircBufP2_t *p_circ, CCBFsize_t (*p)[2][2]);
+
+//
+// returns the buffers where data can be read
+//
+// returns 0 if no error.
+//
+int CircBufP2RdInd(CircBufP2_t *p_circ, CCBFsize_t (*p)[2][2]);
+
+//
+// Updates the buffer as Nconsumed items have been inserted in the buffer
+//
+int CircBufP2UpdtWr(CircBufP2_t *p_circ, CCBFsize_t Nconsumed);
+
+//
+// Updates the buffer as Nconsumed items have been deleted from the buffer
+//
+int CircBufP2UpdtRd(CircBufP2_t *p_circ, CCBFsize_t Nconsumed);
+
+//
+// Absolute offsets in the stream: number of elements written (resp. read) since the initialization
+// Only the writer (resp. reader) gets an exact value: for the other side this is a snapshot.
+//
+CCBFcount_t CircBufP2WrOffset(CircBufP2_t *p_circ);
+CCBFcount_t CircBufP2RdOffset(CircBufP2_t *p_circ);
+
+#endif // CIRC_BUF_P2_H
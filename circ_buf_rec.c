@@ -0,0 +1,163 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "circ_buf_rec.h"
+
+// ==============================================================================
+
+//
+// byte spans of the payload of a record of Len bytes, whose header is at index Hdr
+//
+static void CircBufRecSpans(CircBufRec_t *p_circ, CCBFsize_t Hdr, size_t Len, CircBufRecSpan_t (*p_span)[2])
+{
+CCBFsize_t Ind[2][2];
+CCBFsize_t Nunits = (Len + p_circ -> Unit - 1) / p_circ -> Unit;
+CCBFsize_t Start = Hdr + 1;
+size_t first;
+
+if(Start == p_circ -> Ring.ElemInBuf) Start = 0;
+CircBufSpanRange(Start, Nunits, p_circ -> Ring.ElemInBuf, &Ind);
+
+// the payload begins in the first non-empty range:
+if(CircBufSz(0, Ind) > 0) {
+    first = (size_t)CircBufSz(0, Ind) * p_circ -> Unit;
+    if(first > Len) first = Len;
+    (*p_span)[0].ptr = p_circ -> Data + (size_t)Ind[0][0] * p_circ -> Unit;
+    (*p_span)[0].len = first;
+    (*p_span)[1].ptr = p_circ -> Data; // wraps around: the rest is at the beginning of the buffer
+    (*p_span)[1].len = Len - first;
+} else {
+    (*p_span)[0].ptr = p_circ -> Data + (size_t)Start * p_circ -> Unit;
+    (*p_span)[0].len = Len;
+    (*p_span)[1].ptr = NULL;
+    (*p_span)[1].len = 0;
+}
+}
+
+// ==============================================================================
+
+int CircBufRecInit(CircBufRec_t *p_circ, void *Data, CCBFsize_t Nunits, CCBFsize_t Unit)
+{
+int ret;
+if((p_circ == NULL) || (Data == NULL)){
+    return __LINE__;
+    }
+if((Unit < sizeof(CircBufRecHdr_t)) || ((Unit & (Unit - 1)) != 0)) {
+    return __LINE__; // too small, or not a power of two
+    }
+if(((uintptr_t)Data & (Unit - 1)) != 0) {
+    return __LINE__; // not aligned on a unit
+    }
+if(Nunits < 3) {
+    return __LINE__; // no room for a header and a unit of payload
+    }
+ret = CircBufInit(CIRCBUF(&(p_circ -> Ring)), Nunits);
+if(ret != 0) {
+    return ret;
+    }
+p_circ -> Data = Data;
+p_circ -> Unit = Unit;
+p_circ -> WrUnits = 0;
+p_circ -> RdUnits = 0;
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufRecWrReserve(CircBufRec_t *p_circ, size_t Len, CircBufRecSpan_t (*p_span)[2])
+{
+CCBFsize_t Rd, Wr;
+size_t Nunits;
+CircBufRecHdr_t *p_hdr;
+
+if((p_circ == NULL) || (p_span == NULL)){
+    return __LINE__;
+    }
+p_circ -> WrUnits = 0;
+Nunits = 1 + (Len + p_circ -> Unit - 1) / p_circ -> Unit; // header included
+if((Len > UINT32_MAX) || (Nunits > p_circ -> Ring.ElemInBuf - 1)) {
+    return __LINE__; // could never fit
+    }
+
+Rd = CCBF_LOAD_ACQ(p_circ -> Ring.RdPos); // owned by the reader: the reader must be done with the data before we overwrite it
+Wr = CCBF_LOAD_RLX(p_circ -> Ring.WrPos); // our own index
+if(CircBufFreeCount(Rd, Wr, p_circ -> Ring.ElemInBuf) < Nunits) {
+    return CCBF_AGAIN;
+    }
+
+p_hdr = (CircBufRecHdr_t *)(p_circ -> Data + (size_t)Wr * p_circ -> Unit);
+p_hdr -> Len = Len;
+p_hdr -> Rsvd = 0;
+CircBufRecSpans(p_circ, Wr, Len, p_span);
+p_circ -> WrUnits = Nunits;
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufRecWrCommit(CircBufRec_t *p_circ)
+{
+CCBFsize_t Nunits;
+if(p_circ == NULL){
+    return __LINE__;
+    }
+if(p_circ -> WrUnits == 0) {
+    return __LINE__; // nothing reserved
+    }
+Nunits = p_circ -> WrUnits;
+p_circ -> WrUnits = 0;
+return CircBufUpdtWr(CIRCBUF(&(p_circ -> Ring)), Nunits); // publishes the header and the payload
+}
+
+// ==============================================================================
+
+int CircBufRecRdPeek(CircBufRec_t *p_circ, CircBufRecSpan_t (*p_span)[2])
+{
+CCBFsize_t Rd, Wr;
+CircBufRecHdr_t *p_hdr;
+size_t Len;
+
+if((p_circ == NULL) || (p_span == NULL)){
+    return __LINE__;
+    }
+p_circ -> RdUnits = 0;
+
+Rd = CCBF_LOAD_RLX(p_circ -> Ring.RdPos); // our own index
+Wr = CCBF_LOAD_ACQ(p_circ -> Ring.WrPos); // owned by the writer: the data must be visible before we read them
+if(Rd == Wr) {
+    return CCBF_AGAIN; // empty
+    }
+
+p_hdr = (CircBufRecHdr_t *)(p_circ -> Data + (size_t)Rd * p_circ -> Unit);
+Len = p_hdr -> Len;
+p_circ -> RdUnits = 1 + (Len + p_circ -> Unit - 1) / p_circ -> Unit;
+if(p_circ -> RdUnits > CircBufUsedCount(Rd, Wr, p_circ -> Ring.ElemInBuf)) {
+    p_circ -> RdUnits = 0;
+    return __LINE__; // corrupted header
+    }
+CircBufRecSpans(p_circ, Rd, Len, p_span);
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufRecRdRelease(CircBufRec_t *p_circ)
+{
+CCBFsize_t Nunits;
+if(p_circ == NULL){
+    return __LINE__;
+    }
+if(p_circ -> RdUnits == 0) {
+    return __LINE__; // no record peeked
+    }
+Nunits = p_circ -> RdUnits;
+p_circ -> RdUnits = 0;
+return CircBufUpdtRd(CIRCBUF(&(p_circ -> Ring)), Nunits);
+}
@@ -0,0 +1,89 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Variable-length records, on top of CircBuf_t.
+
+ Unlike the index managers, this layer knows the data buffer: it writes a small header in front of every record.
+ The buffer is cut into units of Unit bytes (a power of two >= 8: 8 for SIMD-friendly payloads, 64 for cache line / DMA alignment),
+ and the ring counts units. A record takes one unit for its header, followed by its payload rounded up to a whole number of units:
+ every payload starts on a unit boundary.
+
+ writer: CircBufRecWrReserve() -> write the payload in place, in the (at most) two spans returned -> CircBufRecWrCommit()
+ reader: CircBufRecRdPeek()    -> read the payload in place, from the (at most) two spans returned -> CircBufRecRdRelease()
+
+ There is no magic nor checksum: this is meant for trusted producers in the same process.
+ For data coming from the outside world, see the parser of Example_3.
+
+ One writer, one reader, as with CircBuf_t.
+
+ */
+
+#ifndef CIRC_BUF_REC_H
+#define CIRC_BUF_REC_H
+
+#include <stddef.h>
+#include "circ_buf.h"
+
+// header of a record: takes a whole unit in the buffer
+typedef struct CircBufRecHdr_str
+{
+  uint32_t Len; // payload length, in bytes
+  uint32_t Rsvd; // reserved, 0
+} CircBufRecHdr_t;
+
+// a part of the payload of a record
+typedef struct CircBufRecSpan_str
+{
+  uint8_t *ptr;
+  size_t len; // in bytes, 0 if the span is not used
+} CircBufRecSpan_t;
+
+typedef struct CircBufRec_str
+{
+  CircBuf_t Ring; // index manager, counting units
+  uint8_t *Data; // caller provided: ElemInBuf units of Unit bytes
+  CCBFsize_t Unit; // size of a unit in bytes, power of two >= sizeof(CircBufRecHdr_t)
+
+  CCBFsize_t WrUnits; // units of the pending reservation (header included), only used by the writer
+  CCBFsize_t RdUnits; // units of the record being read (header included), only used by the reader
+
+} CircBufRec_t;
+
+#define CIRCBUFREC(x) ((CircBufRec_t *)x)
+
+
+// Data : buffer of Nunits * Unit bytes, aligned on Unit bytes, that must live as long as the record layer
+// Nunits : size of the ring in units, must be >= 3 (the largest payload is (Nunits - 2) * Unit bytes)
+// Unit : 8, 16, 32, 64 ...
+int CircBufRecInit(CircBufRec_t *p_circ, void *Data, CCBFsize_t Nunits, CCBFsize_t Unit);
+
+//
+// Reserves a record with a payload of Len bytes. (*p_span)[0] and (*p_span)[1] receive where to write the payload.
+//
+// returns 0 if the record has been reserved, CCBF_AGAIN if there is not enough space (nothing reserved), an error code (> 0) otherwise.
+//
+int CircBufRecWrReserve(CircBufRec_t *p_circ, size_t Len, CircBufRecSpan_t (*p_span)[2]);
+
+//
+// Publishes the record reserved last: the reader can get it.
+//
+int CircBufRecWrCommit(CircBufRec_t *p_circ);
+
+//
+// Gets the oldest record, without removing it: (*p_span)[0] and (*p_span)[1] receive its payload,
+// its length is (*p_span)[0].len + (*p_span)[1].len
+//
+// returns 0 if a record is there, CCBF_AGAIN if the buffer is empty, an error code (> 0) otherwise.
+//
+int CircBufRecRdPeek(CircBufRec_t *p_circ, CircBufRecSpan_t (*p_span)[2]);
+
+//
+// Removes the record returned by the last CircBufRecRdPeek(): its space goes back to the writer.
+//
+int CircBufRecRdRelease(CircBufRec_t *p_circ);
+
+#endif // CIRC_BUF_REC_H
@@ -0,0 +1,297 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Creation: the segment is sized and filled, and Ready is stored last (release). A process that attaches
+ loads Ready first (acquire): if it is set, the rest of the header is valid.
+
+ A dead owner is detected with kill(pid, 0) == ESRCH. Its side is taken over with a compare and exchange on Owner,
+ so that two processes cannot both take it. A zombie counts as alive until its parent reaps it,
+ and a pid reused by an unrelated process keeps the side owned.
+
+ */
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "circ_buf_shm.h"
+
+#define CCBF_SHM_ALIGN(x) ((((x) + CCBF_CACHE_LINE - 1) / CCBF_CACHE_LINE) * CCBF_CACHE_LINE)
+
+// ==============================================================================
+
+//
+// undoes a failed creation
+//
+static int CircBufShmUndo(CircBufShm_t *p_shm, const char *Name, int err)
+{
+if(p_shm -> p_Hdr != NULL) {
+    munmap(p_shm -> p_Hdr, p_shm -> MapSize);
+    p_shm -> p_Hdr = NULL;
+    p_shm -> p_Ring = NULL;
+    }
+close(p_shm -> Fd);
+p_shm -> Fd = -1;
+if(Name != NULL) {
+    shm_unlink(Name);
+    }
+return err;
+}
+
+// ==============================================================================
+
+int CircBufShmCreate(CircBufShm_t *p_shm, const char *Name, CCBFsize_t SizeOfBuf, const size_t *ElemSize, unsigned Narrays)
+{
+CircBufShmHdr_t *p_hdr;
+uint64_t Off, RingOff, ArrayOff[CCBF_SHM_MAX_ARRAYS];
+unsigned i;
+int err;
+
+if((p_shm == NULL) || (SizeOfBuf < 2) || (Narrays > CCBF_SHM_MAX_ARRAYS) || ((Narrays > 0) && (ElemSize == NULL))) {
+    return __LINE__;
+    }
+p_shm -> p_Hdr = NULL;
+p_shm -> p_Ring = NULL;
+p_shm -> Fd = -1;
+
+// layout: header, ring, arrays, each on its own cache lines
+RingOff = CCBF_SHM_ALIGN(sizeof(CircBufShmHdr_t));
+Off = CCBF_SHM_ALIGN(RingOff + sizeof(CircBufSpsc_t));
+for(i = 0; i < Narrays; i++) {
+    if((ElemSize[i] == 0) || (ElemSize[i] > (UINT64_MAX / 2) / SizeOfBuf)) {
+        return __LINE__;
+        }
+    ArrayOff[i] = Off;
+    Off = CCBF_SHM_ALIGN(Off + (uint64_t)ElemSize[i] * SizeOfBuf);
+    }
+
+if(Name != NULL) {
+    p_shm -> Fd = shm_open(Name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    } else {
+    p_shm -> Fd = memfd_create("circ_buf_shm", MFD_CLOEXEC);
+    }
+if(p_shm -> Fd < 0) {
+    return __LINE__;
+    }
+if(ftruncate(p_shm -> Fd, Off) != 0) {
+    return CircBufShmUndo(p_shm, Name, __LINE__);
+    }
+p_hdr = mmap(NULL, Off, PROT_READ | PROT_WRITE, MAP_SHARED, p_shm -> Fd, 0);
+if(p_hdr == MAP_FAILED) {
+    return CircBufShmUndo(p_shm, Name, __LINE__);
+    }
+p_shm -> p_Hdr = p_hdr;
+p_shm -> MapSize = Off;
+p_shm -> p_Ring = (CircBufSpsc_t *)((uint8_t *)p_hdr + RingOff);
+
+// the new file is filled with zeros: Ready == 0, no owner
+if((err = CircBufSpscInit(p_shm -> p_Ring, SizeOfBuf)) != 0) {
+    return CircBufShmUndo(p_shm, Name, err);
+    }
+p_hdr -> Magic = CCBF_SHM_MAGIC;
+p_hdr -> Version = CCBF_SHM_VERSION;
+p_hdr -> HdrSize = sizeof(CircBufShmHdr_t);
+p_hdr -> CacheLine = CCBF_CACHE_LINE;
+p_hdr -> IndexSize = sizeof(CCBFsize_t);
+p_hdr -> Narrays = Narrays;
+p_hdr -> ElemInBuf = SizeOfBuf;
+p_hdr -> SegSize = Off;
+p_hdr -> RingOff = RingOff;
+for(i = 0; i < Narrays; i++) {
+    p_hdr -> ArrayOff[i] = ArrayOff[i];
+    p_hdr -> ElemSize[i] = ElemSize[i];
+    }
+atomic_store_explicit(&(p_hdr -> Ready), 1, memory_order_release);
+return 0;
+}
+
+// ==============================================================================
+
+//
+// maps the segment of p_shm -> Fd and checks its header
+//
+static int CircBufShmMap(CircBufShm_t *p_shm)
+{
+CircBufShmHdr_t *p_hdr;
+struct stat st;
+unsigned i;
+int err = 0;
+
+if(fstat(p_shm -> Fd, &st) != 0) {
+    return __LINE__;
+    }
+if((size_t)st.st_size < sizeof(CircBufShmHdr_t)) {
+    return CCBF_AGAIN; // not sized yet by its creator
+    }
+p_hdr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, p_shm -> Fd, 0);
+if(p_hdr == MAP_FAILED) {
+    return __LINE__;
+    }
+if(atomic_load_explicit(&(p_hdr -> Ready), memory_order_acquire) == 0) {
+    err = CCBF_AGAIN;
+    } else if((p_hdr -> Magic != CCBF_SHM_MAGIC) || (p_hdr -> Version != CCBF_SHM_VERSION)) {
+    err = __LINE__;
+    } else if((p_hdr -> HdrSize != sizeof(CircBufShmHdr_t)) || (p_hdr -> CacheLine != CCBF_CACHE_LINE) || (p_hdr -> IndexSize != sizeof(CCBFsize_t))) {
+    err = __LINE__; // built with other parameters
+    } else if((p_hdr -> SegSize != (uint64_t)st.st_size) || (p_hdr -> Narrays > CCBF_SHM_MAX_ARRAYS) ||
+              (p_hdr -> RingOff + sizeof(CircBufSpsc_t) > p_hdr -> SegSize) || (p_hdr -> RingOff % CCBF_CACHE_LINE != 0)) {
+    err = __LINE__;
+    }
+for(i = 0; (err == 0) && (i < p_hdr -> Narrays); i++) {
+    if(p_hdr -> ArrayOff[i] + p_hdr -> ElemSize[i] * p_hdr -> ElemInBuf > p_hdr -> SegSize) {
+        err = __LINE__;
+        }
+    }
+if(err != 0) {
+    munmap(p_hdr, st.st_size);
+    return err;
+    }
+p_shm -> p_Hdr = p_hdr;
+p_shm -> MapSize = st.st_size;
+p_shm -> p_Ring = (CircBufSpsc_t *)((uint8_t *)p_hdr + p_hdr -> RingOff);
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufShmAttach(CircBufShm_t *p_shm, const char *Name)
+{
+int err;
+if((p_shm == NULL) || (Name == NULL)) {
+    return __LINE__;
+    }
+p_shm -> p_Hdr = NULL;
+p_shm -> p_Ring = NULL;
+p_shm -> Fd = shm_open(Name, O_RDWR, 0);
+if(p_shm -> Fd < 0) {
+    return __LINE__;
+    }
+if((err = CircBufShmMap(p_shm)) != 0) {
+    close(p_shm -> Fd);
+    p_shm -> Fd = -1;
+    }
+return err;
+}
+
+// ==============================================================================
+
+int CircBufShmAttachFd(CircBufShm_t *p_shm, int Fd)
+{
+int err;
+if((p_shm == NULL) || (Fd < 0)) {
+    return __LINE__;
+    }
+p_shm -> p_Hdr = NULL;
+p_shm -> p_Ring = NULL;
+p_shm -> Fd = fcntl(Fd, F_DUPFD_CLOEXEC, 0);
+if(p_shm -> Fd < 0) {
+    return __LINE__;
+    }
+if((err = CircBufShmMap(p_shm)) != 0) {
+    close(p_shm -> Fd);
+    p_shm -> Fd = -1;
+    }
+return err;
+}
+
+// ==============================================================================
+
+int CircBufShmDetach(CircBufShm_t *p_shm)
+{
+if((p_shm == NULL) || (p_shm -> p_Hdr == NULL)) {
+    return __LINE__;
+    }
+CircBufShmRelease(p_shm, CCBF_WR);
+CircBufShmRelease(p_shm, CCBF_RD);
+if(munmap(p_shm -> p_Hdr, p_shm -> MapSize) != 0) {
+    return __LINE__;
+    }
+close(p_shm -> Fd);
+p_shm -> p_Hdr = NULL;
+p_shm -> p_Ring = NULL;
+p_shm -> Fd = -1;
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufShmUnlink(const char *Name)
+{
+if(Name == NULL) {
+    return __LINE__;
+    }
+return (shm_unlink(Name) == 0) ? 0 : __LINE__;
+}
+
+// ==============================================================================
+
+void *CircBufShmArray(CircBufShm_t *p_shm, unsigned Id)
+{
+if((p_shm == NULL) || (p_shm -> p_Hdr == NULL) || (Id >= p_shm -> p_Hdr -> Narrays)) {
+    return NULL;
+    }
+return (uint8_t *)p_shm -> p_Hdr + p_shm -> p_Hdr -> ArrayOff[Id];
+}
+
+// ==============================================================================
+
+int CircBufShmClaim(CircBufShm_t *p_shm, int Side)
+{
+uint32_t Me = getpid(), Owner;
+CircBufSpsc_t *p_ring;
+
+if((p_shm == NULL) || (p_shm -> p_Hdr == NULL) || ((Side != CCBF_WR) && (Side != CCBF_RD))) {
+    return __LINE__;
+    }
+Owner = atomic_load(&(p_shm -> p_Hdr -> Side[Side].Owner));
+do {
+    if(Owner == Me) {
+        return 0; // already ours
+        }
+    if((Owner != 0) && ((kill(Owner, 0) == 0) || (errno != ESRCH))) {
+        return CCBF_AGAIN; // alive
+        }
+   } while(!atomic_compare_exchange_weak(&(p_shm -> p_Hdr -> Side[Side].Owner), &Owner, Me));
+
+atomic_fetch_add(&(p_shm -> p_Hdr -> Side[Side].Epoch), 1);
+
+// the cached copy of the other index belongs to this side: start again from the shared index
+p_ring = p_shm -> p_Ring;
+if(Side == CCBF_WR) {
+    p_ring -> Wr.RdCache = CCBF_LOAD_ACQ(p_ring -> Rd.RdPos);
+    } else {
+    p_ring -> Rd.WrCache = CCBF_LOAD_ACQ(p_ring -> Wr.WrPos);
+    }
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufShmRelease(CircBufShm_t *p_shm, int Side)
+{
+uint32_t Me = getpid();
+if((p_shm == NULL) || (p_shm -> p_Hdr == NULL) || ((Side != CCBF_WR) && (Side != CCBF_RD))) {
+    return __LINE__;
+    }
+if(!atomic_compare_exchange_strong(&(p_shm -> p_Hdr -> Side[Side].Owner), &Me, 0)) {
+    return __LINE__; // not ours
+    }
+return 0;
+}
+
+// ==============================================================================
+
+uint32_t CircBufShmEpoch(CircBufShm_t *p_shm, int Side)
+{
+return atomic_load_explicit(&(p_shm -> p_Hdr -> Side[Side].Epoch), memory_order_acquire);
+}
@@ -0,0 +1,129 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Process-shared ring (POSIX shared memory): the index manager and its data arrays in one shared segment,
+ for a writer and a reader running in different processes.
+
+ The segment holds a CircBufSpsc_t (each side's index on its own cache line) and up to CCBF_SHM_MAX_ARRAYS data arrays
+ of ElemInBuf elements each. It contains no pointer: every part is found from its offset in the header,
+ so each process may map it at a different address. The header carries a version and the build parameters
+ (cache line, index size): a process built with other parameters cannot attach.
+
+ Named segments (shm_open) are attached by name. Anonymous ones (memfd) are attached through their file descriptor,
+ inherited with fork() or passed on a unix socket.
+
+ Recovery: each side is claimed by a process (CircBufShmClaim()). The side of a process that died can be claimed by another one:
+   - a new writer continues at WrPos: whatever the dead one wrote without committing it is lost,
+   - a new reader continues at RdPos: what the dead one read without committing it is delivered again.
+ The epoch of a side counts its owners, so that the other side can notice a restart.
+
+ Linux only. Requires CCBF_ATOMICS=1.
+
+ */
+
+#ifndef CIRC_BUF_SHM_H
+#define CIRC_BUF_SHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "circ_buf.h"
+#include "circ_buf_spsc.h"
+
+#if !CCBF_ATOMICS
+#error "circ_buf_shm.h requires CCBF_ATOMICS=1 (see custom_circ_buf.h)"
+#endif
+
+#define CCBF_SHM_MAGIC 0x46424343u // "CCBF"
+#define CCBF_SHM_VERSION 1
+#define CCBF_SHM_MAX_ARRAYS 8
+
+// start of the segment
+typedef struct CircBufShmHdr_str
+{
+  _Atomic uint32_t Ready; // != 0 once the segment has been initialized
+  uint32_t Magic; // CCBF_SHM_MAGIC
+  uint32_t Version; // CCBF_SHM_VERSION
+  uint32_t HdrSize; // sizeof(CircBufShmHdr_t)
+  uint32_t CacheLine; // CCBF_CACHE_LINE
+  uint32_t IndexSize; // sizeof(CCBFsize_t)
+  uint32_t Narrays;
+  CCBFsize_t ElemInBuf;
+  uint64_t SegSize; // bytes
+  uint64_t RingOff; // offset of the CircBufSpsc_t
+  uint64_t ArrayOff[CCBF_SHM_MAX_ARRAYS]; // offset of each data array
+  uint64_t ElemSize[CCBF_SHM_MAX_ARRAYS]; // size of its elements in bytes
+
+  // indexed by CCBF_RD / CCBF_WR:
+  struct {
+    _Atomic uint32_t Owner; // pid of the process that claimed the side, 0 if none
+    _Atomic uint32_t Epoch; // number of times the side has been claimed
+  } __attribute__((aligned(CCBF_CACHE_LINE))) Side[2];
+
+} CircBufShmHdr_t;
+
+// handle, local to the process
+typedef struct CircBufShm_str
+{
+  CircBufShmHdr_t *p_Hdr; // the mapping
+  size_t MapSize;
+  int Fd;
+  CircBufSpsc_t *p_Ring; // in the mapping: use the CircBufSpsc*() functions on it
+} CircBufShm_t;
+
+#define CIRCBUFSHM(x) ((CircBufShm_t *)x)
+
+
+//
+// Creates and maps a segment for a ring of SizeOfBuf elements (>= 2) and Narrays data arrays, ElemSize[i] bytes per element in array i.
+// Name : shm_open() name ("/something"), the segment must not exist. NULL : anonymous segment (memfd).
+//
+// returns 0 if no error.
+//
+int CircBufShmCreate(CircBufShm_t *p_shm, const char *Name, CCBFsize_t SizeOfBuf, const size_t *ElemSize, unsigned Narrays);
+
+//
+// Maps an existing segment, by name or by file descriptor (the descriptor is duplicated).
+//
+// returns 0 if no error, CCBF_AGAIN if the segment is still being initialized by its creator, an error code (> 0) otherwise.
+//
+int CircBufShmAttach(CircBufShm_t *p_shm, const char *Name);
+int CircBufShmAttachFd(CircBufShm_t *p_shm, int Fd);
+
+//
+// Releases the sides claimed by this process, and unmaps the segment.
+//
+int CircBufShmDetach(CircBufShm_t *p_shm);
+
+//
+// Removes the name of a segment created with a name. The processes that have it mapped keep it until they detach.
+//
+int CircBufShmUnlink(const char *Name);
+
+//
+// Data array Id (first element), NULL if it does not exist
+//
+void *CircBufShmArray(CircBufShm_t *p_shm, unsigned Id);
+
+//
+// Side : CCBF_WR or CCBF_RD
+// Claims the side for this process. Takes it over if its owner is dead, and resynchronizes the side's copy of the other index.
+//
+// returns 0 if no error, CCBF_AGAIN if the side is owned by another live process, an error code (> 0) otherwise.
+//
+int CircBufShmClaim(CircBufShm_t *p_shm, int Side);
+
+//
+// Releases a side claimed by this process.
+//
+int CircBufShmRelease(CircBufShm_t *p_shm, int Side);
+
+//
+// Number of times the side has been claimed: changes when the other process restarts.
+//
+uint32_t CircBufShmEpoch(CircBufShm_t *p_shm, int Side);
+
+#endif // CIRC_BUF_SHM_H
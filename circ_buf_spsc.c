@@ -0,0 +1,152 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+ */
+
+#include <stddef.h>
+#include "circ_buf_spsc.h"
+
+// ==============================================================================
+
+// SizeOfBuf : in elements (NOT bytes!) must be >= 2
+int CircBufSpscInit(CircBufSpsc_t *p_circ, CCBFsize_t SizeOfBuf)
+{
+if(SizeOfBuf < 2) {
+    return __LINE__;
+    }
+if(CCBFbigsizeMAX / 2 < SizeOfBuf) {
+    return __LINE__; // we need that type to hold up to twice the value of ElemInBuf
+    }
+if(p_circ == NULL){
+    return __LINE__;
+    }
+if(((uintptr_t)p_circ) % CCBF_CACHE_LINE != 0) {
+    return __LINE__; // the two sides would share cache lines
+    }
+p_circ -> Wr.ElemInBuf = SizeOfBuf;
+p_circ -> Wr.RdCache = 0;
+p_circ -> Wr.WrLast = 0;
+CCBF_STORE_RLX(p_circ -> Wr.WrPos, 0);
+p_circ -> Rd.ElemInBuf = SizeOfBuf;
+p_circ -> Rd.WrCache = 0;
+p_circ -> Rd.RdLast = 0;
+CCBF_STORE_RLX(p_circ -> Rd.RdPos, 0);
+return 0;
+}
+
+// ==============================================================================
+
+//
+// returns the buffers where data can be written
+//
+// returns 0 if no error.
+//
+int CircBufSpscWrInd(CircBufSpsc_t *p_circ, CCBFsize_t (*p)[2][2])
+{
+CCBFsize_t Wr, NextWr;
+
+if(p == NULL) {
+    return __LINE__;
+    }
+if(p_circ == NULL){
+    (*p)[0][0] = 1; // set empty ranges
+    (*p)[0][1] = 0;
+    (*p)[1][0] = 1;
+    (*p)[1][1] = 0;
+    return __LINE__;
+    }
+
+Wr = CCBF_LOAD_RLX(p_circ -> Wr.WrPos); // our own index
+NextWr = Wr + 1;
+if(NextWr == p_circ -> Wr.ElemInBuf) NextWr = 0;
+
+// only go to the reader's cache line when our copy says that the buffer is full,
+// or when nothing was written since the previous call (the caller waits for more space than our copy gives):
+if((NextWr == p_circ -> Wr.RdCache) || (Wr == p_circ -> Wr.WrLast)) {
+    p_circ -> Wr.RdCache = CCBF_LOAD_ACQ(p_circ -> Rd.RdPos);
+    }
+p_circ -> Wr.WrLast = Wr;
+
+CircBufWrRange(p_circ -> Wr.RdCache, Wr, p_circ -> Wr.ElemInBuf, p);
+return 0;
+}
+
+// ==============================================================================
+
+//
+// returns the buffers where data can be read
+//
+// returns 0 if no error.
+//
+int CircBufSpscRdInd(CircBufSpsc_t *p_circ, CCBFsize_t (*p)[2][2])
+{
+CCBFsize_t Rd;
+
+if(p == NULL) {
+    return __LINE__;
+    }
+if(p_circ == NULL){
+    (*p)[0][0] = 1; // set empty ranges
+    (*p)[0][1] = 0;
+    (*p)[1][0] = 1;
+    (*p)[1][1] = 0;
+    return __LINE__;
+    }
+
+Rd = CCBF_LOAD_RLX(p_circ -> Rd.RdPos); // our own index
+
+// only go to the writer's cache line when our copy says that the buffer is empty,
+// or when nothing was read since the previous call (the caller waits for more data than our copy gives):
+if((Rd == p_circ -> Rd.WrCache) || (Rd == p_circ -> Rd.RdLast)) {
+    p_circ -> Rd.WrCache = CCBF_LOAD_ACQ(p_circ -> Wr.WrPos);
+    }
+p_circ -> Rd.RdLast = Rd;
+
+CircBufRdRange(Rd, p_circ -> Rd.WrCache, p_circ -> Rd.ElemInBuf, p);
+return 0;
+}
+
+// ==============================================================================
+
+//
+// Updates the buffer as Nconsumed items have been inserted in the buffer
+//
+int CircBufSpscUpdtWr(CircBufSpsc_t *p_circ, CCBFsize_t Nconsumed)
+{
+CCBFbigsize_t Wr;  // here we need to store up to almost twice the maximum buffer size !
+if(p_circ == NULL){
+    return __LINE__;
+    }
+if(Nconsumed >= p_circ -> Wr.ElemInBuf) {
+    return __LINE__;
+    }
+Wr = CCBF_LOAD_RLX(p_circ -> Wr.WrPos);
+Wr += Nconsumed;
+if(Wr >= p_circ -> Wr.ElemInBuf) Wr = Wr - p_circ -> Wr.ElemInBuf;
+CCBF_STORE_REL(p_circ -> Wr.WrPos, Wr); // publishes the data written before this call
+return 0;
+}
+
+// ==============================================================================
+
+//
+// Updates the buffer as Nconsumed items have been deleted from the buffer
+//
+int CircBufSpscUpdtRd(CircBufSpsc_t *p_circ, CCBFsize_t Nconsumed)
+{
+CCBFbigsize_t Rd;  // here we need to store up to almost twice the maximum buffer size !
+if(p_circ == NULL){
+    return __LINE__;
+    }
+if(Nconsumed >= p_circ -> Rd.ElemInBuf) {
+    return __LINE__;
+    }
+Rd = CCBF_LOAD_RLX(p_circ -> Rd.RdPos);
+Rd += Nconsumed;
+if(Rd >= p_circ -> Rd.ElemInBuf) Rd = Rd - p_circ -> Rd.ElemInBuf;
+CCBF_STORE_REL(p_circ -> Rd.RdPos, Rd); // frees the space only after the data have been read
+return 0;
+}
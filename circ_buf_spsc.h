@@ -0,0 +1,75 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Single producer / single consumer variant of CircBuf_t, with the same API and the same semantics (one element is always left unused).
+
+ The data owned by the writer and the data owned by the reader are kept on separate cache lines,
+ so that the two cores don't fight over a single line on every call.
+ Each side also keeps a private copy of the other side's index, and only re-reads the shared one when
+ its copy says that the buffer is full (writer) or empty (reader), or when its own index has not moved since its previous call:
+ a side that waits for more than what its copy gives (a fixed size batch, a whole header) sees the new space on the next call.
+
+ The structure must be aligned on CCBF_CACHE_LINE: declare it static or on the stack, or allocate it with aligned_alloc().
+
+ */
+
+#ifndef CIRC_BUF_SPSC_H
+#define CIRC_BUF_SPSC_H
+
+#include "circ_buf.h"
+
+typedef struct CircBufSpsc_str
+{
+  // written by the writer only:
+  struct {
+    CCBFsize_t ElemInBuf; // copy of the buffer size, so that the writer never needs the reader's line
+    CCBFvolsize_t WrPos; // next index to write
+    CCBFsize_t RdCache; // writer's copy of RdPos
+    CCBFsize_t WrLast; // WrPos at the previous CircBufSpscWrInd()
+  } __attribute__((aligned(CCBF_CACHE_LINE))) Wr;
+
+  // written by the reader only:
+  struct {
+    CCBFsize_t ElemInBuf; // copy of the buffer size, so that the reader never needs the writer's line
+    CCBFvolsize_t RdPos; // start index of valid data in buffer
+    CCBFsize_t WrCache; // reader's copy of WrPos
+    CCBFsize_t RdLast; // RdPos at the previous CircBufSpscRdInd()
+  } __attribute__((aligned(CCBF_CACHE_LINE))) Rd;
+
+} CircBufSpsc_t;
+
+#define CIRCBUFSPSC(x) ((CircBufSpsc_t *)x)
+
+
+// SizeOfBuf : in elements (NOT bytes!)
+int CircBufSpscInit(CircBufSpsc_t *p_circ, CCBFsize_t SizeOfBuf);
+
+//
+// returns the buffers where data can be written (writer thread only)
+//
+// returns 0 if no error.
+//
+int CircBufSpscWrInd(CircBufSpsc_t *p_circ, CCBFsize_t (*p)[2][2]);
+
+//
+// returns the buffers where data can be read (reader thread only)
+//
+// returns 0 if no error.
+//
+int CircBufSpscRdInd(CircBufSpsc_t *p_circ, CCBFsize_t (*p)[2][2]);
+
+//
+// Updates the buffer as Nconsumed items have been inserted in the buffer (writer thread only)
+//
+int CircBufSpscUpdtWr(CircBufSpsc_t *p_circ, CCBFsize_t Nconsumed);
+
+//
+// Updates the buffer as Nconsumed items have been deleted from the buffer (reader thread only)
+//
+int CircBufSpscUpdtRd(CircBufSpsc_t *p_circ, CCBFsize_t Nconsumed);
+
+#endif // CIRC_BUF_SPSC_H
@@ -0,0 +1,169 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+ */
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "circ_buf_trace.h"
+
+static CircBufTrace_t *volatile CircBufTraceCur = NULL; // the running recorder
+static __thread uint32_t CircBufTraceTid = 0; // cached: no system call per event
+
+// ==============================================================================
+
+//
+// the hook of the trace points (circ_buf.c)
+//
+static void CircBufTraceRecord(int Event, const CircBuf_t *p_circ, CCBFsize_t Rd, CCBFsize_t Wr, CCBFsize_t N)
+{
+CircBufTrace_t *p_trace = CircBufTraceCur;
+CircBufTraceRec_t *p_rec;
+struct timespec ts;
+uint64_t k;
+
+if(p_trace == NULL) {
+    return;
+    }
+k = atomic_fetch_add_explicit(&(p_trace -> Next), 1, memory_order_relaxed);
+if(k >= p_trace -> Capacity) {
+    return; // dropped
+    }
+if(CircBufTraceTid == 0) {
+    CircBufTraceTid = syscall(SYS_gettid);
+    }
+clock_gettime(CLOCK_MONOTONIC, &ts);
+p_rec = p_trace -> Recs + k;
+p_rec -> TimeNs = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+p_rec -> Ring = (uintptr_t)p_circ;
+p_rec -> Event = Event;
+p_rec -> Tid = CircBufTraceTid;
+p_rec -> ElemInBuf = p_circ -> ElemInBuf;
+p_rec -> Rd = Rd;
+p_rec -> Wr = Wr;
+p_rec -> N = N;
+}
+
+// ==============================================================================
+
+int CircBufTraceStart(CircBufTrace_t *p_trace, CircBufTraceRec_t *Recs, uint64_t Capacity)
+{
+if((p_trace == NULL) || (Recs == NULL) || (Capacity == 0)) {
+    return __LINE__;
+    }
+if((CircBufTraceCur != NULL) || (CircBufTraceHook != NULL)) {
+    return __LINE__; // one recorder at a time
+    }
+p_trace -> Recs = Recs;
+p_trace -> Capacity = Capacity;
+atomic_store(&(p_trace -> Next), 0);
+CircBufTraceCur = p_trace;
+atomic_thread_fence(memory_order_seq_cst);
+CircBufTraceHook = CircBufTraceRecord;
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufTraceStop(CircBufTrace_t *p_trace)
+{
+if((p_trace == NULL) || (CircBufTraceCur != p_trace)) {
+    return __LINE__;
+    }
+CircBufTraceHook = NULL;
+CircBufTraceCur = NULL;
+atomic_thread_fence(memory_order_seq_cst);
+return 0;
+}
+
+// ==============================================================================
+
+uint64_t CircBufTraceCount(CircBufTrace_t *p_trace)
+{
+uint64_t n = atomic_load(&(p_trace -> Next));
+return (n < p_trace -> Capacity) ? n : p_trace -> Capacity;
+}
+
+uint64_t CircBufTraceDropped(CircBufTrace_t *p_trace)
+{
+return atomic_load(&(p_trace -> Next)) - CircBufTraceCount(p_trace);
+}
+
+// ==============================================================================
+
+int CircBufTraceSave(CircBufTrace_t *p_trace, const char *Path)
+{
+CircBufTraceHdr_t hdr = {0};
+FILE *f;
+int err = 0;
+
+if((p_trace == NULL) || (Path == NULL)) {
+    return __LINE__;
+    }
+hdr.Magic = CCBF_TRACE_MAGIC;
+hdr.Version = CCBF_TRACE_VERSION;
+hdr.RecSize = sizeof(CircBufTraceRec_t);
+hdr.Count = CircBufTraceCount(p_trace);
+hdr.Dropped = CircBufTraceDropped(p_trace);
+
+f = fopen(Path, "wb");
+if(f == NULL) {
+    return __LINE__;
+    }
+if(fwrite(&hdr, sizeof(hdr), 1, f) != 1) {
+    err = __LINE__;
+    } else if((hdr.Count > 0) && (fwrite(p_trace -> Recs, sizeof(CircBufTraceRec_t), hdr.Count, f) != hdr.Count)) {
+    err = __LINE__;
+    }
+if(fclose(f) != 0) {
+    err = __LINE__;
+    }
+return err;
+}
+
+// ==============================================================================
+
+int CircBufTraceLoad(const char *Path, CircBufTraceRec_t **p_recs, uint64_t *p_count, uint64_t *p_dropped)
+{
+CircBufTraceHdr_t hdr;
+CircBufTraceRec_t *Recs = NULL;
+FILE *f;
+int err = 0;
+
+if((Path == NULL) || (p_recs == NULL) || (p_count == NULL) || (p_dropped == NULL)) {
+    return __LINE__;
+    }
+f = fopen(Path, "rb");
+if(f == NULL) {
+    return __LINE__;
+    }
+if(fread(&hdr, sizeof(hdr), 1, f) != 1) {
+    err = __LINE__;
+    } else if((hdr.Magic != CCBF_TRACE_MAGIC) || (hdr.Version != CCBF_TRACE_VERSION) || (hdr.RecSize != sizeof(CircBufTraceRec_t))) {
+    err = __LINE__;
+    } else if(hdr.Count > SIZE_MAX / sizeof(CircBufTraceRec_t)) {
+    err = __LINE__;
+    } else if((Recs = malloc(hdr.Count * sizeof(CircBufTraceRec_t) + 1)) == NULL) {
+    err = __LINE__;
+    } else if(fread(Recs, sizeof(CircBufTraceRec_t), hdr.Count, f) != hdr.Count) {
+    err = __LINE__; // truncated
+    }
+fclose(f);
+if(err != 0) {
+    free(Recs);
+    return err;
+    }
+*p_recs = Recs;
+*p_count = hdr.Count;
+*p_dropped = hdr.Dropped;
+return 0;
+}
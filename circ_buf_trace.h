@@ -0,0 +1,108 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ In-process trace recorder for the trace points of circ_buf.c (build with CCBF_TRACE=1, see custom_circ_buf.h).
+
+ Once started, every CircBufWrInd(), CircBufRdInd(), CircBufUpdtWr() and CircBufUpdtRd() of the process, on any ring,
+ appends a fixed size record (time, ring, indexes, count) to a caller-provided array. A slot is claimed with one atomic
+ increment: the threads never wait for each other. When the array is full, the following events are counted as dropped.
+
+ The capture is saved in a binary file (CircBufTraceSave()) after CircBufTraceStop(), once the traced threads are done
+ with their current call. Tools/ccbf_trace rebuilds the occupancy of each ring over time, the full / empty intervals,
+ and the producer / consumer rates from such a file.
+
+ Without the recorder, the same trace points are USDT probes (ccbf:wr_ind ...) when <sys/sdt.h> is available:
+ arguments ring, Rd, Wr, ElemInBuf, N.
+
+ One recorder at a time in a process. Requires CCBF_ATOMICS=1.
+
+ */
+
+#ifndef CIRC_BUF_TRACE_H
+#define CIRC_BUF_TRACE_H
+
+#include <stdint.h>
+#include "circ_buf.h"
+
+#if !CCBF_ATOMICS
+#error "circ_buf_trace.h requires CCBF_ATOMICS=1 (see custom_circ_buf.h)"
+#endif
+#if !CCBF_TRACE
+#error "circ_buf_trace.h requires CCBF_TRACE=1 (see custom_circ_buf.h)"
+#endif
+
+#define CCBF_TRACE_MAGIC 0x52544343u // "CCTR"
+#define CCBF_TRACE_VERSION 1
+
+// one event, as saved in the file
+typedef struct CircBufTraceRec_str
+{
+  uint64_t TimeNs; // CLOCK_MONOTONIC
+  uint64_t Ring; // address of the CircBuf_t: identifies the ring
+  uint32_t Event; // CCBF_TRACE_WRIND ... (circ_buf.h)
+  uint32_t Tid; // thread id (Linux)
+  uint32_t ElemInBuf;
+  uint32_t Rd; // indexes seen by the call (see circ_buf.h)
+  uint32_t Wr;
+  uint32_t N;
+} CircBufTraceRec_t;
+
+// start of the file, followed by Count records
+typedef struct CircBufTraceHdr_str
+{
+  uint32_t Magic; // CCBF_TRACE_MAGIC
+  uint32_t Version; // CCBF_TRACE_VERSION
+  uint32_t RecSize; // sizeof(CircBufTraceRec_t)
+  uint32_t Reserved;
+  uint64_t Count; // records in the file
+  uint64_t Dropped; // events lost because the array was full
+} CircBufTraceHdr_t;
+
+typedef struct CircBufTrace_str
+{
+  CircBufTraceRec_t *Recs; // caller-provided array
+  uint64_t Capacity;
+  _Atomic uint64_t Next; // events claimed so far (some may have been dropped)
+} CircBufTrace_t;
+
+#define CIRCBUFTRACE(x) ((CircBufTrace_t *)x)
+
+
+//
+// Starts recording in Recs[Capacity]: installs the hook of the trace points.
+//
+// returns 0 if no error (an error if another recorder is running).
+//
+int CircBufTraceStart(CircBufTrace_t *p_trace, CircBufTraceRec_t *Recs, uint64_t Capacity);
+
+//
+// Removes the hook. A thread may still be in the middle of recording its last event: stop the traced threads,
+// or let them finish their current call, before reading the records.
+//
+int CircBufTraceStop(CircBufTrace_t *p_trace);
+
+//
+// Number of records written (<= Capacity), and of events dropped.
+//
+uint64_t CircBufTraceCount(CircBufTrace_t *p_trace);
+uint64_t CircBufTraceDropped(CircBufTrace_t *p_trace);
+
+//
+// Writes the capture in a file.
+//
+// returns 0 if no error.
+//
+int CircBufTraceSave(CircBufTrace_t *p_trace, const char *Path);
+
+//
+// Reads a capture: *p_recs is allocated with malloc() (free() it), *p_count records, *p_dropped events dropped.
+//
+// returns 0 if no error.
+//
+int CircBufTraceLoad(const char *Path, CircBufTraceRec_t **p_recs, uint64_t *p_count, uint64_t *p_dropped);
+
+#endif // CIRC_BUF_TRACE_H
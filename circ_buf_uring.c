@@ -0,0 +1,427 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ The table of operations follows the data: operation k covers the bytes [Start, Start + Len) of the ring,
+ right after the ones of operation k - 1. Completions arrive in any order, and an operation is committed
+ only once all the previous ones are.
+
+ A positioned operation that completes partially is submitted again for the rest: a short operation that is committed
+ is the end of the file (input) or an error. Its Len - Done last bytes have not been transferred, so the following operations
+ cannot be committed anymore (Gap): they are dropped, and the next ones start again from the index of the ring.
+
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include "circ_buf_uring.h"
+
+#define CCBF_URING_CANCEL_DATA UINT64_MAX // user_data of the cancel requests
+
+// ==============================================================================
+
+static int CircBufUringSetup(unsigned Entries, struct io_uring_params *p_params)
+{
+return syscall(__NR_io_uring_setup, Entries, p_params);
+}
+
+static int CircBufUringEnter(int Fd, unsigned ToSubmit, unsigned MinComplete)
+{
+return syscall(__NR_io_uring_enter, Fd, ToSubmit, MinComplete, (MinComplete > 0) ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+// ==============================================================================
+
+static void CircBufUringUnmap(CircBufUring_t *p_ur)
+{
+if(p_ur -> Sqes != NULL) {
+    munmap(p_ur -> Sqes, p_ur -> SqesSz);
+    }
+if((p_ur -> CqMap != NULL) && (p_ur -> CqMap != p_ur -> SqMap)) {
+    munmap(p_ur -> CqMap, p_ur -> CqMapSz);
+    }
+if(p_ur -> SqMap != NULL) {
+    munmap(p_ur -> SqMap, p_ur -> SqMapSz);
+    }
+if(p_ur -> Fd >= 0) {
+    close(p_ur -> Fd);
+    }
+p_ur -> Sqes = NULL;
+p_ur -> CqMap = NULL;
+p_ur -> SqMap = NULL;
+p_ur -> Fd = -1;
+}
+
+// ==============================================================================
+
+int CircBufUringInit(CircBufUring_t *p_ur, CircBuf_t *p_ring, uint8_t *Data, int Dir, int IoFd, int64_t Offset,
+                     CircBufUringOp_t *Ops, unsigned Depth, size_t ChunkMax)
+{
+struct io_uring_params params;
+struct iovec iov;
+void *map;
+
+if((p_ur == NULL) || (p_ring == NULL) || (Data == NULL) || (Ops == NULL)) {
+    return __LINE__;
+    }
+if(((Dir != CCBF_URING_IN) && (Dir != CCBF_URING_OUT)) || (IoFd < 0) || (Depth == 0) || (ChunkMax == 0)) {
+    return __LINE__;
+    }
+memset(p_ur, 0, sizeof(*p_ur));
+p_ur -> p_Ring = p_ring;
+p_ur -> Data = Data;
+p_ur -> Dir = Dir;
+p_ur -> IoFd = IoFd;
+p_ur -> Offset = Offset;
+p_ur -> ChunkMax = ChunkMax;
+p_ur -> Ops = Ops;
+p_ur -> Depth = Depth;
+// the pump owns this index:
+p_ur -> NextPos = (Dir == CCBF_URING_IN) ? CCBF_LOAD_RLX(p_ring -> WrPos) : CCBF_LOAD_RLX(p_ring -> RdPos);
+
+memset(&params, 0, sizeof(params));
+p_ur -> Fd = CircBufUringSetup(Depth, &params); // the cancel requests of CircBufUringClose() fit in the submission queue too
+if(p_ur -> Fd < 0) {
+    return __LINE__;
+    }
+
+p_ur -> SqMapSz = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+p_ur -> CqMapSz = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+if(params.features & IORING_FEAT_SINGLE_MMAP) {
+    if(p_ur -> CqMapSz > p_ur -> SqMapSz) {
+        p_ur -> SqMapSz = p_ur -> CqMapSz;
+        }
+    p_ur -> CqMapSz = p_ur -> SqMapSz;
+    }
+map = mmap(NULL, p_ur -> SqMapSz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, p_ur -> Fd, IORING_OFF_SQ_RING);
+if(map == MAP_FAILED) {
+    CircBufUringUnmap(p_ur);
+    return __LINE__;
+    }
+p_ur -> SqMap = map;
+if(params.features & IORING_FEAT_SINGLE_MMAP) {
+    p_ur -> CqMap = p_ur -> SqMap;
+    } else {
+    map = mmap(NULL, p_ur -> CqMapSz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, p_ur -> Fd, IORING_OFF_CQ_RING);
+    if(map == MAP_FAILED) {
+        CircBufUringUnmap(p_ur);
+        return __LINE__;
+        }
+    p_ur -> CqMap = map;
+    }
+p_ur -> SqesSz = params.sq_entries * sizeof(struct io_uring_sqe);
+map = mmap(NULL, p_ur -> SqesSz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, p_ur -> Fd, IORING_OFF_SQES);
+if(map == MAP_FAILED) {
+    CircBufUringUnmap(p_ur);
+    return __LINE__;
+    }
+p_ur -> Sqes = map;
+
+p_ur -> SqHead  = (unsigned *)((uint8_t *)p_ur -> SqMap + params.sq_off.head);
+p_ur -> SqTail  = (unsigned *)((uint8_t *)p_ur -> SqMap + params.sq_off.tail);
+p_ur -> SqMask  = (unsigned *)((uint8_t *)p_ur -> SqMap + params.sq_off.ring_mask);
+p_ur -> SqArray = (unsigned *)((uint8_t *)p_ur -> SqMap + params.sq_off.array);
+p_ur -> CqHead  = (unsigned *)((uint8_t *)p_ur -> CqMap + params.cq_off.head);
+p_ur -> CqTail  = (unsigned *)((uint8_t *)p_ur -> CqMap + params.cq_off.tail);
+p_ur -> CqMask  = (unsigned *)((uint8_t *)p_ur -> CqMap + params.cq_off.ring_mask);
+p_ur -> Cqes    = (struct io_uring_cqe *)((uint8_t *)p_ur -> CqMap + params.cq_off.cqes);
+
+// fixed buffer: may fail (RLIMIT_MEMLOCK on older kernels...): the plain operations are used then
+iov.iov_base = Data;
+iov.iov_len = p_ring -> ElemInBuf;
+p_ur -> Fixed = (syscall(__NR_io_uring_register, p_ur -> Fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0);
+
+return 0;
+}
+
+// ==============================================================================
+
+//
+// writes the SQE for the bytes of the operation that have not been transferred yet
+// returns 0, or CCBF_AGAIN if the submission queue is full
+//
+static int CircBufUringPrep(CircBufUring_t *p_ur, unsigned Slot)
+{
+CircBufUringOp_t *p_op = &(p_ur -> Ops[Slot]);
+struct io_uring_sqe *sqe;
+unsigned Tail = *(p_ur -> SqTail); // only written by us
+unsigned Mask = *(p_ur -> SqMask);
+
+if(Tail - __atomic_load_n(p_ur -> SqHead, __ATOMIC_ACQUIRE) > Mask) {
+    return CCBF_AGAIN;
+    }
+sqe = &(p_ur -> Sqes[Tail & Mask]);
+memset(sqe, 0, sizeof(*sqe));
+if(p_ur -> Dir == CCBF_URING_IN) {
+    sqe -> opcode = p_ur -> Fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    } else {
+    sqe -> opcode = p_ur -> Fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    }
+sqe -> fd = p_ur -> IoFd;
+sqe -> off = (p_ur -> Offset >= 0) ? p_op -> Off + p_op -> Done : (uint64_t)-1; // -1 : current position
+sqe -> addr = (uintptr_t)(p_ur -> Data + p_op -> Start + p_op -> Done);
+sqe -> len = p_op -> Len - p_op -> Done;
+sqe -> buf_index = 0;
+sqe -> user_data = Slot;
+p_ur -> SqArray[Tail & Mask] = Tail & Mask;
+__atomic_store_n(p_ur -> SqTail, Tail + 1, __ATOMIC_RELEASE);
+
+p_op -> State = CCBF_URING_KERNEL;
+p_ur -> Nkernel++;
+return 0;
+}
+
+// ==============================================================================
+
+static void CircBufUringResult(CircBufUring_t *p_ur, CircBufUringOp_t *p_op, int Res)
+{
+if(Res < 0) {
+    if((Res == -EAGAIN) || (Res == -EINTR)) {
+        p_op -> State = CCBF_URING_RESUBMIT;
+        return;
+        }
+    if((p_ur -> Err == 0) && (Res != -ECANCELED)) { // canceled: only by CircBufUringClose()
+        p_ur -> Err = -Res;
+        }
+    p_op -> State = CCBF_URING_DONE;
+    return;
+    }
+if(Res == 0) {
+    if(p_ur -> Dir == CCBF_URING_IN) {
+        p_ur -> Eof = 1;
+        } else if(p_ur -> Err == 0) {
+        p_ur -> Err = EIO; // nothing written
+        }
+    p_op -> State = CCBF_URING_DONE;
+    return;
+    }
+p_op -> Done += Res;
+if((p_op -> Done < p_op -> Len) && (p_ur -> Offset >= 0)) {
+    p_op -> State = CCBF_URING_RESUBMIT;
+    return;
+    }
+p_op -> State = CCBF_URING_DONE; // a stream operation may be short
+}
+
+// ==============================================================================
+
+static void CircBufUringReap(CircBufUring_t *p_ur)
+{
+unsigned Head = *(p_ur -> CqHead); // only written by us
+unsigned Tail = __atomic_load_n(p_ur -> CqTail, __ATOMIC_ACQUIRE);
+struct io_uring_cqe *cqe;
+
+for(; Head != Tail; Head++) {
+    cqe = &(p_ur -> Cqes[Head & *(p_ur -> CqMask)]);
+    if(cqe -> user_data == CCBF_URING_CANCEL_DATA) {
+        continue;
+        }
+    p_ur -> Nkernel--;
+    CircBufUringResult(p_ur, &(p_ur -> Ops[cqe -> user_data]), cqe -> res);
+    }
+__atomic_store_n(p_ur -> CqHead, Head, __ATOMIC_RELEASE);
+}
+
+// ==============================================================================
+
+//
+// commits the completed operations, in order
+//
+static int CircBufUringCommit(CircBufUring_t *p_ur, CCBFsize_t *p_n)
+{
+CircBufUringOp_t *p_op;
+int err;
+
+while(p_ur -> OpHead != p_ur -> OpTail) {
+    p_op = &(p_ur -> Ops[p_ur -> OpHead % p_ur -> Depth]);
+    if(p_op -> State != CCBF_URING_DONE) {
+        break;
+        }
+    if(!(p_ur -> Gap) && (p_op -> Done > 0)) {
+        if(p_ur -> Dir == CCBF_URING_IN) {
+            err = CircBufUpdtWr(p_ur -> p_Ring, p_op -> Done);
+            } else {
+            err = CircBufUpdtRd(p_ur -> p_Ring, p_op -> Done);
+            }
+        if(err != 0) {
+            return err;
+            }
+        *p_n += p_op -> Done;
+        }
+    if(p_op -> Done < p_op -> Len) {
+        p_ur -> Gap = 1;
+        }
+    p_ur -> Pending -= p_op -> Len;
+    p_ur -> OpHead++;
+    }
+
+if((p_ur -> OpHead == p_ur -> OpTail) && p_ur -> Gap) {
+    // start again from the index of the ring
+    p_ur -> Gap = 0;
+    p_ur -> NextPos = (p_ur -> Dir == CCBF_URING_IN) ? CCBF_LOAD_RLX(p_ur -> p_Ring -> WrPos) : CCBF_LOAD_RLX(p_ur -> p_Ring -> RdPos);
+    }
+return 0;
+}
+
+// ==============================================================================
+
+//
+// submits again the operations partially done, then creates new ones on the free (resp. used) space
+//
+static void CircBufUringQueue(CircBufUring_t *p_ur)
+{
+CircBufUringOp_t *p_op;
+CCBFsize_t Avail, Len, ElemInBuf = p_ur -> p_Ring -> ElemInBuf;
+unsigned i, Slot, MaxOps = (p_ur -> Offset >= 0) ? p_ur -> Depth : 1;
+
+for(i = p_ur -> OpHead; i != p_ur -> OpTail; i++) {
+    Slot = i % p_ur -> Depth;
+    if(p_ur -> Ops[Slot].State == CCBF_URING_RESUBMIT) {
+        if(CircBufUringPrep(p_ur, Slot) != 0) {
+            return;
+            }
+        }
+    }
+
+while(!(p_ur -> Gap) && !(p_ur -> Eof) && (p_ur -> OpTail - p_ur -> OpHead < MaxOps)) {
+    if(p_ur -> Dir == CCBF_URING_IN) {
+        Avail = CircBufAvailWr(p_ur -> p_Ring) - p_ur -> Pending;
+        } else {
+        Avail = CircBufAvailRd(p_ur -> p_Ring) - p_ur -> Pending;
+        }
+    Len = ElemInBuf - p_ur -> NextPos; // contiguous
+    if(Len > Avail) Len = Avail;
+    if(Len > p_ur -> ChunkMax) Len = p_ur -> ChunkMax;
+    if(Len == 0) {
+        return;
+        }
+    Slot = p_ur -> OpTail % p_ur -> Depth;
+    p_op = &(p_ur -> Ops[Slot]);
+    p_op -> Start = p_ur -> NextPos;
+    p_op -> Len = Len;
+    p_op -> Done = 0;
+    p_op -> Off = (p_ur -> Offset >= 0) ? p_ur -> Offset : 0;
+    if(CircBufUringPrep(p_ur, Slot) != 0) {
+        return;
+        }
+    p_ur -> OpTail++;
+    p_ur -> Pending += Len;
+    p_ur -> NextPos += Len;
+    if(p_ur -> NextPos == ElemInBuf) p_ur -> NextPos = 0;
+    if(p_ur -> Offset >= 0) p_ur -> Offset += Len;
+   }
+}
+
+// ==============================================================================
+
+int CircBufUringPump(CircBufUring_t *p_ur, unsigned MinComplete, CCBFsize_t *p_n)
+{
+unsigned ToSubmit;
+int err;
+
+if((p_ur == NULL) || (p_n == NULL) || (p_ur -> Fd < 0)) {
+    return __LINE__;
+    }
+*p_n = 0;
+
+CircBufUringReap(p_ur);
+if((err = CircBufUringCommit(p_ur, p_n)) != 0) {
+    return err;
+    }
+if(p_ur -> Err != 0) {
+    errno = p_ur -> Err;
+    return __LINE__;
+    }
+
+CircBufUringQueue(p_ur);
+
+// one system call for all the operations queued, and the wait
+ToSubmit = *(p_ur -> SqTail) - __atomic_load_n(p_ur -> SqHead, __ATOMIC_ACQUIRE);
+if(MinComplete > p_ur -> Nkernel) {
+    MinComplete = p_ur -> Nkernel;
+    }
+if((ToSubmit > 0) || (MinComplete > 0)) {
+    if(CircBufUringEnter(p_ur -> Fd, ToSubmit, MinComplete) < 0) {
+        if((errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY)) {
+            return __LINE__;
+            }
+        }
+    }
+
+// the operations completed right away, or waited for:
+CircBufUringReap(p_ur);
+if((err = CircBufUringCommit(p_ur, p_n)) != 0) {
+    return err;
+    }
+if(p_ur -> Err != 0) {
+    errno = p_ur -> Err;
+    return __LINE__;
+    }
+return 0;
+}
+
+// ==============================================================================
+
+unsigned CircBufUringInflight(CircBufUring_t *p_ur)
+{
+return p_ur -> OpTail - p_ur -> OpHead;
+}
+
+// ==============================================================================
+
+int CircBufUringClose(CircBufUring_t *p_ur)
+{
+struct io_uring_sqe *sqe;
+unsigned i, Slot, Tail, Mask;
+
+if(p_ur == NULL) {
+    return __LINE__;
+    }
+if(p_ur -> Fd < 0) {
+    return 0;
+    }
+
+// cancel the operations owned by the kernel: it must not write into (resp. read) the buffer anymore once we return
+Mask = *(p_ur -> SqMask);
+for(i = p_ur -> OpHead; i != p_ur -> OpTail; i++) {
+    Slot = i % p_ur -> Depth;
+    if(p_ur -> Ops[Slot].State != CCBF_URING_KERNEL) {
+        continue;
+        }
+    Tail = *(p_ur -> SqTail);
+    if(Tail - __atomic_load_n(p_ur -> SqHead, __ATOMIC_ACQUIRE) > Mask) {
+        break; // the remaining ones are waited for
+        }
+    sqe = &(p_ur -> Sqes[Tail & Mask]);
+    memset(sqe, 0, sizeof(*sqe));
+    sqe -> opcode = IORING_OP_ASYNC_CANCEL;
+    sqe -> fd = -1;
+    sqe -> addr = Slot; // user_data of the operation
+    sqe -> user_data = CCBF_URING_CANCEL_DATA;
+    p_ur -> SqArray[Tail & Mask] = Tail & Mask;
+    __atomic_store_n(p_ur -> SqTail, Tail + 1, __ATOMIC_RELEASE);
+    }
+
+while(p_ur -> Nkernel > 0) {
+    if(CircBufUringEnter(p_ur -> Fd, *(p_ur -> SqTail) - __atomic_load_n(p_ur -> SqHead, __ATOMIC_ACQUIRE), 1) < 0) {
+        if((errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY)) {
+            return __LINE__;
+            }
+        }
+    CircBufUringReap(p_ur);
+    }
+
+CircBufUringUnmap(p_ur); // also unregisters the buffer
+p_ur -> OpHead = p_ur -> OpTail;
+p_ur -> Pending = 0;
+return 0;
+}
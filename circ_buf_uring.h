@@ -0,0 +1,118 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ io_uring pump (Linux >= 5.6): the kernel fills a ring of bytes from a file descriptor (input pump),
+ or drains it to a file descriptor (output pump), while other threads parse / produce the data.
+
+ The data buffer of the ring is registered as a fixed buffer when possible (see the Fixed member): no copy,
+ no page pinning per operation. Several operations are kept in flight, each on a contiguous part of the free (resp. used) region,
+ and the completions are committed in order with CircBufUpdtWr() (resp. CircBufUpdtRd()). All the operations queued
+ by one call to CircBufUringPump() are submitted with a single system call.
+
+ Offset >= 0 : positioned I/O (regular files, block devices): up to Depth operations in flight, at increasing offsets.
+ Offset <  0 : stream (pipes, sockets, current file position): one operation in flight, since the kernel does not
+               order concurrent reads / writes on a stream.
+
+ An input pump is the writer of the ring (one thread), an output pump is its reader.
+ The two pumps of a ring can be driven by the same thread.
+
+ Uses the raw system calls (linux/io_uring.h): no dependency on liburing.
+
+ */
+
+#ifndef CIRC_BUF_URING_H
+#define CIRC_BUF_URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/io_uring.h>
+#include "circ_buf.h"
+
+#define CCBF_URING_IN  0 // fd --> ring
+#define CCBF_URING_OUT 1 // ring --> fd
+
+// state of an operation
+#define CCBF_URING_KERNEL   0 // submitted, not completed
+#define CCBF_URING_RESUBMIT 1 // partially done (positioned I/O), or EAGAIN: the rest must be submitted again
+#define CCBF_URING_DONE     2 // completed, waiting for the previous ones to be committed
+
+typedef struct CircBufUringOp_str
+{
+  CCBFsize_t Start; // first index in the ring
+  CCBFsize_t Len; // bytes
+  CCBFsize_t Done; // bytes transferred so far
+  uint64_t Off; // file offset of Start (positioned I/O)
+  int State;
+} CircBufUringOp_t;
+
+typedef struct CircBufUring_str
+{
+  CircBuf_t *p_Ring; // ring of bytes
+  uint8_t *Data; // its data buffer: p_Ring -> ElemInBuf bytes
+  int Dir; // CCBF_URING_IN or CCBF_URING_OUT
+  int IoFd; // file descriptor read (resp. written)
+  int64_t Offset; // file offset of the next operation, < 0 for streams
+  size_t ChunkMax; // max number of bytes per operation
+
+  int Fd; // the io_uring
+  int Fixed; // != 0 : the data buffer is registered (READ_FIXED / WRITE_FIXED)
+  int Eof; // input: the end of file has been reached
+  int Err; // errno of the failed operation, 0 if none
+
+  // operations, in the order of the data: caller-provided table of Depth entries, used circularly
+  CircBufUringOp_t *Ops;
+  unsigned Depth;
+  unsigned OpHead, OpTail; // counters: first operation not committed, next one to create
+  unsigned Nkernel; // operations owned by the kernel
+  CCBFsize_t NextPos; // ring index of the next operation
+  CCBFsize_t Pending; // bytes covered by the operations in the table
+  int Gap; // != 0 : a short operation has been committed, the following ones are dropped (see circ_buf_uring.c)
+
+  // io_uring rings (mmap)
+  void *SqMap, *CqMap;
+  size_t SqMapSz, CqMapSz;
+  struct io_uring_sqe *Sqes;
+  size_t SqesSz;
+  unsigned *SqHead, *SqTail, *SqMask, *SqArray;
+  unsigned *CqHead, *CqTail, *CqMask;
+  struct io_uring_cqe *Cqes;
+
+} CircBufUring_t;
+
+#define CIRCBUFURING(x) ((CircBufUring_t *)x)
+
+
+//
+// p_ring : an initialized ring of bytes, and Data its buffer. The pump must be the only writer (CCBF_URING_IN), resp. reader (CCBF_URING_OUT).
+// Ops : table of Depth entries, kept until CircBufUringClose()
+// ChunkMax : max number of bytes per operation
+//
+// returns 0 if no error.
+//
+int CircBufUringInit(CircBufUring_t *p_ur, CircBuf_t *p_ring, uint8_t *Data, int Dir, int IoFd, int64_t Offset,
+                     CircBufUringOp_t *Ops, unsigned Depth, size_t ChunkMax);
+
+//
+// Commits the operations completed, then queues new ones on the free (resp. used) space, and submits them.
+// MinComplete > 0 : also waits for MinComplete completions (at most the number of operations in flight), and commits them.
+// *p_n : number of bytes committed (added to the ring, resp. removed from it)
+//
+// returns 0 if no error (check Eof for the end of an input), an error code otherwise (errno is set).
+//
+int CircBufUringPump(CircBufUring_t *p_ur, unsigned MinComplete, CCBFsize_t *p_n);
+
+//
+// Number of operations not committed yet: 0 when an output pump has written everything it took from the ring
+//
+unsigned CircBufUringInflight(CircBufUring_t *p_ur);
+
+//
+// Cancels the operations in flight, waits for them, and releases the io_uring.
+//
+int CircBufUringClose(CircBufUring_t *p_ur);
+
+#endif // CIRC_BUF_URING_H
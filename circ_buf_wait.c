@@ -0,0 +1,177 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ No lost wake-up:
+   waiting side : Sleeping = 1 (seq_cst), then reads the index of the other side, then sleeps only if the kernel still sees that value.
+   other side   : stores its index, fence (seq_cst), then reads Sleeping and wakes if set.
+ Either the waiting side sees the new index, or the other side sees Sleeping.
+
+ */
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "circ_buf_wait.h"
+
+_Static_assert(sizeof(CCBFvolsize_t) == 4, "the futex needs 32 bits indexes (CCBFsize_t)");
+
+#define MIN_SPINS (CCBF_WAIT_SPINS / 64 + 1)
+
+// ==============================================================================
+
+static int futex_wait(CCBFvolsize_t *addr, CCBFsize_t val, const struct timespec *deadline)
+{
+// absolute deadline on CLOCK_MONOTONIC: spurious wake-ups don't extend the wait
+return syscall(SYS_futex, addr, FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG, val, deadline, NULL, FUTEX_BITSET_MATCH_ANY);
+}
+
+// ==============================================================================
+
+static void futex_wake(CCBFvolsize_t *addr)
+{
+syscall(SYS_futex, addr, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, 1, NULL, NULL, 0);
+}
+
+// ==============================================================================
+
+//
+// Waits until Avail() >= Nelem.
+// p_idx : index of the other side, p_sleeping : our flag, p_spins : our spin budget
+//
+static int CircBufWtWait(CircBuf_t *p_ring, CCBFsize_t (*Avail)(CircBuf_t *), CCBFsize_t Nelem, int64_t TimeoutNs,
+                         CCBFvolsize_t *p_idx, CCBFvolsize_t *p_sleeping, CCBFsize_t *p_spins)
+{
+CCBFsize_t i, Idx;
+struct timespec deadline, *p_deadline = NULL;
+int ret;
+
+// fast path: no system call at all
+for(i=0; i< *p_spins; i++) {
+    if(Avail(p_ring) >= Nelem) {
+        *p_spins = (2 * *p_spins > CCBF_WAIT_SPINS) ? CCBF_WAIT_SPINS : 2 * *p_spins; // spinning is worth it
+        return 0;
+       }
+    if(TimeoutNs == 0) return CCBF_TIMEOUT;
+    CCBF_CPU_RELAX();
+   }
+if(*p_spins > MIN_SPINS) *p_spins /= 2; // the other side is slow: sleep sooner next time
+
+if(TimeoutNs > 0) {
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += TimeoutNs / 1000000000;
+    deadline.tv_nsec += TimeoutNs % 1000000000;
+    if(deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+       }
+    p_deadline = &deadline;
+   }
+
+ret = 0;
+for(;;) {
+    atomic_store(p_sleeping, 1);
+    Idx = atomic_load(p_idx); // after the flag: see the top of this file
+    if(Avail(p_ring) >= Nelem) break;
+    if(futex_wait(p_idx, Idx, p_deadline) != 0) {
+        if(errno == ETIMEDOUT) {
+            ret = (Avail(p_ring) >= Nelem) ? 0 : CCBF_TIMEOUT;
+            break;
+           }
+        if((errno != EAGAIN) && (errno != EINTR)) {
+            ret = __LINE__;
+            break;
+           }
+       }
+   }
+CCBF_STORE_RLX(*p_sleeping, 0);
+return ret;
+}
+
+// ==============================================================================
+
+// SizeOfBuf : in elements (NOT bytes!) must be >= 2
+int CircBufWtInit(CircBufWt_t *p_circ, CCBFsize_t SizeOfBuf)
+{
+int ret;
+if(p_circ == NULL){
+    return __LINE__;
+    }
+ret = CircBufInit(CIRCBUF(&(p_circ -> Ring)), SizeOfBuf);
+if(ret != 0) {
+    return ret;
+    }
+CCBF_STORE_RLX(p_circ -> RdSleeping, 0);
+CCBF_STORE_RLX(p_circ -> WrSleeping, 0);
+p_circ -> RdSpins = CCBF_WAIT_SPINS;
+p_circ -> WrSpins = CCBF_WAIT_SPINS;
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufWtWaitRd(CircBufWt_t *p_circ, CCBFsize_t Nelem, int64_t TimeoutNs)
+{
+if(p_circ == NULL){
+    return __LINE__;
+    }
+if(Nelem > p_circ -> Ring.ElemInBuf - 1) {
+    return __LINE__; // would never happen
+    }
+return CircBufWtWait(&(p_circ -> Ring), CircBufAvailRd, Nelem, TimeoutNs, &(p_circ -> Ring.WrPos), &(p_circ -> RdSleeping), &(p_circ -> RdSpins));
+}
+
+// ==============================================================================
+
+int CircBufWtWaitWr(CircBufWt_t *p_circ, CCBFsize_t Nelem, int64_t TimeoutNs)
+{
+if(p_circ == NULL){
+    return __LINE__;
+    }
+if(Nelem > p_circ -> Ring.ElemInBuf - 1) {
+    return __LINE__; // would never happen
+    }
+return CircBufWtWait(&(p_circ -> Ring), CircBufAvailWr, Nelem, TimeoutNs, &(p_circ -> Ring.RdPos), &(p_circ -> WrSleeping), &(p_circ -> WrSpins));
+}
+
+// ==============================================================================
+
+int CircBufWtUpdtWr(CircBufWt_t *p_circ, CCBFsize_t Nconsumed)
+{
+int ret;
+if(p_circ == NULL){
+    return __LINE__;
+    }
+ret = CircBufUpdtWr(CIRCBUF(&(p_circ -> Ring)), Nconsumed);
+if(ret != 0) {
+    return ret;
+    }
+atomic_thread_fence(memory_order_seq_cst); // WrPos before RdSleeping: see the top of this file
+if(CCBF_LOAD_RLX(p_circ -> RdSleeping)) futex_wake(&(p_circ -> Ring.WrPos));
+return 0;
+}
+
+// ==============================================================================
+
+int CircBufWtUpdtRd(CircBufWt_t *p_circ, CCBFsize_t Nconsumed)
+{
+int ret;
+if(p_circ == NULL){
+    return __LINE__;
+    }
+ret = CircBufUpdtRd(CIRCBUF(&(p_circ -> Ring)), Nconsumed);
+if(ret != 0) {
+    return ret;
+    }
+atomic_thread_fence(memory_order_seq_cst); // RdPos before WrSleeping: see the top of this file
+if(CCBF_LOAD_RLX(p_circ -> WrSleeping)) futex_wake(&(p_circ -> Ring.RdPos));
+return 0;
+}
@@ -0,0 +1,64 @@
+/*
+
+   Copyright 2021 Joël Stienlet
+
+   MIT license, see LICENSE file.
+
+
+ Blocking waits on top of CircBuf_t (Linux only).
+
+ Instead of polling CircBufRdInd() / CircBufWrInd() in a loop, a thread can wait until Nelem elements can be read (resp. written).
+ The wait first polls the ring for a while (with a pause instruction), then sleeps in the kernel on a futex:
+ the index word of the other side (WrPos for the reader, RdPos for the writer).
+
+ The other side must update its index with CircBufWtUpdtWr() / CircBufWtUpdtRd(): they wake the waiting thread,
+ but only when it has said it is sleeping, so that no system call is made as long as nobody waits.
+
+ CircBufWrInd(), CircBufRdInd() etc. are used as usual on the Ring member.
+ One writer, one reader. Requires CCBF_ATOMICS=1, and 32 bits indexes (CCBFsize_t) for the futex.
+
+ */
+
+#ifndef CIRC_BUF_WAIT_H
+#define CIRC_BUF_WAIT_H
+
+#include "circ_buf.h"
+
+#if !CCBF_ATOMICS
+#error "circ_buf_wait.h requires CCBF_ATOMICS=1 (see custom_circ_buf.h)"
+#endif
+
+typedef struct CircBufWt_str
+{
+  CircBuf_t Ring; // the usual index manager
+
+  CCBFvolsize_t RdSleeping; // != 0 : the reader may be sleeping on Ring.WrPos
+  CCBFvolsize_t WrSleeping; // != 0 : the writer may be sleeping on Ring.RdPos
+
+  CCBFsize_t RdSpins; // current spin budget of the reader, only used by the reader
+  CCBFsize_t WrSpins; // current spin budget of the writer, only used by the writer
+
+} CircBufWt_t;
+
+#define CIRCBUFWT(x) ((CircBufWt_t *)x)
+
+
+// SizeOfBuf : in elements (NOT bytes!) must be >= 2
+int CircBufWtInit(CircBufWt_t *p_circ, CCBFsize_t SizeOfBuf);
+
+//
+// Waits until at least Nelem elements can be read (resp. written).
+// TimeoutNs : maximum time to wait, in nanoseconds. < 0 : no timeout. 0 : just check.
+//
+// returns 0 when the elements are available, CCBF_TIMEOUT if the timeout expired before, an error code (> 0) otherwise.
+//
+int CircBufWtWaitRd(CircBufWt_t *p_circ, CCBFsize_t Nelem, int64_t TimeoutNs);
+int CircBufWtWaitWr(CircBufWt_t *p_circ, CCBFsize_t Nelem, int64_t TimeoutNs);
+
+//
+// Same as CircBufUpdtWr() (resp. CircBufUpdtRd()), and wakes the other side if it is sleeping.
+//
+int CircBufWtUpdtWr(CircBufWt_t *p_circ, CCBFsize_t Nconsumed);
+int CircBufWtUpdtRd(CircBufWt_t *p_circ, CCBFsize_t Nconsumed);
+
+#endif // CIRC_BUF_WAIT_H
@@ -12,6 +12,9 @@
   
 */
 
+#ifndef CUSTOM_CIRC_BUF_H
+#define CUSTOM_CIRC_BUF_H
+
 #include <stdint.h>
 
 // defines the types of variables that will hold indexes
@@ -19,7 +22,58 @@
 // should be unsigned
 #define CCBFsizeMAX UINT32_MAX
 typedef uint32_t CCBFsize_t;
+
+// defines the type of the free running counters used by the power-of-two index manager (circ_buf_p2.h): 
+// total number of elements written/read since the initialization, i.e. absolute offsets in the stream.
+// should be unsigned, and wide enough to never wrap around in practice.
+typedef uint64_t CCBFcount_t;
+
+
+// defines how the indexes shared between the reader and the writer (RdPos, WrPos) are accessed.
+//   0 : plain volatile accesses. Fine on single core microcontrollers and on strongly ordered CPUs (x86), 
+//       but on weakly ordered CPUs (ARM, POWER...) the caller has to add memory fences around the calls when reader and writer run on different cores.
+//   1 : C11 <stdatomic.h>. The index owned by the other thread is read with acquire semantics, the updated index is published with release semantics,
+//       and a thread reads its own index with relaxed semantics. No fence is needed, and on x86 this compiles down to plain movs.
+// can also be set from the command line: -DCCBF_ATOMICS=1
+#ifndef CCBF_ATOMICS
+#define CCBF_ATOMICS 0
+#endif
+
+#if CCBF_ATOMICS
+#include <stdatomic.h>
+typedef _Atomic CCBFsize_t CCBFvolsize_t; // CCBFsize_t must be lock-free on the targetted hardware
+typedef _Atomic CCBFcount_t CCBFvolcount_t;
+#define CCBF_LOAD_RLX(x)     atomic_load_explicit(&(x), memory_order_relaxed)
+#define CCBF_LOAD_ACQ(x)     atomic_load_explicit(&(x), memory_order_acquire)
+#define CCBF_STORE_RLX(x, v) atomic_store_explicit(&(x), (v), memory_order_relaxed)
+#define CCBF_STORE_REL(x, v) atomic_store_explicit(&(x), (v), memory_order_release)
+#else
 typedef volatile CCBFsize_t CCBFvolsize_t; // access to the variables of this type must be atomic on the targetted hardware
+typedef volatile CCBFcount_t CCBFvolcount_t; // same remark: on 32 bits CPUs, use CCBF_ATOMICS=1 (or a 32 bits counter type)
+#define CCBF_LOAD_RLX(x)     (x)
+#define CCBF_LOAD_ACQ(x)     (x)
+#define CCBF_STORE_RLX(x, v) ((x) = (v))
+#define CCBF_STORE_REL(x, v) ((x) = (v))
+#endif
+
+
+// per-ring instrumentation of circ_buf.c (see CircBufMetricsGet() in circ_buf.h): occupancy high-water mark, calls that found the buffer full / empty,
+// items moved and histograms of the batch sizes.
+//   0 : not compiled in, CircBuf_t only holds the indexes.
+//   1 : the counters are added to CircBuf_t, each side (reader / writer) updates its own counters on its own cache lines.
+// can also be set from the command line: -DCCBF_METRICS=1
+#ifndef CCBF_METRICS
+#define CCBF_METRICS 0
+#endif
+
+// trace points in CircBufWrInd(), CircBufRdInd(), CircBufUpdtWr() and CircBufUpdtRd() (see circ_buf_trace.h).
+//   0 : not compiled in: no cost at all.
+//   1 : USDT probes ccbf:wr_ind, ccbf:rd_ind, ccbf:updt_wr, ccbf:updt_rd when <sys/sdt.h> is available (perf, bpftrace: a nop when not traced),
+//       and a call to the in-process recorder when one is started (one test of a pointer otherwise).
+// can also be set from the command line: -DCCBF_TRACE=1
+#ifndef CCBF_TRACE
+#define CCBF_TRACE 0
+#endif
 
 
 // defines the types of variables used to perform computation on indexes. Must be able to store up to twice the number of items in the buffer (of type CCBFsize_t).
@@ -27,3 +81,23 @@ typedef volatile CCBFsize_t CCBFvolsize_t; // access to the variables of this ty
 #define CCBFbigsizeMAX UINT64_MAX
 typedef uint64_t CCBFbigsize_t;
 
+
+// size of a cache line on the targetted hardware, used by the index managers that keep the reader and writer data apart (circ_buf_spsc.h)
+#define CCBF_CACHE_LINE 64
+
+// hint to the CPU that we are busy waiting (used by the index managers that have to wait for another thread: circ_buf_mp.h)
+#if defined(__x86_64__) || defined(__i386__)
+#define CCBF_CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define CCBF_CPU_RELAX() __asm__ __volatile__("yield")
+#else
+#define CCBF_CPU_RELAX() do {} while(0)
+#endif
+
+// maximum number of times a blocking wait (circ_buf_wait.h) polls the ring before going to sleep in the kernel.
+// The actual number adapts between CCBF_WAIT_SPINS/64 and CCBF_WAIT_SPINS: it grows when spinning was enough, and shrinks when it was not.
+#ifndef CCBF_WAIT_SPINS
+#define CCBF_WAIT_SPINS 4096
+#endif
+
+#endif // CUSTOM_CIRC_BUF_H